@@ -0,0 +1,130 @@
+#ifndef LUMI_BENCH_H
+#define LUMI_BENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct BenchResult {
+	std::string name;
+	size_t monitors = 0;
+	size_t iterations = 0;
+	double mean = 0;
+	double p50 = 0;
+	double p99 = 0;
+	double p999 = 0;
+	double max = 0;
+	// Completed calls per second when issued back to back from one thread.
+	double throughput = 0;
+};
+
+// Times a call repeatedly and summarizes per-call latency in microseconds.
+class Bench {
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	size_t iterations;
+	std::string filter;
+	std::vector<BenchResult> results;
+
+	static double Percentile(const std::vector<double> &sorted, double percentile) {
+		size_t index = static_cast<size_t>(percentile * (sorted.size() - 1) + 0.5);
+		return sorted[std::min(index, sorted.size() - 1)];
+	}
+
+public:
+	Bench(size_t iterations, std::string filter) : iterations(iterations), filter(std::move(filter)) {}
+
+	void Run(const std::string &name, size_t monitors, const std::function<void(size_t)> &call, size_t count = 0) {
+		if (!filter.empty() && name.find(filter) == std::string::npos) return;
+
+		size_t total = count != 0 ? count : iterations;
+		std::vector<double> samples;
+		samples.reserve(total);
+
+		// One untimed call so lazy initialization does not land in the samples.
+		call(0);
+
+		auto started = Clock::now();
+		for (size_t i = 0; i < total; i++) {
+			auto start = Clock::now();
+			call(i);
+			samples.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+		}
+		double elapsed = std::chrono::duration<double>(Clock::now() - started).count();
+
+		std::sort(samples.begin(), samples.end());
+
+		BenchResult result;
+		result.name = name;
+		result.monitors = monitors;
+		result.iterations = total;
+		for (double sample: samples) result.mean += sample;
+		result.mean /= samples.size();
+		result.p50 = Percentile(samples, 0.50);
+		result.p99 = Percentile(samples, 0.99);
+		result.p999 = Percentile(samples, 0.999);
+		result.max = samples.back();
+		result.throughput = elapsed > 0 ? total / elapsed : 0;
+		results.push_back(result);
+
+		std::fprintf(stderr, "%-28s %3zu monitors  p50 %10.2f us  p99 %10.2f us  p999 %10.2f us  %12.0f ops/s\n",
+		             name.c_str(), monitors, result.p50, result.p99, result.p999, result.throughput);
+	}
+
+	const std::vector<BenchResult> &Results() const {
+		return results;
+	}
+
+	std::string ToJson() const {
+		std::ostringstream json;
+		json << "[";
+
+		for (size_t i = 0; i < results.size(); i++) {
+			const BenchResult &result = results[i];
+			json << (i == 0 ? "\n" : ",\n")
+			     << "    {\"name\": \"" << result.name << "\", \"monitors\": " << result.monitors
+			     << ", \"iterations\": " << result.iterations
+			     << ", \"latencyUs\": {\"mean\": " << result.mean << ", \"p50\": " << result.p50
+			     << ", \"p99\": " << result.p99 << ", \"p999\": " << result.p999 << ", \"max\": " << result.max << "}"
+			     << ", \"throughput\": " << result.throughput << "}";
+		}
+
+		json << "\n  ]";
+		return json.str();
+	}
+};
+
+// Settings shared by every suite, taken from the command line.
+struct BenchContext {
+	std::vector<size_t> monitorCounts;
+	// LUMI_SIMULATED style option list applied to every simulated backend.
+	std::string simulated;
+};
+
+struct BenchSuite {
+	const char *name;
+	void (*run)(Bench &bench, const BenchContext &context);
+};
+
+inline std::vector<BenchSuite> &BenchRegistry() {
+	static std::vector<BenchSuite> registry;
+	return registry;
+}
+
+struct BenchRegistrar {
+	BenchRegistrar(const char *name, void (*run)(Bench &, const BenchContext &)) {
+		BenchRegistry().push_back({name, run});
+	}
+};
+
+#define BENCH_SUITE(name)                                              \
+	static void name(Bench &bench, const BenchContext &context);       \
+	static BenchRegistrar name##Registrar(#name, name);                \
+	static void name(Bench &bench, const BenchContext &context)
+
+#endif// LUMI_BENCH_H
@@ -0,0 +1,63 @@
+// A set followed by a read back on every DDC/CI bus at once, against emulated
+// displays that NAK messages sent too early (3 ms reply delay and 5 ms command
+// gap, a tenth of the real timing). ddc_unpaced sends back to back and relies
+// on retries with backoff, as lumi did before; ddc_scheduled paces each bus
+// with DdcBusScheduler, which also answers the read back from the write.
+
+#include "bench.h"
+#include "ddc/ddc_bus_scheduler.h"
+#include "ddc/ddc_ci.h"
+#include "ddc/emulated_ddc_monitor.h"
+#include "retry_policy.h"
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+BENCH_SUITE(DdcBenchmarks) {
+	const size_t iterations = 20;
+	DdcTiming timing{std::chrono::milliseconds(3), std::chrono::milliseconds(5)};
+
+	RetryPolicy policy;
+	policy.attempts = 10;
+	policy.initialDelay = std::chrono::milliseconds(1);
+	policy.maxDelay = std::chrono::milliseconds(8);
+
+	EmulatedDdcOptions options;
+	options.minReplyDelay = timing.replyDelay;
+	options.minCommandGap = timing.commandGap;
+
+	for (size_t count: context.monitorCounts) {
+		std::vector<std::unique_ptr<EmulatedDdcMonitor>> monitors;
+		std::vector<std::unique_ptr<DdcBusScheduler>> schedulers;
+
+		for (size_t i = 0; i < count; i++) {
+			monitors.push_back(std::make_unique<EmulatedDdcMonitor>(options));
+			schedulers.push_back(std::make_unique<DdcBusScheduler>(monitors.back().get(), timing));
+		}
+
+		// Runs transaction(bus) on every bus in parallel.
+		auto everyBus = [&](auto transaction) {
+			std::vector<std::thread> threads;
+			for (size_t bus = 0; bus < count; bus++) threads.emplace_back([&, bus]() { transaction(bus); });
+			for (auto &thread: threads) thread.join();
+		};
+
+		bench.Run("ddc_unpaced", count, [&](size_t i) {
+			everyBus([&](size_t bus) {
+				DdcCi::Channel channel(monitors[bus].get(), timing.replyDelay);
+				DdcCi::VcpValue value;
+				Retry(policy, [&]() { return channel.SetVcp(DdcCi::VCP_BRIGHTNESS, static_cast<uint16_t>(i % 100)); });
+				Retry(policy, [&]() { return channel.GetVcp(DdcCi::VCP_BRIGHTNESS, value); });
+			});
+		}, iterations);
+
+		bench.Run("ddc_scheduled", count, [&](size_t i) {
+			everyBus([&](size_t bus) {
+				DdcCi::VcpValue value;
+				Retry(policy, [&]() { return schedulers[bus]->SetVcp(DdcCi::VCP_BRIGHTNESS, static_cast<uint16_t>(i % 100)); });
+				Retry(policy, [&]() { return schedulers[bus]->GetVcp(DdcCi::VCP_BRIGHTNESS, value); });
+			});
+		}, iterations);
+	}
+}
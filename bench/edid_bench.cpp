@@ -0,0 +1,41 @@
+// EDID decoding over the fixture corpus. Each call parses a batch of EDIDs
+// round-robin and reads the identity fields, as topology rebuilds do for every
+// connected monitor. Skipped when run outside the package root.
+
+#include "bench.h"
+#include "edid.h"
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+// Keeps the parsing from being optimized away.
+volatile size_t edidSink;
+
+BENCH_SUITE(EdidBenchmarks) {
+	const size_t batch = 1000;
+	std::vector<std::vector<uint8_t>> corpus;
+	std::error_code error;
+
+	for (const auto &entry: std::filesystem::directory_iterator(std::filesystem::path("test") / "fixtures" / "edid", error)) {
+		std::ifstream file(entry.path(), std::ios::binary);
+		std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		Edid::Info info;
+		if (Edid::Parse(bytes.data(), bytes.size(), info)) corpus.push_back(std::move(bytes));
+	}
+
+	if (corpus.empty()) return;
+
+	size_t checksum = 0;
+
+	bench.Run("edid_parse", corpus.size(), [&](size_t i) {
+		for (size_t j = 0; j < batch; j++) {
+			const auto &bytes = corpus[(i + j) % corpus.size()];
+			Edid::Info info;
+			Edid::Parse(bytes.data(), bytes.size(), info);
+			checksum += info.productCode + info.name.size() + info.serial.size();
+		}
+	});
+
+	edidSink = checksum;
+}
@@ -0,0 +1,91 @@
+// Engine hot paths against the simulated backend: single-monitor get (cached,
+// synchronous from the last known value, and fresh), reading every monitor,
+// single-monitor set by id and by handle, the global set, a config set and a
+// handle set (setMany) touching every monitor and topology handling.
+
+#include "backends/simulated_backend.h"
+#include "bench.h"
+#include "monitor_service.h"
+#include <chrono>
+#include <future>
+#include <memory>
+
+BENCH_SUITE(EngineBenchmarks) {
+	for (size_t count: context.monitorCounts) {
+		SimulatedBackendOptions options = ParseSimulatedBackendOptions(context.simulated);
+		options.monitors = count;
+
+		auto backend = std::make_shared<SimulatedBackend>(options);
+		MonitorService service(backend);
+
+		std::vector<std::string> ids;
+		std::vector<MonitorBrightnessConfiguration> config;
+		for (size_t i = 0; i < count; i++) {
+			ids.push_back(SimulatedBackend::IdForIndex(i));
+			config.push_back({ids.back(), 50});
+		}
+
+		bench.Run("get", count, [&](size_t i) {
+			service.GetBrightness(ids[i % count]);
+		});
+
+		bench.Run("get_cached_sync", count, [&](size_t i) {
+			int brightness;
+			std::chrono::milliseconds age;
+			service.GetCachedBrightness(ids[i % count], brightness, age);
+		});
+
+		bench.Run("get_fresh", count, [&](size_t i) {
+			service.GetBrightness(ids[i % count], {true});
+		});
+
+		bench.Run("get_all_fresh", count, [&](size_t) {
+			std::promise<void> done;
+			service.GetAllBrightness({true}, [&](GetAllBrightnessResult) { done.set_value(); });
+			done.get_future().get();
+		});
+
+		bench.Run("set", count, [&](size_t i) {
+			service.SetBrightness({{ids[i % count], static_cast<int>(i % 100)}});
+		});
+
+		std::vector<std::uint32_t> handles;
+		for (const auto &id: ids) handles.push_back(service.GetHandle(id));
+
+		bench.Run("set_handle", count, [&](size_t i) {
+			std::promise<void> done;
+			service.SetBrightness(handles[i % count], static_cast<int>(i % 100), {}, [&](SetBrightnessResult) { done.set_value(); });
+			done.get_future().get();
+		});
+
+		std::vector<std::pair<std::uint32_t, int>> many;
+		for (std::uint32_t handle: handles) many.emplace_back(handle, 50);
+
+		bench.Run("set_many", count, [&](size_t i) {
+			for (auto &write: many) write.second = static_cast<int>(i % 100);
+			std::promise<void> done;
+			service.SetManyBrightness(many, {}, [&](std::vector<SetStatus>) { done.set_value(); });
+			done.get_future().get();
+		});
+
+		bench.Run("set_global", count, [&](size_t i) {
+			service.SetBrightness({{ALL_MONITORS, static_cast<int>(i % 100)}});
+		});
+
+		bench.Run("set_config", count, [&](size_t i) {
+			for (auto &entry: config) entry.brightness = static_cast<int>(i % 100);
+			service.SetBrightness(config);
+		});
+
+		bench.Run("monitors", count, [&](size_t) {
+			service.GetAvailableMonitors();
+		});
+
+		// Rebuilding the topology on every call, as each call did before the
+		// engine kept a snapshot.
+		bench.Run("get_uncached_topology", count, [&](size_t i) {
+			service.Refresh();
+			service.GetBrightness(ids[i % count]);
+		});
+	}
+}
@@ -0,0 +1,54 @@
+// Runs the native benchmark binary and the JS-level benchmarks for every
+// monitor count and prints one JSON report.
+//
+//   npm run bench -- [--iterations N] [--monitors 1,4,16,64] [--simulated SPEC] [--filter NAME] [--out FILE]
+const {spawnSync} = require("child_process");
+const fs = require("fs");
+const path = require("path");
+
+const binary = path.join(__dirname, "..", "build", "Release", process.platform === "win32" ? "lumi_bench.exe" : "lumi_bench");
+
+const options = {iterations: "1000", monitors: "1,4,16,64", simulated: "", filter: "", out: ""};
+const args = process.argv.slice(2);
+for (let i = 0; i + 1 < args.length; i += 2) {
+    options[args[i].replace(/^--/, "")] = args[i + 1];
+}
+
+const nativeArgs = ["--iterations", options.iterations, "--monitors", options.monitors, "--simulated", options.simulated];
+if (options.filter) nativeArgs.push("--filter", options.filter);
+
+// Run from the package root, where the EDID suite finds its corpus.
+const native = spawnSync(binary, nativeArgs, {cwd: path.join(__dirname, ".."), stdio: ["ignore", "pipe", "inherit"], encoding: "utf8"});
+
+if (native.error || native.status !== 0) {
+    console.error(`Failed to run ${binary}. Build it first with \`npm run build\`.`);
+    process.exit(1);
+}
+
+const report = JSON.parse(native.stdout);
+report.suite = "lumi";
+
+for (const count of options.monitors.split(",")) {
+    const simulated = [`monitors=${count}`, options.simulated].filter(Boolean).join(",");
+    const js = spawnSync(process.execPath, [path.join(__dirname, "monitors.js"), options.iterations, count], {
+        stdio: ["ignore", "pipe", "inherit"],
+        encoding: "utf8",
+        env: {...process.env, LUMI_BACKEND: "simulated", LUMI_SIMULATED: simulated}
+    });
+
+    if (js.status !== 0) {
+        console.error(`JS benchmarks failed for ${count} monitors.`);
+        process.exit(1);
+    }
+
+    const results = JSON.parse(js.stdout).filter(({name}) => !options.filter || name.includes(options.filter));
+    report.results.push(...results);
+}
+
+const json = JSON.stringify(report, null, 2);
+
+if (options.out) {
+    fs.writeFileSync(options.out, json);
+} else {
+    console.log(json);
+}
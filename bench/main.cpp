@@ -0,0 +1,42 @@
+// Native benchmark suite. Prints a JSON report to stdout and a human readable
+// summary to stderr.
+//
+//   lumi_bench [--iterations N] [--monitors 1,4,16,64] [--simulated SPEC] [--filter NAME]
+
+#include "bench.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+static std::vector<size_t> ParseCounts(const std::string &list) {
+	std::vector<size_t> counts;
+	std::istringstream stream(list);
+	std::string entry;
+	while (std::getline(stream, entry, ',')) counts.push_back(std::strtoul(entry.c_str(), nullptr, 10));
+	return counts;
+}
+
+int main(int argc, char **argv) {
+	size_t iterations = 1000;
+	std::string filter;
+	BenchContext context = {{1, 4, 16, 64}, ""};
+
+	for (int i = 1; i + 1 < argc; i += 2) {
+		if (std::strcmp(argv[i], "--iterations") == 0) iterations = std::strtoul(argv[i + 1], nullptr, 10);
+		else if (std::strcmp(argv[i], "--monitors") == 0) context.monitorCounts = ParseCounts(argv[i + 1]);
+		else if (std::strcmp(argv[i], "--simulated") == 0) context.simulated = argv[i + 1];
+		else if (std::strcmp(argv[i], "--filter") == 0) filter = argv[i + 1];
+	}
+
+	Bench bench(iterations, filter);
+
+	for (const auto &suite: BenchRegistry()) {
+		suite.run(bench, context);
+	}
+
+	std::cout << "{\n  \"suite\": \"native\",\n  \"iterations\": " << iterations
+	          << ",\n  \"simulated\": \"" << context.simulated << "\",\n  \"results\": " << bench.ToJson() << "\n}" << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,54 @@
+// Times lumi.monitors(), lumi.get() and the forms of lumi.set() from
+// JavaScript, so the cost of marshalling arguments and results and of the
+// async round trip is measured on top of the native engine. Run by
+// bench/index.js with the simulated backend selected through
+// LUMI_BACKEND/LUMI_SIMULATED.
+const {performance} = require("perf_hooks");
+const lumi = require("../index.js");
+
+const iterations = Number(process.argv[2] || 1000);
+const monitors = Number(process.argv[3] || 1);
+
+const summarize = (name, samples, elapsed) => {
+    samples.sort((a, b) => a - b);
+    const percentile = (p) => samples[Math.min(samples.length - 1, Math.round(p * (samples.length - 1)))];
+    const mean = samples.reduce((sum, sample) => sum + sample, 0) / samples.length;
+    return {
+        name,
+        monitors,
+        iterations: samples.length,
+        latencyUs: {mean, p50: percentile(0.5), p99: percentile(0.99), p999: percentile(0.999), max: samples[samples.length - 1]},
+        throughput: samples.length / (elapsed / 1e3)
+    };
+};
+
+const measure = async (name, call) => {
+    await call(0);
+    const samples = [];
+    const started = performance.now();
+    for (let i = 0; i < iterations; i++) {
+        const start = performance.now();
+        await call(i);
+        samples.push((performance.now() - start) * 1e3);
+    }
+    return summarize(name, samples, performance.now() - started);
+};
+
+(async () => {
+    const ids = lumi.monitors().map((monitor) => monitor.id);
+    const id = ids[0];
+    const handles = Uint32Array.from(ids.map((monitorId) => lumi.handle(monitorId)));
+    const levels = new Uint8Array(handles.length);
+    const status = new Uint8Array(handles.length);
+    const results = [
+        await measure("js_monitors", () => lumi.monitors()),
+        await measure("js_get", () => lumi.get(id)),
+        await measure("js_get_cached", () => lumi.getCached(id)),
+        await measure("js_set", (i) => lumi.set(id, i % 100)),
+        await measure("js_set_handle", (i) => lumi.set(handles[0], i % 100)),
+        // Every monitor per call: a config object against the typed arrays.
+        await measure("js_set_config", (i) => lumi.set(Object.fromEntries(ids.map((monitorId) => [monitorId, i % 100])))),
+        await measure("js_set_many", (i) => lumi.setMany(handles, levels.fill(i % 100), {status}))
+    ];
+    process.stdout.write(JSON.stringify(results));
+})();
@@ -0,0 +1,41 @@
+// Multi-monitor configuration sets against monitors on separate buses that
+// each take a few milliseconds per write. Applying the configuration fans out
+// to every monitor, so it should cost about as much as the slowest monitor;
+// the sequential scenario applies the same levels one monitor at a time.
+
+#include "backends/simulated_backend.h"
+#include "bench.h"
+#include "monitor_service.h"
+#include <chrono>
+#include <memory>
+
+BENCH_SUITE(ParallelApplyBenchmarks) {
+	const size_t iterations = 10;
+
+	for (size_t count: context.monitorCounts) {
+		SimulatedBackendOptions options = ParseSimulatedBackendOptions(context.simulated);
+		options.monitors = count;
+		if (options.setLatency.count() == 0) {
+			options.setLatency = std::chrono::milliseconds(5);
+			options.jitter = std::chrono::milliseconds(5);
+		}
+
+		MonitorService service(std::make_shared<SimulatedBackend>(options));
+
+		std::vector<MonitorBrightnessConfiguration> config;
+		for (size_t i = 0; i < count; i++) config.push_back({SimulatedBackend::IdForIndex(i), 50});
+
+		bench.Run("config_single_monitor", count, [&](size_t i) {
+			service.SetBrightness({{config[i % count].monitorId, static_cast<int>(i % 100)}});
+		}, iterations);
+
+		bench.Run("config_parallel", count, [&](size_t i) {
+			for (auto &entry: config) entry.brightness = static_cast<int>(i % 100);
+			service.SetBrightness(config);
+		}, iterations);
+
+		bench.Run("config_sequential", count, [&](size_t i) {
+			for (const auto &entry: config) service.SetBrightness({{entry.monitorId, static_cast<int>(i % 100)}});
+		}, iterations);
+	}
+}
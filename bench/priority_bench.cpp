@@ -0,0 +1,74 @@
+// Slider sets on one monitor while a background sweep keeps re-reading every
+// monitor, all on a single bus (2 ms per operation). priority_fifo issues the
+// sweep at normal priority, as every request was before, so each set waits
+// behind the reads already queued; priority_classes issues it as background
+// work and the sets as interactive, so a set waits for at most the read in
+// progress.
+
+#include "backends/simulated_backend.h"
+#include "bench.h"
+#include "monitor_service.h"
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+BENCH_SUITE(PriorityBenchmarks) {
+	const size_t iterations = 200;
+	// Sweeps kept in flight at once.
+	const size_t sweeps = 2;
+
+	struct Scenario {
+		std::string name;
+		Priority background;
+		Priority interactive;
+	};
+
+	const std::vector<Scenario> scenarios = {{"priority_fifo", Priority::Normal, Priority::Normal},
+	                                         {"priority_classes", Priority::Background, Priority::Interactive}};
+
+	for (size_t count: context.monitorCounts) {
+		for (const auto &scenario: scenarios) {
+			SimulatedBackendOptions options = ParseSimulatedBackendOptions(context.simulated);
+			options.monitors = count;
+			options.buses = 1;
+			if (options.getLatency.count() == 0) options.getLatency = std::chrono::milliseconds(2);
+			if (options.setLatency.count() == 0) options.setLatency = std::chrono::milliseconds(2);
+
+			auto backend = std::make_shared<SimulatedBackend>(options);
+			MonitorService service(backend);
+			service.GetTopology();
+
+			GetBrightnessOptions sweep;
+			sweep.fresh = true;
+			sweep.priority = scenario.background;
+
+			std::atomic<bool> stopping{false};
+			std::vector<std::thread> load;
+			for (size_t i = 0; i < sweeps; i++) {
+				load.emplace_back([&]() {
+					while (!stopping) {
+						std::promise<void> done;
+						service.GetAllBrightness(sweep, [&](GetAllBrightnessResult) { done.set_value(); });
+						done.get_future().get();
+					}
+				});
+			}
+
+			SetBrightnessOptions slider;
+			slider.priority = scenario.interactive;
+			std::vector<MonitorBrightnessConfiguration> config = {{SimulatedBackend::IdForIndex(0), 50}};
+
+			bench.Run(scenario.name, count, [&](size_t i) {
+				config[0].brightness = static_cast<int>(i % 100);
+				service.SetBrightness(config, slider);
+			}, iterations);
+
+			stopping = true;
+			for (auto &thread: load) thread.join();
+		}
+	}
+}
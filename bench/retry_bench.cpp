@@ -0,0 +1,53 @@
+// Configuration sets against simulated monitors that fail now and then, half
+// of them internal panels that only answer on a fallback path (like laptop
+// panels reached through WMI once DDC/CI failed). The legacy policy retries
+// each path ten times back to back and always starts from the first; the
+// adaptive one backs off between retries and goes straight to the path that
+// last worked.
+
+#include "backends/simulated_backend.h"
+#include "bench.h"
+#include "monitor_service.h"
+#include "retry_policy.h"
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+BENCH_SUITE(RetryBenchmarks) {
+	const size_t iterations = 10;
+
+	RetryPolicy legacy;
+	legacy.attempts = 10;
+	legacy.initialDelay = std::chrono::microseconds(0);
+	legacy.learn = false;
+
+	RetryPolicy adaptive;
+	adaptive.initialDelay = std::chrono::microseconds(500);
+	adaptive.maxDelay = std::chrono::milliseconds(5);
+
+	const std::vector<std::pair<std::string, RetryPolicy>> policies = {{"retry_legacy", legacy}, {"retry_adaptive", adaptive}};
+
+	for (size_t count: context.monitorCounts) {
+		for (const auto &policy: policies) {
+			SimulatedBackendOptions options = ParseSimulatedBackendOptions(context.simulated);
+			options.monitors = count;
+			options.internalMonitors = (count + 1) / 2;
+			options.fallbackPanels = true;
+			if (options.setLatency.count() == 0) options.setLatency = std::chrono::milliseconds(1);
+			if (options.failureRate == 0) options.failureRate = 0.05;
+
+			auto backend = std::make_shared<SimulatedBackend>(options);
+			MonitorService service(backend);
+			service.SetRetryPolicy(policy.second);
+
+			std::vector<MonitorBrightnessConfiguration> config;
+			for (size_t i = 0; i < count; i++) config.push_back({SimulatedBackend::IdForIndex(i), 50});
+
+			bench.Run(policy.first, count, [&](size_t i) {
+				for (auto &entry: config) entry.brightness = static_cast<int>(i % 100);
+				service.SetBrightness(config);
+			}, iterations);
+		}
+	}
+}
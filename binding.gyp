@@ -1,41 +1,121 @@
-{
-  "win_delay_load_hook": "true",
-  "targets": [
-    {
-      "target_name": "lumi",
-      "cflags!": [
-        "-fno-exceptions",
-        "/ZW"
-      ],
-      "cflags_cc!": [
-        "-fno-exceptions"
-      ],
-      "libraries": [
-        "-lwindowsapp",
-        "-lDxva2",
-        "-lwmiutils",
-        "-lwbemuuid",
-      ],
-      "msvs_settings": {
-        "VCCLCompilerTool": {
-          "ExceptionHandling": 1,
-          "AdditionalOptions": [
-            "-std:c++17"
-          ]
-        }
-      },
-      "sources": [
-        "./src/index.cpp",
-        "./src/utils.cpp",
-        "./src/hash.cpp",
-        "./src/display_config_helper.cpp"
-      ],
-      "include_dirs": [
-        "<!@(node -p \"require('node-addon-api').include\")"
-      ],
-      "defines": [
-        "NAPI_DISABLE_CPP_EXCEPTIONS"
-      ]
-    }
-  ]
-}
+{
+  "win_delay_load_hook": "true",
+  "targets": [
+    {
+      "target_name": "lumi",
+      "cflags!": [
+        "-fno-exceptions",
+        "/ZW"
+      ],
+      "cflags_cc!": [
+        "-fno-exceptions"
+      ],
+      "msvs_settings": {
+        "VCCLCompilerTool": {
+          "ExceptionHandling": 1,
+          "AdditionalOptions": [
+            "-std:c++17"
+          ]
+        }
+      },
+      "sources": [
+        "./src/index.cpp",
+        "./src/utils.cpp",
+        "./src/hash.cpp"
+      ],
+      "conditions": [
+        ["OS=='win'", {
+          "libraries": [
+            "-lwindowsapp",
+            "-lDxva2",
+            "-lwmiutils",
+            "-lwbemuuid",
+          ],
+          "sources": [
+            "./src/display_config_helper.cpp"
+          ]
+        }]
+      ],
+      "include_dirs": [
+        "<!@(node -p \"require('node-addon-api').include\")"
+      ],
+      "defines": [
+        "NAPI_DISABLE_CPP_EXCEPTIONS"
+      ]
+    },
+    {
+      "target_name": "lumi_bench",
+      "type": "executable",
+      "cflags!": [
+        "-fno-exceptions"
+      ],
+      "cflags_cc!": [
+        "-fno-exceptions"
+      ],
+      "msvs_settings": {
+        "VCCLCompilerTool": {
+          "ExceptionHandling": 1,
+          "AdditionalOptions": [
+            "-std:c++17"
+          ]
+        }
+      },
+      "sources": [
+        "./bench/main.cpp",
+        "./bench/ddc_bench.cpp",
+        "./bench/edid_bench.cpp",
+        "./bench/engine_bench.cpp",
+        "./bench/parallel_apply_bench.cpp",
+        "./bench/priority_bench.cpp",
+        "./bench/retry_bench.cpp"
+      ],
+      "include_dirs": [
+        "./src"
+      ]
+    },
+    {
+      "target_name": "lumi_test",
+      "type": "executable",
+      "cflags!": [
+        "-fno-exceptions"
+      ],
+      "cflags_cc!": [
+        "-fno-exceptions"
+      ],
+      "msvs_settings": {
+        "VCCLCompilerTool": {
+          "ExceptionHandling": 1,
+          "AdditionalOptions": [
+            "-std:c++17"
+          ]
+        }
+      },
+      "sources": [
+        "./test/native/main.cpp",
+        "./test/native/adaptive_poller_test.cpp",
+        "./test/native/cancellation_test.cpp",
+        "./test/native/edid_test.cpp",
+        "./test/native/fade_scheduler_test.cpp",
+        "./test/native/io_executor_test.cpp",
+        "./test/native/monitor_health_test.cpp",
+        "./test/native/monitor_identity_test.cpp",
+        "./test/native/monitor_service_test.cpp",
+        "./test/native/retry_policy_test.cpp",
+        "./test/native/simulated_backend_test.cpp",
+        "./test/native/write_coalescer_test.cpp",
+        "./src/hash.cpp"
+      ],
+      "conditions": [
+        ["OS=='linux'", {
+          "sources": [
+            "./test/native/ddc_test.cpp",
+            "./test/native/sysfs_backend_test.cpp"
+          ]
+        }]
+      ],
+      "include_dirs": [
+        "./src"
+      ]
+    }
+  ]
+}
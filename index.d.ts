@@ -1,71 +1,468 @@
-declare module 'lumi-control' {
-    export type ALL_MONITORS = "GLOBAL";
-    export const GLOBAL: ALL_MONITORS;
-
-    export interface BrightnessConfiguration {
-        [monitorId: string]: number;
-    }
-
-    export interface Monitor {
-        id: string;
-        displayId: string;
-        name: string;
-        manufacturer: string;
-        serialNumber: string;
-        productCode: string;
-        internal: boolean;
-        size: {
-            width: number;
-            height: number;
-        };
-        position: { x: number; y: number };
-    }
-
-    export interface GetBrightnessResult {
-        success: boolean;
-        brightness: null | number;
-    }
-
-    export interface SetBrightnessResult {
-        success: boolean;
-        message: null | string;
-    }
-
-    /**
-     * Attempts to get the primary monitor's brightness.
-     */
-    export function get(): Promise<GetBrightnessResult>;
-
-    /**
-     * Attempts to get a monitor's brightness by id.
-     * @param {string} monitorId
-     * @returns {Promise<GetBrightnessResult>} When success is true, brightness is a number. Otherwise, brightness is null.
-     */
-    export function get(monitorId: string): Promise<GetBrightnessResult>;
-
-    /**
-     * Attempts to set the primary monitor's brightness.
-     * @param brightness
-     */
-    export function set(brightness: number): Promise<SetBrightnessResult>;
-
-    /**
-     * Can be used to set brightness levels for different monitors.
-     * @param config
-     */
-    export function set(config: BrightnessConfiguration): Promise<SetBrightnessResult>;
-
-    /**
-     * Attempts to set a monitor's brightness. Use GLOBAL constant as the monitorId to set a global brightness level.
-     * @param monitorId
-     * @param brightness
-     * @returns {Promise<SetBrightnessResult>} When success is false, provides an error message.
-     */
-    export function set(monitorId: string | ALL_MONITORS, brightness: number): Promise<SetBrightnessResult>;
-
-    /**
-     * Returns an array of monitors.
-     * @returns {Array<Monitor>}
-     */
-    export function monitors(): Array<Monitor>;
+declare module 'lumi-control' {
+    export type ALL_MONITORS = "GLOBAL";
+    export const GLOBAL: ALL_MONITORS;
+
+    /**
+     * Per-monitor result codes of setMany().
+     */
+    export const SetStatus: {
+        readonly OK: 0;
+        /**
+         * Superseded by a newer write to the same monitor before it was sent.
+         */
+        readonly COALESCED: 1;
+        readonly NOT_FOUND: 2;
+        readonly WRITE_FAILED: 3;
+        /**
+         * Not attempted because the monitor's circuit is open; see health().
+         */
+        readonly UNAVAILABLE: 4;
+        /**
+         * Not attempted because the request's timeoutMs passed first.
+         */
+        readonly TIMED_OUT: 5;
+        /**
+         * Not attempted because the request's signal was aborted first.
+         */
+        readonly ABORTED: 6;
+    };
+
+    /**
+     * Why a request settled without its result: its timeoutMs passed or its signal was aborted.
+     */
+    export type CancelError = "TIMEOUT" | "ABORTED";
+
+    export interface BrightnessConfiguration {
+        [monitorId: string]: number;
+    }
+
+    export interface Monitor {
+        id: string;
+        displayId: string;
+        name: string;
+        manufacturer: string;
+        serialNumber: string;
+        productCode: string;
+        internal: boolean;
+        size: {
+            width: number;
+            height: number;
+        };
+        position: { x: number; y: number };
+    }
+
+    export interface MonitorCapabilities {
+        /**
+         * Brightness can be read and set.
+         */
+        brightness: boolean;
+        /**
+         * Raw range reported by the hardware; lumi always uses 0-100.
+         */
+        minBrightness: number;
+        maxBrightness: number;
+    }
+
+    export type DiscoveryEvent =
+        | { type: "identity" | "details"; monitor: Monitor }
+        | { type: "capabilities"; monitor: Monitor; capabilities: MonitorCapabilities; brightness: null | number };
+
+    export interface TopologyChange {
+        added: Array<Monitor>;
+        removed: Array<Monitor>;
+        /**
+         * Monitors that kept their id but changed name, geometry or any other field.
+         */
+        changed: Array<Monitor>;
+    }
+
+    export interface BrightnessChange {
+        id: string;
+        brightness: number;
+        /**
+         * How the change was noticed: reported by the system, or found by a periodic read.
+         */
+        source: "notification" | "poll";
+    }
+
+    export interface GetBrightnessResult {
+        success: boolean;
+        brightness: null | number;
+        /**
+         * Why the monitor could not be read; null on success.
+         */
+        error: null | "NOT_FOUND" | "READ_FAILED" | "UNAVAILABLE" | CancelError;
+    }
+
+    export interface CachedBrightness {
+        brightness: number;
+        /**
+         * Milliseconds since the value was read, written or reported by a 'brightness' listener.
+         */
+        age: number;
+    }
+
+    export interface GetAllBrightnessResult {
+        /**
+         * True when every monitor was read.
+         */
+        success: boolean;
+        /**
+         * Brightness per monitor id; null when the monitor could not be read.
+         */
+        brightness: { [monitorId: string]: null | number };
+        /**
+         * Reason per monitor id that could not be read.
+         */
+        errors: { [monitorId: string]: "READ_FAILED" | "UNAVAILABLE" | CancelError };
+        /**
+         * Set, with brightness empty, when the whole request was cancelled.
+         */
+        error: null | CancelError;
+    }
+
+    export interface SetBrightnessResult {
+        success: boolean;
+        message: null | string;
+        /**
+         * True when the write was superseded by a newer one to the same monitor before it was sent, and the newer
+         * write landed. If the newer write failed, so does this one.
+         */
+        coalesced: boolean;
+        /**
+         * Set when the request was cancelled; writes that were still queued were dropped.
+         */
+        error: null | CancelError;
+    }
+
+    export type CircuitState = "closed" | "open" | "half-open";
+
+    export interface MonitorHealth {
+        id: string;
+        /**
+         * "open" while the monitor's operations fail without touching it; "half-open" while one operation probes
+         * whether it recovered.
+         */
+        state: CircuitState;
+        consecutiveFailures: number;
+        successes: number;
+        failures: number;
+        /**
+         * Operations failed right away because the circuit was open.
+         */
+        rejected: number;
+        /**
+         * Milliseconds the last operation on the monitor took.
+         */
+        lastLatency: number;
+        /**
+         * Moving average of recent operations, in milliseconds.
+         */
+        averageLatency: number;
+        /**
+         * Milliseconds until an open circuit lets a probe through; 0 otherwise.
+         */
+        retryIn: number;
+    }
+
+    export interface IdentityCollision {
+        /**
+         * The displayId both monitors would have had; the second one was given another, unstable one.
+         */
+        displayId: string;
+        monitorIds: string[];
+        /**
+         * True when both report the same EDID identity on the same connector; false when two identities hashed alike.
+         */
+        identical: boolean;
+    }
+
+    export interface SetManyOptions extends SetBrightnessOptions {
+        /**
+         * Receives the results; must hold at least one byte per handle (setMany() throws a TypeError otherwise). A
+         * new array is allocated if omitted.
+         */
+        status?: Uint8Array;
+    }
+
+    /**
+     * "interactive" requests run before anything else queued for their monitor's bus; "background" ones after
+     * everything else, and only for a share of the bus's time.
+     */
+    export type Priority = "interactive" | "normal" | "background";
+
+    export interface RequestOptions {
+        /**
+         * Defaults to "normal".
+         */
+        priority?: Priority;
+        /**
+         * Milliseconds the request may take, counted from the call. A request still waiting for its monitor is
+         * dropped when they pass, and it settles with the error "TIMEOUT" (SetStatus.TIMED_OUT for setMany()).
+         * Infinity, or more than 2147483647, means no deadline.
+         */
+        timeoutMs?: number;
+        /**
+         * Aborting it settles the request with the error "ABORTED" (SetStatus.ABORTED for setMany()) and drops
+         * whatever is still waiting for its monitor.
+         */
+        signal?: AbortSignal;
+    }
+
+    export interface GetBrightnessOptions extends RequestOptions {
+        /**
+         * Read the monitor even if a cached value is still valid.
+         */
+        fresh?: boolean;
+    }
+
+    export type FadeEasing = "linear" | "easeIn" | "easeOut" | "easeInOut";
+
+    export interface FadeOptions {
+        /**
+         * Defaults to "linear".
+         */
+        easing?: FadeEasing;
+    }
+
+    export interface FadeResult {
+        /**
+         * True when the final value was applied to every monitor.
+         */
+        success: boolean;
+        status: "completed" | "failed" | "cancelled" | "superseded";
+    }
+
+    export interface FadePromise extends Promise<FadeResult> {
+        /**
+         * Stops the fade at its current level. Returns false if it already finished.
+         */
+        cancel(): boolean;
+    }
+
+    export interface Configuration {
+        /**
+         * How long, in milliseconds, a read or written brightness is served from the cache. 0 disables the cache.
+         * Defaults to 1000.
+         */
+        cacheMaxAge?: number;
+        /**
+         * Shortest interval, in milliseconds, at which monitors that cannot report brightness changes are polled while
+         * a 'brightness' listener is registered. Defaults to 2000.
+         */
+        minPollInterval?: number;
+        /**
+         * Longest polling interval, reached while a monitor's brightness does not change. Defaults to 30000.
+         */
+        maxPollInterval?: number;
+        /**
+         * How failed monitor reads and writes are retried. Omitted fields take their defaults.
+         */
+        retry?: RetryOptions;
+        /**
+         * When a monitor that keeps failing is taken out of service, and for how long.
+         */
+        circuitBreaker?: CircuitBreakerOptions;
+        /**
+         * Fraction of each bus's time background requests and polls may take, between 0.01 and 1 (no limit).
+         * Defaults to 0.5.
+         */
+        backgroundShare?: number;
+    }
+
+    export interface CircuitBreakerOptions {
+        /**
+         * Consecutive failed operations that open a monitor's circuit; 0 never opens it. Defaults to 3.
+         */
+        failureThreshold?: number;
+        /**
+         * Milliseconds an open circuit fails operations before letting one through as a probe. Defaults to 5000.
+         */
+        cooldown?: number;
+    }
+
+    export interface RetryOptions {
+        /**
+         * Tries per way of reaching a monitor, including the first. Defaults to 3.
+         */
+        attempts?: number;
+        /**
+         * Delay, in milliseconds, before the first retry. Defaults to 5.
+         */
+        initialDelay?: number;
+        /**
+         * Longest delay between retries, in milliseconds. Defaults to 100.
+         */
+        maxDelay?: number;
+        /**
+         * Factor each delay grows by. Defaults to 2.
+         */
+        multiplier?: number;
+        /**
+         * Fraction of each delay that is random, from 0 to 1. Defaults to 0.5.
+         */
+        jitter?: number;
+        /**
+         * Remember which way of reaching each monitor worked and try it first next time. Defaults to true.
+         */
+        learn?: boolean;
+    }
+
+    export interface SetBrightnessOptions extends RequestOptions {
+        /**
+         * Collapse pending writes to the same monitor to the newest value. Only one write per monitor is in flight
+         * at a time; writes replaced while waiting resolve with coalesced set to true.
+         */
+        coalesce?: boolean;
+    }
+
+    /**
+     * Attempts to get the primary monitor's brightness.
+     * @param options
+     */
+    export function get(options?: GetBrightnessOptions): Promise<GetBrightnessResult>;
+
+    /**
+     * Attempts to get a monitor's brightness by id.
+     * @param {string} monitorId
+     * @param options
+     * @returns {Promise<GetBrightnessResult>} When success is true, brightness is a number. Otherwise, brightness is null.
+     */
+    export function get(monitorId: string, options?: GetBrightnessOptions): Promise<GetBrightnessResult>;
+
+    /**
+     * Attempts to get a monitor's brightness by handle.
+     * @param handle A handle from handle().
+     * @param options
+     */
+    export function get(handle: number, options?: GetBrightnessOptions): Promise<GetBrightnessResult>;
+
+    /**
+     * Returns the last known brightness of a monitor (by id or handle; the primary monitor if omitted) without reading
+     * the hardware, or null if none is known.
+     * @param monitor
+     */
+    export function getCached(monitor?: string | number): null | CachedBrightness;
+
+    /**
+     * Reads every monitor's brightness with a single enumeration; monitors are read in parallel.
+     * @param options
+     */
+    export function getAll(options?: GetBrightnessOptions): Promise<GetAllBrightnessResult>;
+
+    /**
+     * Attempts to set the primary monitor's brightness.
+     * @param brightness
+     * @param options
+     */
+    export function set(brightness: number, options?: SetBrightnessOptions): Promise<SetBrightnessResult>;
+
+    /**
+     * Can be used to set brightness levels for different monitors.
+     * @param config
+     * @param options
+     */
+    export function set(config: BrightnessConfiguration, options?: SetBrightnessOptions): Promise<SetBrightnessResult>;
+
+    /**
+     * Attempts to set a monitor's brightness. Use GLOBAL constant as the monitorId to set a global brightness level.
+     * @param monitorId
+     * @param brightness
+     * @param options
+     * @returns {Promise<SetBrightnessResult>} When success is false, provides an error message.
+     */
+    export function set(monitorId: string | ALL_MONITORS, brightness: number, options?: SetBrightnessOptions): Promise<SetBrightnessResult>;
+
+    /**
+     * Attempts to set a monitor's brightness by handle, without converting or looking up an id string.
+     * @param handle A handle from handle().
+     * @param brightness
+     * @param options
+     */
+    export function set(handle: number, brightness: number, options?: SetBrightnessOptions): Promise<SetBrightnessResult>;
+
+    /**
+     * Sets levels[i] on the monitor of handles[i], all monitors in parallel.
+     * @param handles Handles from handle().
+     * @param levels One brightness per handle.
+     * @param options
+     * @returns {Promise<Uint8Array>} One SetStatus code per handle.
+     */
+    export function setMany(handles: Uint32Array, levels: Uint8Array, options?: SetManyOptions): Promise<Uint8Array>;
+
+    /**
+     * Returns a small integer naming the monitor ("primary" allowed) for the handle forms of get() and set(), or null
+     * if there is no such monitor. Handles stay valid across display changes while the monitor is connected.
+     * @param monitorId
+     */
+    export function handle(monitorId: string): null | number;
+
+    /**
+     * Returns the OS primary display, or null when there are no monitors.
+     */
+    export function primary(): null | Monitor;
+
+    /**
+     * Returns the circuit state, outcome counts and latency of every connected monitor.
+     */
+    export function health(): MonitorHealth[];
+
+    /**
+     * Returns the monitors of the current topology whose displayId is not stable because their identities collided;
+     * empty normally.
+     */
+    export function collisions(): IdentityCollision[];
+
+    /**
+     * Smoothly changes a monitor's brightness, or every monitor's with the GLOBAL constant, over durationMs. Starting
+     * a fade on a monitor that is already fading supersedes the running fade.
+     * @param monitorId
+     * @param target
+     * @param durationMs
+     * @param options
+     * @returns {FadePromise} Resolves once the final value has been applied.
+     */
+    export function fade(monitorId: string | ALL_MONITORS, target: number, durationMs: number, options?: FadeOptions): FadePromise;
+
+    /**
+     * Returns an array of monitors.
+     * @returns {Array<Monitor>}
+     */
+    export function monitors(): Array<Monitor>;
+
+    /**
+     * Enumerates monitors without blocking the calling thread.
+     * @returns {Promise<Array<Monitor>>}
+     */
+    export function monitorsAsync(): Promise<Array<Monitor>>;
+
+    /**
+     * Streams monitors as they are found: identity first, then details and probe results.
+     * @returns {AsyncGenerator<DiscoveryEvent>}
+     */
+    export function discover(): AsyncGenerator<DiscoveryEvent, void, undefined>;
+
+    /**
+     * Subscribes to display changes ('topology') or brightness changes made outside lumi ('brightness'). The native
+     * watcher runs while at least one listener is registered.
+     */
+    export function on(event: "topology", listener: (change: TopologyChange) => void): typeof import("lumi-control");
+    export function on(event: "brightness", listener: (change: BrightnessChange) => void): typeof import("lumi-control");
+
+    export function once(event: "topology", listener: (change: TopologyChange) => void): typeof import("lumi-control");
+    export function once(event: "brightness", listener: (change: BrightnessChange) => void): typeof import("lumi-control");
+
+    export function off(event: "topology", listener: (change: TopologyChange) => void): typeof import("lumi-control");
+    export function off(event: "brightness", listener: (change: BrightnessChange) => void): typeof import("lumi-control");
+
+    /**
+     * Discards the cached display topology and brightness values. The topology is rebuilt on the next call.
+     */
+    export function refresh(): void;
+
+    /**
+     * Changes engine settings for the whole process.
+     * @param options
+     */
+    export function configure(options: Configuration): void;
 }
\ No newline at end of file
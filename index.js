@@ -1 +1,69 @@
-module.exports = require("./build/Release/lumi.node");
\ No newline at end of file
+const {EventEmitter} = require("events");
+const {discover: startDiscovery, watchTopology, unwatchTopology, watchBrightness, unwatchBrightness, ...lumi} = require("./build/Release/lumi.node");
+
+// Native watchers behind each event; they run only while the event has listeners.
+const watchers = {
+    topology: [watchTopology, unwatchTopology],
+    brightness: [watchBrightness, unwatchBrightness],
+};
+
+const events = new EventEmitter();
+const handles = {};
+
+events.on("newListener", (event) => {
+    if (watchers[event] && events.listenerCount(event) === 0) {
+        handles[event] = watchers[event][0]((data) => events.emit(event, data));
+    }
+});
+
+events.on("removeListener", (event) => {
+    if (watchers[event] && events.listenerCount(event) === 0 && handles[event]) {
+        watchers[event][1](handles[event]);
+        delete handles[event];
+    }
+});
+
+// Yields discovery events as the native side reports them: every monitor's
+// identity first, then its details and probe results.
+async function* discover() {
+    const events = [];
+    let finished = false;
+    let wake = null;
+
+    startDiscovery((event) => {
+        if (event === null) finished = true;
+        else events.push(event);
+
+        if (wake) {
+            wake();
+            wake = null;
+        }
+    });
+
+    while (true) {
+        if (events.length > 0) {
+            yield events.shift();
+        } else if (finished) {
+            return;
+        } else {
+            await new Promise((resolve) => (wake = resolve));
+        }
+    }
+}
+
+module.exports = {
+    ...lumi,
+    discover,
+    on(event, listener) {
+        events.on(event, listener);
+        return module.exports;
+    },
+    once(event, listener) {
+        events.once(event, listener);
+        return module.exports;
+    },
+    off(event, listener) {
+        events.off(event, listener);
+        return module.exports;
+    },
+};
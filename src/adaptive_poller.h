@@ -0,0 +1,152 @@
+#ifndef ADAPTIVE_POLLER_H
+#define ADAPTIVE_POLLER_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Polls values that cannot notify about changes (e.g. DDC/CI brightness) at a
+// rate that follows how often they change. Each key starts at the minimum
+// interval; every poll that saw no change doubles it up to the maximum, and a
+// change drops it back to the minimum. A key has at most one poll in flight;
+// the poll function reports the outcome through its callback, from any thread.
+class AdaptivePoller {
+public:
+	typedef std::chrono::steady_clock Clock;
+	typedef std::function<void(bool changed)> Done;
+	typedef std::function<void(const std::string &key, Done done)> Poll;
+
+private:
+	struct Key {
+		Clock::duration interval{0};
+		Clock::time_point next;
+		bool polling = false;
+	};
+
+	// Shared with pending Done callbacks, which may outlive the poller.
+	struct State {
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::unordered_map<std::string, Key> keys;
+		Clock::duration minimum;
+		Clock::duration maximum;
+		bool stopping = false;
+	};
+
+	Poll poll;
+	std::shared_ptr<State> state = std::make_shared<State>();
+	std::thread thread;
+
+	void Run() {
+		std::unique_lock<std::mutex> lock(state->mutex);
+
+		while (!state->stopping) {
+			auto now = Clock::now();
+			auto next = now + std::chrono::hours(1);
+			std::vector<std::string> due;
+
+			for (auto &entry: state->keys) {
+				Key &key = entry.second;
+				if (key.polling) continue;
+				if (key.next <= now) {
+					key.polling = true;
+					due.push_back(entry.first);
+				} else {
+					next = std::min(next, key.next);
+				}
+			}
+
+			if (!due.empty()) {
+				lock.unlock();
+				for (const auto &key: due) poll(key, MakeDone(key));
+				lock.lock();
+				continue;
+			}
+
+			state->wake.wait_until(lock, next);
+		}
+	}
+
+	Done MakeDone(const std::string &name) {
+		std::weak_ptr<State> weak = state;
+
+		return [weak, name](bool changed) {
+			auto state = weak.lock();
+			if (!state) return;
+
+			std::lock_guard<std::mutex> lock(state->mutex);
+			auto it = state->keys.find(name);
+			if (it == state->keys.end()) return;
+
+			Key &key = it->second;
+			key.polling = false;
+			key.interval = changed ? state->minimum : std::min(key.interval * 2, state->maximum);
+			key.next = Clock::now() + key.interval;
+			state->wake.notify_all();
+		};
+	}
+
+public:
+	AdaptivePoller(Poll poll, Clock::duration minimum, Clock::duration maximum) : poll(std::move(poll)) {
+		state->minimum = minimum;
+		state->maximum = std::max(minimum, maximum);
+	}
+
+	AdaptivePoller(const AdaptivePoller &) = delete;
+	AdaptivePoller &operator=(const AdaptivePoller &) = delete;
+
+	~AdaptivePoller() {
+		{
+			std::lock_guard<std::mutex> lock(state->mutex);
+			state->stopping = true;
+			state->wake.notify_all();
+		}
+
+		if (thread.joinable()) thread.join();
+	}
+
+	void SetIntervals(Clock::duration minimum, Clock::duration maximum) {
+		std::lock_guard<std::mutex> lock(state->mutex);
+		state->minimum = minimum;
+		state->maximum = std::max(minimum, maximum);
+		for (auto &entry: state->keys) entry.second.interval = std::clamp(entry.second.interval, state->minimum, state->maximum);
+	}
+
+	// Replaces the polled keys. Keys already polled keep their interval; new
+	// ones are first polled after the minimum interval.
+	void SetKeys(const std::vector<std::string> &names) {
+		std::lock_guard<std::mutex> lock(state->mutex);
+		std::unordered_map<std::string, Key> keys;
+
+		for (const auto &name: names) {
+			auto it = state->keys.find(name);
+			if (it != state->keys.end()) {
+				keys.emplace(name, it->second);
+			} else {
+				Key key;
+				key.interval = state->minimum;
+				key.next = Clock::now() + key.interval;
+				keys.emplace(name, key);
+			}
+		}
+
+		state->keys = std::move(keys);
+		if (!state->keys.empty() && !thread.joinable()) thread = std::thread([this]() { Run(); });
+		state->wake.notify_all();
+	}
+
+	Clock::duration GetInterval(const std::string &name) {
+		std::lock_guard<std::mutex> lock(state->mutex);
+		auto it = state->keys.find(name);
+		return it != state->keys.end() ? it->second.interval : Clock::duration(0);
+	}
+};
+
+#endif// ADAPTIVE_POLLER_H
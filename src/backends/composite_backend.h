@@ -0,0 +1,126 @@
+#ifndef COMPOSITE_BACKEND_H
+#define COMPOSITE_BACKEND_H
+
+#include "../hash.h"
+#include "display_backend.h"
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Presents several backends as one, e.g. backlight panels and DDC/CI monitors
+// on Linux. Each ref remembers which backend produced it so I/O is routed back
+// without a lookup.
+class CompositeBackend : public DisplayBackend {
+private:
+	std::vector<std::shared_ptr<DisplayBackend>> backends;
+
+	struct Watchers : DisplayWatcher {
+		std::vector<std::unique_ptr<DisplayWatcher>> watchers;
+	};
+
+	std::vector<MonitorRef> RefsFrom(const std::vector<MonitorRef> &refs, size_t source) {
+		std::vector<MonitorRef> subset;
+		for (const auto &ref: refs) {
+			if (ref.source == source) subset.push_back(ref);
+		}
+		return subset;
+	}
+
+public:
+	explicit CompositeBackend(std::vector<std::shared_ptr<DisplayBackend>> backends) : backends(std::move(backends)) {}
+
+	std::uint64_t GetTopologyStamp() override {
+		std::uint64_t stamp = 0;
+		for (const auto &backend: backends) stamp = HashInts64(stamp, backend->GetTopologyStamp());
+		return stamp;
+	}
+
+	std::vector<MonitorRef> GetMonitorRefs() override {
+		std::vector<MonitorRef> refs;
+
+		for (size_t i = 0; i < backends.size(); i++) {
+			for (auto &ref: backends[i]->GetMonitorRefs()) {
+				ref.source = i;
+				refs.emplace_back(std::move(ref));
+			}
+		}
+
+		return refs;
+	}
+
+	std::vector<Monitor> GetAvailableMonitors(const std::vector<MonitorRef> &refs) override {
+		std::vector<Monitor> monitors;
+
+		for (size_t i = 0; i < backends.size(); i++) {
+			for (auto &monitor: backends[i]->GetAvailableMonitors(RefsFrom(refs, i))) {
+				monitors.emplace_back(std::move(monitor));
+			}
+		}
+
+		return monitors;
+	}
+
+	void ReleaseMonitorRefs(const std::vector<MonitorRef> &refs) override {
+		for (size_t i = 0; i < backends.size(); i++) {
+			backends[i]->ReleaseMonitorRefs(RefsFrom(refs, i));
+		}
+	}
+
+	int GetMonitorBrightness(const MonitorRef &ref) override {
+		return ref.source < backends.size() ? backends[ref.source]->GetMonitorBrightness(ref) : -1;
+	}
+
+	std::unordered_map<std::string, int> GetBatchBrightness(const std::vector<MonitorRef> &refs) override {
+		std::unordered_map<std::string, int> brightness;
+
+		for (size_t i = 0; i < backends.size(); i++) {
+			for (auto &entry: backends[i]->GetBatchBrightness(RefsFrom(refs, i))) brightness.insert(entry);
+		}
+
+		return brightness;
+	}
+
+	bool SetMonitorBrightness(const MonitorRef &ref, int brightness) override {
+		return ref.source < backends.size() && backends[ref.source]->SetMonitorBrightness(ref, brightness);
+	}
+
+	// Any backend noticing a change counts as a change of the whole.
+	std::unique_ptr<DisplayWatcher> WatchTopology(std::function<void()> onChange) override {
+		auto result = std::make_unique<Watchers>();
+
+		for (const auto &backend: backends) {
+			if (auto watcher = backend->WatchTopology(onChange)) result->watchers.emplace_back(std::move(watcher));
+		}
+
+		if (result->watchers.empty()) return nullptr;
+		return result;
+	}
+
+	bool CanWatchBrightness(const MonitorRef &ref) override {
+		return ref.source < backends.size() && backends[ref.source]->CanWatchBrightness(ref);
+	}
+
+	std::unique_ptr<DisplayWatcher> WatchBrightness(const std::vector<MonitorRef> &refs, std::function<void(const std::string &id)> onChange) override {
+		auto result = std::make_unique<Watchers>();
+
+		for (size_t i = 0; i < backends.size(); i++) {
+			auto subset = RefsFrom(refs, i);
+			if (subset.empty()) continue;
+			if (auto watcher = backends[i]->WatchBrightness(subset, onChange)) result->watchers.emplace_back(std::move(watcher));
+		}
+
+		if (result->watchers.empty()) return nullptr;
+		return result;
+	}
+
+	void SetRetryPolicy(const RetryPolicy &policy) override {
+		for (const auto &backend: backends) backend->SetRetryPolicy(policy);
+	}
+
+	MonitorCapabilities ProbeMonitor(const MonitorRef &ref) override {
+		return ref.source < backends.size() ? backends[ref.source]->ProbeMonitor(ref) : MonitorCapabilities();
+	}
+};
+
+#endif// COMPOSITE_BACKEND_H
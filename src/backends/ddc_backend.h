@@ -0,0 +1,267 @@
+#ifndef DDC_BACKEND_H
+#define DDC_BACKEND_H
+
+#include "../ddc/ddc_bus_scheduler.h"
+#include "../ddc/ddc_ci.h"
+#include "../ddc/ddc_transport.h"
+#include "../edid.h"
+#include "../hash.h"
+#include "display_backend.h"
+#include "sysfs_watcher.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+typedef std::function<std::unique_ptr<DdcTransport>(const std::string &bus)> DdcTransportFactory;
+
+// External monitors on Linux, driven over DDC/CI. Connected DRM connectors
+// (<root>/class/drm/card*-*) are mapped to the i2c bus behind their "ddc" link;
+// each bus gets one transport that is created on first sight and then reused
+// for every transaction, paced by the bus's DdcBusScheduler.
+class DdcBackend : public DisplayBackend {
+private:
+	struct Bus {
+		std::string name;
+		std::unique_ptr<DdcTransport> transport;
+		std::unique_ptr<DdcBusScheduler> scheduler;
+		// A bus carries one transaction at a time.
+		std::mutex mutex;
+		uint16_t maxBrightness = 0;
+	};
+
+	struct Connector {
+		std::string name;
+		std::string bus;
+	};
+
+	std::string root;
+	std::string drmPath;
+	DdcTransportFactory transportFactory;
+	DdcTiming timing;
+	std::mutex policyMutex;
+	RetryPolicy retryPolicy;
+	std::mutex mutex;
+	std::unordered_map<std::string, std::unique_ptr<Bus>> buses;
+
+	static bool IsInternalConnector(const std::string &name) {
+		for (const char *type: {"-eDP-", "-LVDS-", "-DSI-"}) {
+			if (name.find(type) != std::string::npos) return true;
+		}
+		return false;
+	}
+
+	static std::string ReadLine(const std::string &path) {
+		std::ifstream stream(path);
+		std::string line;
+		std::getline(stream, line);
+		return line;
+	}
+
+	// Reads the base block of the connector's EDID into buffer.
+	static bool ReadEdid(const std::string &path, uint8_t (&buffer)[Edid::BLOCK_LENGTH]) {
+		int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd == -1) return false;
+		ssize_t length = read(fd, buffer, sizeof(buffer));
+		close(fd);
+		return length == static_cast<ssize_t>(sizeof(buffer));
+	}
+
+	static std::string BusFromLink(const std::string &path) {
+		char target[256];
+		ssize_t length = readlink(path.c_str(), target, sizeof(target) - 1);
+		if (length <= 0) return "";
+		target[length] = '\0';
+		std::string link = target;
+		return link.substr(link.find_last_of('/') + 1);
+	}
+
+	std::vector<Connector> ListConnectors() {
+		std::vector<Connector> connectors;
+		DIR *dir = opendir(drmPath.c_str());
+
+		if (dir == nullptr) return connectors;
+
+		while (dirent *entry = readdir(dir)) {
+			std::string name = entry->d_name;
+			if (name.rfind("card", 0) != 0 || name.find('-') == std::string::npos || IsInternalConnector(name)) continue;
+
+			std::string path = drmPath + "/" + name;
+			if (ReadLine(path + "/status") != "connected") continue;
+
+			std::string bus = BusFromLink(path + "/ddc");
+			if (bus.empty()) continue;
+
+			connectors.push_back({name, bus});
+		}
+
+		closedir(dir);
+		std::sort(connectors.begin(), connectors.end(), [](const Connector &a, const Connector &b) {
+			return a.name < b.name;
+		});
+
+		return connectors;
+	}
+
+	Bus *OpenBus(const std::string &name) {
+		auto it = buses.find(name);
+		if (it != buses.end()) return it->second.get();
+
+		std::unique_ptr<DdcTransport> transport = transportFactory(name);
+		if (!transport) return nullptr;
+
+		auto bus = std::make_unique<Bus>();
+		bus->name = name;
+		bus->transport = std::move(transport);
+		bus->scheduler = std::make_unique<DdcBusScheduler>(bus->transport.get(), timing);
+
+		Bus *result = bus.get();
+		buses.emplace(name, std::move(bus));
+		return result;
+	}
+
+	static Bus *BusFromRef(const MonitorRef &ref) {
+		return static_cast<Bus *>(ref.handle);
+	}
+
+	RetryPolicy CurrentPolicy() {
+		std::lock_guard<std::mutex> lock(policyMutex);
+		return retryPolicy;
+	}
+
+	bool ReadBrightness(Bus *bus, DdcCi::VcpValue &value) {
+		return Retry(CurrentPolicy(), [&]() {
+			if (!bus->scheduler->GetVcp(DdcCi::VCP_BRIGHTNESS, value) || value.maximum == 0) return false;
+			bus->maxBrightness = value.maximum;
+			return true;
+		});
+	}
+
+public:
+	DdcBackend(const std::string &root, DdcTransportFactory transportFactory, const DdcTiming &timing = {}, int maxRetries = 3)
+	    : root(root), drmPath(root + "/class/drm"), transportFactory(std::move(transportFactory)), timing(timing) {
+		retryPolicy.attempts = maxRetries;
+	}
+
+	void SetRetryPolicy(const RetryPolicy &policy) override {
+		std::lock_guard<std::mutex> lock(policyMutex);
+		retryPolicy = policy;
+	}
+
+	std::uint64_t GetTopologyStamp() override {
+		std::uint64_t stamp = 0;
+
+		for (const auto &connector: ListConnectors()) {
+			stamp = HashInts64(stamp, PersistentHash(connector.name + "/" + connector.bus));
+		}
+
+		return stamp;
+	}
+
+	std::vector<MonitorRef> GetMonitorRefs() override {
+		std::vector<MonitorRef> refs;
+		std::lock_guard<std::mutex> lock(mutex);
+
+		for (const auto &connector: ListConnectors()) {
+			Bus *bus = OpenBus(connector.bus);
+			if (bus == nullptr) continue;
+
+			MonitorRef ref;
+			ref.id = connector.name;
+			ref.connector = connector.name;
+			ref.name = connector.name.substr(connector.name.find('-') + 1);
+			ref.handle = bus;
+			ref.bus = connector.bus;
+			refs.emplace_back(ref);
+		}
+
+		return refs;
+	}
+
+	std::vector<Monitor> GetAvailableMonitors(const std::vector<MonitorRef> &refs) override {
+		std::vector<Monitor> monitors;
+
+		for (const auto &ref: refs) {
+			Monitor monitor;
+			monitor.id = ref.id;
+			monitor.displayId = ref.displayId;
+			monitor.name = ref.name;
+			monitor.size = ref.size;
+			monitor.position = ref.position;
+			monitor.handle = ref.handle;
+			monitor.internal = false;
+
+			uint8_t edid[Edid::BLOCK_LENGTH];
+			Edid::Info info;
+
+			if (ReadEdid(drmPath + "/" + ref.id + "/edid", edid) && Edid::Parse(edid, sizeof(edid), info)) {
+				monitor.manufacturer = info.manufacturer;
+				monitor.productCode = Edid::ProductCodeString(info);
+				monitor.serialNumber = Edid::SerialString(info);
+				if (!info.name.empty()) monitor.name = std::string(info.name);
+			}
+
+			monitors.emplace_back(monitor);
+		}
+
+		return monitors;
+	}
+
+	int GetMonitorBrightness(const MonitorRef &ref) override {
+		Bus *bus = BusFromRef(ref);
+		if (bus == nullptr) return -1;
+
+		std::lock_guard<std::mutex> lock(bus->mutex);
+		DdcCi::VcpValue value;
+
+		if (!ReadBrightness(bus, value)) return -1;
+
+		return static_cast<int>(std::lround(value.current * 100.0 / value.maximum));
+	}
+
+	bool SetMonitorBrightness(const MonitorRef &ref, int brightness) override {
+		Bus *bus = BusFromRef(ref);
+		if (bus == nullptr) return false;
+
+		std::lock_guard<std::mutex> lock(bus->mutex);
+		DdcCi::VcpValue value;
+
+		// The raw range is only known after the first read on this bus.
+		if (bus->maxBrightness == 0 && !ReadBrightness(bus, value)) return false;
+
+		auto raw = static_cast<uint16_t>(std::lround(std::clamp(brightness, 0, 100) * bus->maxBrightness / 100.0));
+
+		return Retry(CurrentPolicy(), [&]() { return bus->scheduler->SetVcp(DdcCi::VCP_BRIGHTNESS, raw); });
+	}
+
+	std::unique_ptr<DisplayWatcher> WatchTopology(std::function<void()> onChange) override {
+		return std::make_unique<SysfsWatcher>(root, "drm", std::move(onChange));
+	}
+
+	MonitorCapabilities ProbeMonitor(const MonitorRef &ref) override {
+		MonitorCapabilities capabilities;
+		Bus *bus = BusFromRef(ref);
+		if (bus == nullptr) return capabilities;
+
+		std::lock_guard<std::mutex> lock(bus->mutex);
+		DdcCi::VcpValue value;
+
+		if (ReadBrightness(bus, value)) {
+			capabilities.brightness = true;
+			capabilities.maxBrightness = value.maximum;
+		}
+
+		return capabilities;
+	}
+};
+
+#endif// DDC_BACKEND_H
@@ -0,0 +1,51 @@
+#ifndef DEFAULT_BACKEND_H
+#define DEFAULT_BACKEND_H
+
+#include "display_backend.h"
+#include "simulated_backend.h"
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include "win32_backend.h"
+#elif defined(__linux__)
+#include "../ddc/i2c_transport.h"
+#include "composite_backend.h"
+#include "ddc_backend.h"
+#include "sysfs_backend.h"
+#endif
+
+// LUMI_BACKEND=simulated swaps the platform backend for virtual monitors
+// configured through LUMI_SIMULATED (see ParseSimulatedBackendOptions), which
+// lets tests and benchmarks run without display hardware.
+inline std::shared_ptr<DisplayBackend> CreateDefaultBackend() {
+	const char *backend = std::getenv("LUMI_BACKEND");
+
+	if (backend != nullptr && std::string(backend) == "simulated") {
+		const char *spec = std::getenv("LUMI_SIMULATED");
+		return std::make_shared<SimulatedBackend>(ParseSimulatedBackendOptions(spec != nullptr ? spec : ""));
+	}
+
+#ifdef _WIN32
+	return std::make_shared<Win32Backend>();
+#elif defined(__linux__)
+	const char *variable = std::getenv("LUMI_SYSFS_ROOT");
+	std::string root = variable != nullptr ? variable : "/sys";
+
+	auto openBus = [](const std::string &bus) -> std::unique_ptr<DdcTransport> {
+		auto transport = std::make_unique<I2cTransport>("/dev/" + bus);
+		if (!transport->IsOpen()) return nullptr;
+		return transport;
+	};
+
+	return std::make_shared<CompositeBackend>(std::vector<std::shared_ptr<DisplayBackend>>{
+	        std::make_shared<SysfsBackend>(root),
+	        std::make_shared<DdcBackend>(root, openBus)});
+#else
+	return nullptr;
+#endif
+}
+
+#endif// DEFAULT_BACKEND_H
@@ -0,0 +1,78 @@
+#ifndef DISPLAY_BACKEND_H
+#define DISPLAY_BACKEND_H
+
+#include "../monitor.h"
+#include "../retry_policy.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Notifies about display changes until destroyed.
+class DisplayWatcher {
+public:
+	virtual ~DisplayWatcher() = default;
+};
+
+// A source of monitors and brightness I/O. The engine owns one backend for the
+// lifetime of the process and calls it from multiple threads, so implementations
+// must not keep per-call state in members.
+class DisplayBackend {
+public:
+	virtual ~DisplayBackend() = default;
+
+	// Cheap fingerprint of the current display configuration. The engine compares
+	// it on every call and only re-enumerates when it changes.
+	virtual std::uint64_t GetTopologyStamp() = 0;
+
+	virtual std::vector<MonitorRef> GetMonitorRefs() = 0;
+
+	virtual std::vector<Monitor> GetAvailableMonitors(const std::vector<MonitorRef> &refs) = 0;
+
+	// Called once a topology snapshot is no longer referenced by anyone.
+	virtual void ReleaseMonitorRefs(const std::vector<MonitorRef> &refs) {}
+
+	virtual int GetMonitorBrightness(const MonitorRef &ref) = 0;
+
+	// Reads the monitors the backend can serve with one bulk query (e.g. all
+	// internal panels through WMI), keyed by id. Monitors left out are read one
+	// by one with GetMonitorBrightness.
+	virtual std::unordered_map<std::string, int> GetBatchBrightness(const std::vector<MonitorRef> &refs) {
+		return {};
+	}
+
+	virtual bool SetMonitorBrightness(const MonitorRef &ref, int brightness) = 0;
+
+	// Calls onChange, from a thread of the watcher, whenever displays may have
+	// been connected, disconnected or rearranged. Spurious calls are fine; the
+	// engine re-enumerates and compares. Returns null if the backend cannot
+	// notice changes on its own.
+	virtual std::unique_ptr<DisplayWatcher> WatchTopology(std::function<void()> onChange) {
+		return nullptr;
+	}
+
+	// Whether WatchBrightness can observe the monitor's brightness without
+	// polling.
+	virtual bool CanWatchBrightness(const MonitorRef &ref) {
+		return false;
+	}
+
+	// Calls onChange with the id of any of refs (those CanWatchBrightness
+	// accepts) whose brightness may have changed, from a thread of the watcher.
+	// Returns null if the backend cannot push changes.
+	virtual std::unique_ptr<DisplayWatcher> WatchBrightness(const std::vector<MonitorRef> &refs, std::function<void(const std::string &id)> onChange) {
+		return nullptr;
+	}
+
+	// How failed reads and writes are retried, and whether the backend may
+	// remember which of its ways of reaching a monitor worked.
+	virtual void SetRetryPolicy(const RetryPolicy &policy) {}
+
+	// Talks to the monitor to find out whether (and how) its brightness can be
+	// controlled. May be as slow as a brightness read.
+	virtual MonitorCapabilities ProbeMonitor(const MonitorRef &ref) = 0;
+};
+
+#endif// DISPLAY_BACKEND_H
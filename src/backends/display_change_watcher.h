@@ -0,0 +1,89 @@
+#ifndef DISPLAY_CHANGE_WATCHER_H
+#define DISPLAY_CHANGE_WATCHER_H
+
+#include "display_backend.h"
+#include <dbt.h>
+#include <functional>
+#include <future>
+#include <thread>
+#include <utility>
+#include <windows.h>
+
+// Listens for WM_DISPLAYCHANGE (mode and arrangement changes) and
+// WM_DEVICECHANGE (monitors plugged or unplugged) on a hidden top-level window;
+// both are only broadcast to top-level windows, so a message-only window would
+// miss them. Bursts of messages are reported as one change.
+class DisplayChangeWatcher : public DisplayWatcher {
+private:
+	static constexpr UINT_PTR SETTLE_TIMER = 1;
+	static constexpr UINT SETTLE_MILLISECONDS = 250;
+
+	std::function<void()> onChange;
+	std::thread thread;
+	HWND window = nullptr;
+
+	static LRESULT CALLBACK WindowProc(HWND window, UINT message, WPARAM wParam, LPARAM lParam) {
+		auto *watcher = reinterpret_cast<DisplayChangeWatcher *>(GetWindowLongPtrW(window, GWLP_USERDATA));
+
+		switch (message) {
+			case WM_DISPLAYCHANGE:
+				SetTimer(window, SETTLE_TIMER, SETTLE_MILLISECONDS, nullptr);
+				return 0;
+			case WM_DEVICECHANGE:
+				if (wParam == DBT_DEVNODES_CHANGED) SetTimer(window, SETTLE_TIMER, SETTLE_MILLISECONDS, nullptr);
+				return TRUE;
+			case WM_TIMER:
+				KillTimer(window, SETTLE_TIMER);
+				if (watcher != nullptr) watcher->onChange();
+				return 0;
+			case WM_DESTROY:
+				PostQuitMessage(0);
+				return 0;
+			default:
+				return DefWindowProcW(window, message, wParam, lParam);
+		}
+	}
+
+	void Run(std::promise<HWND> &created) {
+		HINSTANCE instance = GetModuleHandleW(nullptr);
+		WNDCLASSW windowClass = {};
+		windowClass.lpfnWndProc = WindowProc;
+		windowClass.hInstance = instance;
+		windowClass.lpszClassName = L"LumiDisplayChangeWatcher";
+		RegisterClassW(&windowClass);
+
+		HWND handle = CreateWindowExW(0, windowClass.lpszClassName, L"", WS_OVERLAPPED, 0, 0, 0, 0, nullptr, nullptr, instance, nullptr);
+		if (handle != nullptr) SetWindowLongPtrW(handle, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(this));
+		created.set_value(handle);
+		if (handle == nullptr) return;
+
+		MSG message;
+		while (GetMessageW(&message, nullptr, 0, 0) > 0) {
+			TranslateMessage(&message);
+			DispatchMessageW(&message);
+		}
+	}
+
+public:
+	explicit DisplayChangeWatcher(std::function<void()> onChange) : onChange(std::move(onChange)) {
+		std::promise<HWND> created;
+		thread = std::thread([this, &created]() { Run(created); });
+		window = created.get_future().get();
+	}
+
+	// False if the window could not be created; no changes are reported then.
+	bool IsRunning() const {
+		return window != nullptr;
+	}
+
+	DisplayChangeWatcher(const DisplayChangeWatcher &) = delete;
+	DisplayChangeWatcher &operator=(const DisplayChangeWatcher &) = delete;
+
+	~DisplayChangeWatcher() override {
+		// Windows can only be destroyed by their own thread.
+		if (window != nullptr) PostMessageW(window, WM_CLOSE, 0, 0);
+		thread.join();
+	}
+};
+
+#endif// DISPLAY_CHANGE_WATCHER_H
@@ -0,0 +1,380 @@
+#ifndef SIMULATED_BACKEND_H
+#define SIMULATED_BACKEND_H
+
+#include "display_backend.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct SimulatedBackendOptions {
+	size_t monitors = 4;
+	// Number of physical buses the monitors are spread over (round robin).
+	// Zero gives every monitor its own bus.
+	size_t buses = 0;
+	// Leading monitors reported as internal panels.
+	size_t internalMonitors = 0;
+	// Index of the monitor reported as the OS primary display.
+	size_t primaryMonitor = 0;
+	std::chrono::microseconds enumerationLatency{0};
+	std::chrono::microseconds getLatency{0};
+	std::chrono::microseconds setLatency{0};
+	std::chrono::microseconds probeLatency{0};
+	// Extra latency drawn uniformly from [0, jitter] for every operation.
+	std::chrono::microseconds jitter{0};
+	// Probability that a get, set or probe fails after paying its latency.
+	double failureRate = 0;
+	// Operations on monitors sharing a bus wait for each other, like DDC/CI.
+	bool serializeBuses = true;
+	// Internal monitors only answer on a second, fallback path; the first
+	// fails after paying its latency, like DDC/CI on a laptop panel that
+	// Windows then reaches through WMI.
+	bool fallbackPanels = false;
+	unsigned seed = 1;
+};
+
+// Virtual monitors with configurable timing and failures, for exercising the
+// engine deterministically without display hardware. Each monitor draws jitter
+// and failures from its own seeded generator, so a given sequence of calls per
+// monitor always sees the same outcomes.
+class SimulatedBackend : public DisplayBackend {
+private:
+	struct Bus {
+		std::mutex mutex;
+		std::atomic<int> active{0};
+		std::atomic<int> maxActive{0};
+	};
+
+	struct VirtualMonitor {
+		size_t index = 0;
+		Bus *bus = nullptr;
+		std::mutex mutex;
+		std::mt19937 random;
+		int brightness = 50;
+		std::atomic<int> gets{0};
+		std::atomic<int> sets{0};
+		std::atomic<int> failures{0};
+		std::atomic<bool> offline{false};
+	};
+
+	SimulatedBackendOptions options;
+	std::mutex mutex;
+	std::vector<std::unique_ptr<Bus>> buses;
+	std::vector<std::unique_ptr<VirtualMonitor>> monitors;
+	std::atomic<size_t> monitorCount;
+	std::atomic<std::uint64_t> stamp{1};
+	std::atomic<int> batches{0};
+	// A single attempt by default, so injected failures reach the engine.
+	PathPreference paths{[] {
+		RetryPolicy policy;
+		policy.attempts = 1;
+		return policy;
+	}()};
+	std::mutex watchMutex;
+	std::unordered_map<std::uint64_t, std::function<void()>> watchers;
+	std::uint64_t nextWatcher = 1;
+
+	struct Watcher : DisplayWatcher {
+		SimulatedBackend *backend;
+		std::uint64_t id;
+
+		Watcher(SimulatedBackend *backend, std::uint64_t id) : backend(backend), id(id) {}
+
+		~Watcher() override {
+			std::lock_guard<std::mutex> lock(backend->watchMutex);
+			backend->watchers.erase(id);
+		}
+	};
+
+	void AddMonitors(size_t count) {
+		while (monitors.size() < count) {
+			size_t index = monitors.size();
+			size_t busCount = options.buses == 0 ? index + 1 : options.buses;
+
+			while (buses.size() < busCount) buses.emplace_back(std::make_unique<Bus>());
+
+			auto monitor = std::make_unique<VirtualMonitor>();
+			monitor->index = index;
+			monitor->bus = buses[options.buses == 0 ? index : index % options.buses].get();
+			monitor->random.seed(options.seed + static_cast<unsigned>(index) * 7919);
+			monitors.emplace_back(std::move(monitor));
+		}
+	}
+
+	VirtualMonitor *MonitorFromRef(const MonitorRef &ref) {
+		size_t index = reinterpret_cast<uintptr_t>(ref.handle) - 1;
+		if (ref.handle == nullptr || index >= monitorCount) return nullptr;
+		std::lock_guard<std::mutex> lock(mutex);
+		return monitors[index].get();
+	}
+
+	size_t PathCount(const VirtualMonitor *monitor) const {
+		return options.fallbackPanels && monitor->index < options.internalMonitors ? 2 : 1;
+	}
+
+	// Pays the latency of one operation (holding the bus if buses are serialized)
+	// and decides whether it failed. The first of two paths always fails.
+	bool Perform(VirtualMonitor *monitor, std::chrono::microseconds latency, size_t path = 0) {
+		std::chrono::microseconds delay = latency;
+		bool failed = monitor->offline || path + 1 < PathCount(monitor);
+
+		{
+			std::lock_guard<std::mutex> lock(monitor->mutex);
+			if (options.jitter.count() > 0) {
+				delay += std::chrono::microseconds(std::uniform_int_distribution<long long>(0, options.jitter.count())(monitor->random));
+			}
+			if (options.failureRate > 0 && std::uniform_real_distribution<double>(0, 1)(monitor->random) < options.failureRate) {
+				failed = true;
+			}
+		}
+
+		std::unique_lock<std::mutex> busLock(monitor->bus->mutex, std::defer_lock);
+		if (options.serializeBuses) busLock.lock();
+
+		int active = ++monitor->bus->active;
+		int previous = monitor->bus->maxActive;
+		while (active > previous && !monitor->bus->maxActive.compare_exchange_weak(previous, active)) {}
+
+		if (delay.count() > 0) std::this_thread::sleep_for(delay);
+
+		monitor->bus->active--;
+
+		if (failed) monitor->failures++;
+		return !failed;
+	}
+
+public:
+	explicit SimulatedBackend(const SimulatedBackendOptions &options = {}) : options(options), monitorCount(options.monitors) {
+		AddMonitors(options.monitors);
+	}
+
+	// Simulates a dock/undock by changing the number of attached monitors.
+	void SetMonitorCount(size_t count) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			AddMonitors(count);
+			monitorCount = count;
+			stamp++;
+		}
+
+		std::lock_guard<std::mutex> lock(watchMutex);
+		for (auto &watcher: watchers) watcher.second();
+	}
+
+	// Simulates a change made outside lumi, e.g. with the monitor's buttons.
+	void AdjustBrightness(size_t monitor, int brightness) {
+		std::lock_guard<std::mutex> lock(mutex);
+		std::lock_guard<std::mutex> monitorLock(monitors[monitor]->mutex);
+		monitors[monitor]->brightness = std::clamp(brightness, 0, 100);
+	}
+
+	// Simulates a monitor in standby or with a lost DDC/CI channel: every
+	// operation on it fails after paying its latency.
+	void SetMonitorOffline(size_t monitor, bool offline) {
+		std::lock_guard<std::mutex> lock(mutex);
+		monitors[monitor]->offline = offline;
+	}
+
+	size_t GetMonitorCount() const {
+		return monitorCount;
+	}
+
+	// Highest number of operations that were ever in flight at once on the bus
+	// serving the given monitor.
+	int GetMaxConcurrency(size_t monitor) {
+		std::lock_guard<std::mutex> lock(mutex);
+		return monitors[monitor]->bus->maxActive;
+	}
+
+	int GetOperationCount(size_t monitor) {
+		std::lock_guard<std::mutex> lock(mutex);
+		return monitors[monitor]->gets + monitors[monitor]->sets;
+	}
+
+	int GetFailureCount(size_t monitor) {
+		std::lock_guard<std::mutex> lock(mutex);
+		return monitors[monitor]->failures;
+	}
+
+	// Number of bulk reads served for internal monitors.
+	int GetBatchCount() const {
+		return batches;
+	}
+
+	static std::string IdForIndex(size_t index) {
+		return "DISPLAY\\SIM" + std::to_string(index) + "\\0_0";
+	}
+
+	std::uint64_t GetTopologyStamp() override {
+		return stamp;
+	}
+
+	std::vector<MonitorRef> GetMonitorRefs() override {
+		if (options.enumerationLatency.count() > 0) std::this_thread::sleep_for(options.enumerationLatency);
+
+		std::vector<MonitorRef> refs(monitorCount);
+
+		for (size_t i = 0; i < refs.size(); i++) {
+			refs[i].id = IdForIndex(i);
+			refs[i].connector = "SIM-" + std::to_string(i);
+			refs[i].primary = i == options.primaryMonitor;
+			refs[i].name = i < options.internalMonitors ? "Built-in" : "Simulated Monitor " + std::to_string(i);
+			refs[i].size = {1920, 1080};
+			refs[i].position = {static_cast<int>(i) * 1920, 0};
+			refs[i].handle = reinterpret_cast<void *>(i + 1);
+			refs[i].bus = "sim-bus-" + std::to_string(options.buses == 0 ? i : i % options.buses);
+		}
+
+		return refs;
+	}
+
+	std::vector<Monitor> GetAvailableMonitors(const std::vector<MonitorRef> &refs) override {
+		std::vector<Monitor> result;
+
+		for (const auto &ref: refs) {
+			size_t index = reinterpret_cast<uintptr_t>(ref.handle) - 1;
+			Monitor monitor;
+			monitor.id = ref.id;
+			monitor.displayId = ref.displayId;
+			monitor.name = ref.name;
+			monitor.manufacturer = "SIM";
+			monitor.serialNumber = std::to_string(1000 + index);
+			monitor.productCode = "0001";
+			monitor.size = ref.size;
+			monitor.position = ref.position;
+			monitor.handle = ref.handle;
+			monitor.internal = index < options.internalMonitors;
+			result.emplace_back(monitor);
+		}
+
+		return result;
+	}
+
+	int GetMonitorBrightness(const MonitorRef &ref) override {
+		VirtualMonitor *monitor = MonitorFromRef(ref);
+		if (monitor == nullptr) return -1;
+
+		bool success = paths.Run(ref.id, PathCount(monitor), [&](size_t path) {
+			monitor->gets++;
+			return Perform(monitor, options.getLatency, path);
+		});
+		if (!success) return -1;
+
+		std::lock_guard<std::mutex> lock(monitor->mutex);
+		return monitor->brightness;
+	}
+
+	// Internal monitors are all answered by one query, like WMI on Windows.
+	std::unordered_map<std::string, int> GetBatchBrightness(const std::vector<MonitorRef> &refs) override {
+		std::unordered_map<std::string, int> brightness;
+		std::vector<VirtualMonitor *> internal;
+
+		for (const auto &ref: refs) {
+			VirtualMonitor *monitor = MonitorFromRef(ref);
+			if (monitor != nullptr && monitor->index < options.internalMonitors) internal.push_back(monitor);
+		}
+
+		if (internal.empty()) return brightness;
+
+		batches++;
+		if (options.getLatency.count() > 0) std::this_thread::sleep_for(options.getLatency);
+
+		for (VirtualMonitor *monitor: internal) {
+			std::lock_guard<std::mutex> lock(monitor->mutex);
+			brightness[IdForIndex(monitor->index)] = monitor->brightness;
+		}
+
+		return brightness;
+	}
+
+	bool SetMonitorBrightness(const MonitorRef &ref, int brightness) override {
+		VirtualMonitor *monitor = MonitorFromRef(ref);
+		if (monitor == nullptr) return false;
+
+		bool success = paths.Run(ref.id, PathCount(monitor), [&](size_t path) {
+			monitor->sets++;
+			return Perform(monitor, options.setLatency, path);
+		});
+		if (!success) return false;
+
+		std::lock_guard<std::mutex> lock(monitor->mutex);
+		monitor->brightness = std::clamp(brightness, 0, 100);
+		return true;
+	}
+
+	void SetRetryPolicy(const RetryPolicy &policy) override {
+		paths.SetPolicy(policy);
+	}
+
+	// Changes made through SetMonitorCount are reported right away.
+	std::unique_ptr<DisplayWatcher> WatchTopology(std::function<void()> onChange) override {
+		std::lock_guard<std::mutex> lock(watchMutex);
+		std::uint64_t id = nextWatcher++;
+		watchers.emplace(id, std::move(onChange));
+		return std::make_unique<Watcher>(this, id);
+	}
+
+	MonitorCapabilities ProbeMonitor(const MonitorRef &ref) override {
+		MonitorCapabilities capabilities;
+		VirtualMonitor *monitor = MonitorFromRef(ref);
+		if (monitor == nullptr) return capabilities;
+
+		bool success = paths.Run(ref.id, PathCount(monitor), [&](size_t path) { return Perform(monitor, options.probeLatency, path); });
+		if (!success) return capabilities;
+
+		capabilities.brightness = true;
+		capabilities.maxBrightness = 100;
+
+		return capabilities;
+	}
+};
+
+// Parses a comma separated option list such as
+// "monitors=4,buses=1,getLatency=40,setLatency=50,jitter=5,failureRate=0.01".
+// Latencies are in milliseconds; unknown keys are ignored.
+inline SimulatedBackendOptions ParseSimulatedBackendOptions(const std::string &spec) {
+	SimulatedBackendOptions options;
+	std::istringstream stream(spec);
+	std::string entry;
+
+	auto milliseconds = [](const std::string &value) {
+		return std::chrono::microseconds(static_cast<long long>(std::atof(value.c_str()) * 1000));
+	};
+
+	while (std::getline(stream, entry, ',')) {
+		size_t separator = entry.find('=');
+		if (separator == std::string::npos) continue;
+
+		std::string key = entry.substr(0, separator);
+		std::string value = entry.substr(separator + 1);
+
+		if (key == "monitors") options.monitors = std::strtoul(value.c_str(), nullptr, 10);
+		else if (key == "buses") options.buses = std::strtoul(value.c_str(), nullptr, 10);
+		else if (key == "internal") options.internalMonitors = std::strtoul(value.c_str(), nullptr, 10);
+		else if (key == "primary") options.primaryMonitor = std::strtoul(value.c_str(), nullptr, 10);
+		else if (key == "enumerationLatency") options.enumerationLatency = milliseconds(value);
+		else if (key == "getLatency") options.getLatency = milliseconds(value);
+		else if (key == "setLatency") options.setLatency = milliseconds(value);
+		else if (key == "probeLatency") options.probeLatency = milliseconds(value);
+		else if (key == "latency") options.getLatency = options.setLatency = options.probeLatency = milliseconds(value);
+		else if (key == "jitter") options.jitter = milliseconds(value);
+		else if (key == "failureRate") options.failureRate = std::atof(value.c_str());
+		else if (key == "serializeBuses") options.serializeBuses = value != "0" && value != "false";
+		else if (key == "fallbackPanels") options.fallbackPanels = value != "0" && value != "false";
+		else if (key == "seed") options.seed = static_cast<unsigned>(std::strtoul(value.c_str(), nullptr, 10));
+	}
+
+	return options;
+}
+
+#endif// SIMULATED_BACKEND_H
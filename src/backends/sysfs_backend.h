@@ -0,0 +1,348 @@
+#ifndef SYSFS_BACKEND_H
+#define SYSFS_BACKEND_H
+
+#include "../hash.h"
+#include "display_backend.h"
+#include "sysfs_watcher.h"
+#include <algorithm>
+#include <cmath>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <dirent.h>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Internal panels exposed through the Linux backlight class
+// (<root>/class/backlight/<device>/{brightness,actual_brightness,max_brightness}).
+// Attribute files are opened once per device and kept open for the lifetime of
+// the backend; reads and writes go through pread/pwrite at offset 0.
+class SysfsBackend : public DisplayBackend {
+private:
+	struct Device {
+		std::string name;
+		int brightnessFd = -1;
+		int actualBrightnessFd = -1;
+		int maxBrightness = 0;
+		// Ref lists handed out and not yet released that point at this device.
+		int users = 0;
+
+		~Device() {
+			if (brightnessFd != -1) close(brightnessFd);
+			if (actualBrightnessFd != -1) close(actualBrightnessFd);
+		}
+	};
+
+	std::string root;
+	std::string backlightPath;
+	std::mutex mutex;
+	std::unordered_map<std::string, std::unique_ptr<Device>> devices;
+	// Devices whose entry went away while a snapshot still pointed at them;
+	// freed once the last one is released.
+	std::vector<std::unique_ptr<Device>> retired;
+
+	static int ReadAttribute(int fd) {
+		char buffer[32];
+		ssize_t length = pread(fd, buffer, sizeof(buffer) - 1, 0);
+		if (length <= 0) return -1;
+		buffer[length] = '\0';
+		char *end = nullptr;
+		long value = std::strtol(buffer, &end, 10);
+		return end == buffer ? -1 : static_cast<int>(value);
+	}
+
+	static bool WriteAttribute(int fd, int value) {
+		std::string text = std::to_string(value) + "\n";
+		return pwrite(fd, text.data(), text.size(), 0) == static_cast<ssize_t>(text.size());
+	}
+
+	// Preference among interfaces driving the same panel, by their type
+	// attribute: the firmware's (ACPI) over a platform driver's over the GPU's
+	// raw register access, as the kernel documents.
+	static int TypeRank(const std::string &path) {
+		char buffer[16] = {};
+		int fd = open((path + "/type").c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd == -1) return 3;
+		ssize_t length = pread(fd, buffer, sizeof(buffer) - 1, 0);
+		close(fd);
+
+		std::string type(buffer, length > 0 ? static_cast<size_t>(length) : 0);
+		type = type.substr(0, type.find('\n'));
+		if (type == "firmware") return 0;
+		if (type == "platform") return 1;
+		if (type == "raw") return 2;
+		return 3;
+	}
+
+	static bool IsInternalConnector(const std::string &name) {
+		for (const char *type: {"-eDP-", "-LVDS-", "-DSI-"}) {
+			if (name.find(type) != std::string::npos) return true;
+		}
+
+		return false;
+	}
+
+	// The DRM connector a backlight entry drives. The GPU's own interface is a
+	// child of its connector; an interface hanging off the GPU itself (ACPI's,
+	// or a driver's without a connector of its own) drives the GPU's internal
+	// panel, when it has exactly one. Empty when no connector can be told.
+	static std::string ConnectorOf(const std::string &path) {
+		char resolved[PATH_MAX];
+		if (realpath((path + "/device").c_str(), resolved) == nullptr) return "";
+
+		std::string device = resolved;
+		std::string card = device.substr(0, device.find_last_of('/'));
+		std::string drmPath = card.substr(0, card.find_last_of('/'));
+		if (drmPath.size() >= 4 && drmPath.compare(drmPath.size() - 4, 4, "/drm") == 0) return device;
+
+		drmPath = device + "/drm";
+		DIR *drm = opendir(drmPath.c_str());
+		if (drm == nullptr) return "";
+
+		std::vector<std::string> internal;
+
+		while (dirent *cardEntry = readdir(drm)) {
+			std::string cardName = cardEntry->d_name;
+			if (cardName.compare(0, 4, "card") != 0) continue;
+
+			DIR *connectors = opendir((drmPath + "/" + cardName).c_str());
+			if (connectors == nullptr) continue;
+
+			while (dirent *entry = readdir(connectors)) {
+				std::string name = entry->d_name;
+				if (name.compare(0, cardName.size() + 1, cardName + "-") == 0 && IsInternalConnector(name)) {
+					internal.push_back(drmPath + "/" + cardName + "/" + name);
+				}
+			}
+
+			closedir(connectors);
+		}
+
+		closedir(drm);
+
+		return internal.size() == 1 ? internal[0] : "";
+	}
+
+	// Every entry of the backlight class, sorted.
+	std::vector<std::string> ListEntryNames() {
+		std::vector<std::string> names;
+		DIR *dir = opendir(backlightPath.c_str());
+
+		if (dir == nullptr) return names;
+
+		while (dirent *entry = readdir(dir)) {
+			std::string name = entry->d_name;
+			if (name != "." && name != "..") names.emplace_back(name);
+		}
+
+		closedir(dir);
+		std::sort(names.begin(), names.end());
+
+		return names;
+	}
+
+	// One backlight entry per panel, sorted by name: a raw interface is dropped
+	// when a firmware or platform one drives the same connector (see
+	// ConnectorOf and TypeRank). Raw interfaces never replace each other.
+	std::vector<std::string> ListDeviceNames() {
+		std::vector<std::string> names;
+		std::vector<std::pair<std::string, std::string>> raw;
+		std::unordered_set<std::string> preferred;
+
+		for (const auto &name: ListEntryNames()) {
+			std::string path = backlightPath + "/" + name;
+			std::string connector = ConnectorOf(path);
+
+			if (TypeRank(path) < 2) {
+				names.push_back(name);
+				if (!connector.empty()) preferred.insert(connector);
+			} else {
+				raw.emplace_back(name, connector);
+			}
+		}
+
+		for (const auto &entry: raw) {
+			if (entry.second.empty() || preferred.count(entry.second) == 0) names.push_back(entry.first);
+		}
+
+		std::sort(names.begin(), names.end());
+
+		return names;
+	}
+
+	Device *OpenDevice(const std::string &name) {
+		auto it = devices.find(name);
+		if (it != devices.end()) return it->second.get();
+
+		std::string path = backlightPath + "/" + name;
+		auto device = std::make_unique<Device>();
+		device->name = name;
+
+		int maxFd = open((path + "/max_brightness").c_str(), O_RDONLY | O_CLOEXEC);
+		if (maxFd == -1) return nullptr;
+		device->maxBrightness = ReadAttribute(maxFd);
+		close(maxFd);
+
+		if (device->maxBrightness <= 0) return nullptr;
+
+		// Writing needs root or a udev rule; fall back to read-only so the panel
+		// is still listed and readable.
+		device->brightnessFd = open((path + "/brightness").c_str(), O_RDWR | O_CLOEXEC);
+		if (device->brightnessFd == -1) device->brightnessFd = open((path + "/brightness").c_str(), O_RDONLY | O_CLOEXEC);
+		device->actualBrightnessFd = open((path + "/actual_brightness").c_str(), O_RDONLY | O_CLOEXEC);
+
+		if (device->brightnessFd == -1 && device->actualBrightnessFd == -1) return nullptr;
+
+		Device *result = device.get();
+		devices.emplace(name, std::move(device));
+		return result;
+	}
+
+	// Drops the devices missing from names, so an entry that comes back under
+	// the same name is opened afresh.
+	void EvictDevices(const std::vector<std::string> &names) {
+		for (auto it = devices.begin(); it != devices.end();) {
+			if (std::binary_search(names.begin(), names.end(), it->first)) {
+				++it;
+				continue;
+			}
+
+			if (it->second->users > 0) retired.push_back(std::move(it->second));
+			it = devices.erase(it);
+		}
+	}
+
+	static Device *DeviceFromRef(const MonitorRef &ref) {
+		return static_cast<Device *>(ref.handle);
+	}
+
+public:
+	explicit SysfsBackend(const std::string &root = "/sys") : root(root), backlightPath(root + "/class/backlight") {}
+
+	std::uint64_t GetTopologyStamp() override {
+		std::uint64_t stamp = 0;
+
+		// Which entries win only changes when the entries do.
+		for (const auto &name: ListEntryNames()) {
+			stamp = HashInts64(stamp, PersistentHash(name));
+		}
+
+		return stamp;
+	}
+
+	std::vector<MonitorRef> GetMonitorRefs() override {
+		std::vector<MonitorRef> refs;
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto names = ListDeviceNames();
+		EvictDevices(names);
+
+		for (const auto &name: names) {
+			Device *device = OpenDevice(name);
+			if (device == nullptr) continue;
+			device->users++;
+
+			MonitorRef ref;
+			ref.id = name;
+			ref.connector = name;
+			ref.name = "Built-in";
+			ref.handle = device;
+			refs.emplace_back(ref);
+		}
+
+		return refs;
+	}
+
+	void ReleaseMonitorRefs(const std::vector<MonitorRef> &refs) override {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		for (const auto &ref: refs) {
+			if (Device *device = DeviceFromRef(ref)) device->users--;
+		}
+
+		retired.erase(std::remove_if(retired.begin(), retired.end(), [](const std::unique_ptr<Device> &device) {
+			return device->users == 0;
+		}), retired.end());
+	}
+
+	std::vector<Monitor> GetAvailableMonitors(const std::vector<MonitorRef> &refs) override {
+		std::vector<Monitor> monitors;
+
+		for (const auto &ref: refs) {
+			Monitor monitor;
+			monitor.id = ref.id;
+			monitor.displayId = ref.displayId;
+			monitor.name = ref.name;
+			monitor.size = ref.size;
+			monitor.position = ref.position;
+			monitor.handle = ref.handle;
+			monitor.internal = true;
+			monitors.emplace_back(monitor);
+		}
+
+		return monitors;
+	}
+
+	int GetMonitorBrightness(const MonitorRef &ref) override {
+		Device *device = DeviceFromRef(ref);
+		if (device == nullptr) return -1;
+
+		int fd = device->actualBrightnessFd != -1 ? device->actualBrightnessFd : device->brightnessFd;
+		int raw = ReadAttribute(fd);
+		if (raw < 0) return -1;
+
+		return static_cast<int>(std::lround(raw * 100.0 / device->maxBrightness));
+	}
+
+	bool SetMonitorBrightness(const MonitorRef &ref, int brightness) override {
+		Device *device = DeviceFromRef(ref);
+		if (device == nullptr || device->brightnessFd == -1) return false;
+
+		int raw = static_cast<int>(std::lround(std::clamp(brightness, 0, 100) * device->maxBrightness / 100.0));
+		return WriteAttribute(device->brightnessFd, raw);
+	}
+
+	std::unique_ptr<DisplayWatcher> WatchTopology(std::function<void()> onChange) override {
+		return std::make_unique<SysfsWatcher>(root, "backlight", std::move(onChange));
+	}
+
+	bool CanWatchBrightness(const MonitorRef &ref) override {
+		return DeviceFromRef(ref) != nullptr;
+	}
+
+	// The watcher opens its own descriptors: the notification state is kept per
+	// open file, and reads through the backend's would swallow it.
+	std::unique_ptr<DisplayWatcher> WatchBrightness(const std::vector<MonitorRef> &refs, std::function<void(const std::string &id)> onChange) override {
+		std::vector<std::pair<std::string, std::string>> files;
+
+		for (const auto &ref: refs) {
+			Device *device = DeviceFromRef(ref);
+			if (device == nullptr) continue;
+			std::string attribute = device->actualBrightnessFd != -1 ? "actual_brightness" : "brightness";
+			files.emplace_back(ref.id, backlightPath + "/" + device->name + "/" + attribute);
+		}
+
+		if (files.empty()) return nullptr;
+		return std::make_unique<SysfsAttributeWatcher>(files, std::move(onChange));
+	}
+
+	MonitorCapabilities ProbeMonitor(const MonitorRef &ref) override {
+		MonitorCapabilities capabilities;
+		Device *device = DeviceFromRef(ref);
+		if (device == nullptr) return capabilities;
+
+		capabilities.brightness = true;
+		capabilities.maxBrightness = device->maxBrightness;
+
+		return capabilities;
+	}
+};
+
+#endif// SYSFS_BACKEND_H
@@ -0,0 +1,250 @@
+#ifndef SYSFS_WATCHER_H
+#define SYSFS_WATCHER_H
+
+#include "display_backend.h"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <functional>
+#include <linux/netlink.h>
+#include <poll.h>
+#include <string>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Watches one device class (<root>/class/<subsystem>) for hotplug. Kernel
+// uevents of the subsystem arrive over netlink when root is the real /sys;
+// inotify on the class directory and every device in it picks up devices
+// appearing or disappearing and attribute files being rewritten, which is how
+// test fixtures drive it. Bursts of events are reported as one change.
+class SysfsWatcher : public DisplayWatcher {
+private:
+	std::string classPath;
+	std::string subsystem;
+	std::function<void()> onChange;
+	std::chrono::milliseconds settle;
+	int inotifyFd = -1;
+	int netlinkFd = -1;
+	int stopFd = -1;
+	std::thread thread;
+
+	void AddWatches() {
+		inotify_add_watch(inotifyFd, classPath.c_str(), IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO);
+
+		DIR *dir = opendir(classPath.c_str());
+		if (dir == nullptr) return;
+
+		// Adding a watch twice only updates it, so this can run after every event.
+		while (dirent *entry = readdir(dir)) {
+			std::string name = entry->d_name;
+			if (name == "." || name == "..") continue;
+			inotify_add_watch(inotifyFd, (classPath + "/" + name).c_str(), IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_ATTRIB);
+		}
+
+		closedir(dir);
+	}
+
+	// Drains the inotify queue; true if anything arrived.
+	bool ReadInotify() {
+		alignas(inotify_event) char buffer[4096];
+		bool changed = false;
+
+		while (read(inotifyFd, buffer, sizeof(buffer)) > 0) changed = true;
+		if (changed) AddWatches();
+
+		return changed;
+	}
+
+	// Drains the netlink socket; true if a uevent of our subsystem arrived.
+	bool ReadNetlink() {
+		char buffer[8192];
+		bool changed = false;
+		ssize_t length;
+		std::string match = "SUBSYSTEM=" + subsystem;
+
+		while ((length = recv(netlinkFd, buffer, sizeof(buffer) - 1, 0)) > 0) {
+			buffer[length] = '\0';
+
+			// "ACTION@devpath" followed by NUL separated KEY=VALUE pairs.
+			for (ssize_t offset = 0; offset < length; offset += std::strlen(buffer + offset) + 1) {
+				if (match == buffer + offset) changed = true;
+			}
+		}
+
+		return changed;
+	}
+
+	void Run() {
+		pollfd fds[3] = {{stopFd, POLLIN, 0}, {inotifyFd, POLLIN, 0}, {netlinkFd, POLLIN, 0}};
+		bool pending = false;
+
+		while (true) {
+			// Once something changed, wait for the burst to settle before reporting.
+			int ready = poll(fds, 3, pending ? static_cast<int>(settle.count()) : -1);
+
+			if (ready < 0 && errno != EINTR) return;
+			if (fds[0].revents != 0) return;
+
+			if (ready == 0 && pending) {
+				pending = false;
+				onChange();
+				continue;
+			}
+
+			if (fds[1].revents != 0 && ReadInotify()) pending = true;
+			if (fds[2].revents != 0 && ReadNetlink()) pending = true;
+		}
+	}
+
+public:
+	SysfsWatcher(const std::string &root, const std::string &subsystem, std::function<void()> onChange,
+	             std::chrono::milliseconds settle = std::chrono::milliseconds(100))
+	    : classPath(root + "/class/" + subsystem), subsystem(subsystem), onChange(std::move(onChange)), settle(settle) {
+		inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		stopFd = eventfd(0, EFD_CLOEXEC);
+		if (inotifyFd != -1) AddWatches();
+
+		// Uevents describe the real system, so fixtures under another root skip them.
+		if (root == "/sys") {
+			netlinkFd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+			sockaddr_nl address = {};
+			address.nl_family = AF_NETLINK;
+			address.nl_groups = 1;
+
+			if (netlinkFd != -1 && bind(netlinkFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+				close(netlinkFd);
+				netlinkFd = -1;
+			}
+		}
+
+		if (stopFd != -1) thread = std::thread([this]() { Run(); });
+	}
+
+	SysfsWatcher(const SysfsWatcher &) = delete;
+	SysfsWatcher &operator=(const SysfsWatcher &) = delete;
+
+	~SysfsWatcher() override {
+		if (thread.joinable()) {
+			eventfd_write(stopFd, 1);
+			thread.join();
+		}
+
+		for (int fd: {inotifyFd, netlinkFd, stopFd}) {
+			if (fd != -1) close(fd);
+		}
+	}
+};
+
+// Watches attribute files for new values. The kernel wakes poll() with
+// POLLPRI/POLLERR on attributes it notifies about (backlight actual_brightness
+// changes through hotkeys or other processes), and inotify catches plain
+// files being rewritten, as in test fixtures. onChange gets the key the file
+// was registered with.
+class SysfsAttributeWatcher : public DisplayWatcher {
+private:
+	struct Attribute {
+		std::string key;
+		int fd = -1;
+	};
+
+	std::function<void(const std::string &key)> onChange;
+	std::vector<Attribute> attributes;
+	std::unordered_map<int, std::string> watches;
+	int inotifyFd = -1;
+	int stopFd = -1;
+	std::thread thread;
+
+	void Run() {
+		std::vector<pollfd> fds = {{stopFd, POLLIN, 0}, {inotifyFd, POLLIN, 0}};
+		for (const auto &attribute: attributes) fds.push_back({attribute.fd, POLLPRI | POLLERR, 0});
+
+		while (true) {
+			if (poll(fds.data(), fds.size(), -1) < 0) {
+				if (errno == EINTR) continue;
+				return;
+			}
+			if (fds[0].revents != 0) return;
+
+			std::unordered_set<std::string> changed;
+
+			for (size_t i = 2; i < fds.size(); i++) {
+				if ((fds[i].revents & (POLLPRI | POLLERR)) == 0) continue;
+
+				// Reading re-arms the notification. An attribute that can no
+				// longer be read (e.g. its device went away) is dropped
+				// instead of waking the loop again and again; inotify still
+				// covers it.
+				char buffer[32];
+				if (pread(fds[i].fd, buffer, sizeof(buffer), 0) < 0) fds[i].fd = -1;
+				changed.insert(attributes[i - 2].key);
+			}
+
+			if (fds[1].revents != 0) {
+				alignas(inotify_event) char buffer[4096];
+				ssize_t length;
+
+				while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+					for (ssize_t offset = 0; offset < length;) {
+						auto *event = reinterpret_cast<inotify_event *>(buffer + offset);
+						auto it = watches.find(event->wd);
+						if (it != watches.end()) changed.insert(it->second);
+						offset += sizeof(inotify_event) + event->len;
+					}
+				}
+			}
+
+			for (const auto &key: changed) onChange(key);
+		}
+	}
+
+public:
+	// files maps each key to the attribute file to watch.
+	SysfsAttributeWatcher(const std::vector<std::pair<std::string, std::string>> &files, std::function<void(const std::string &key)> onChange)
+	    : onChange(std::move(onChange)) {
+		inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		stopFd = eventfd(0, EFD_CLOEXEC);
+
+		for (const auto &file: files) {
+			int fd = open(file.second.c_str(), O_RDONLY | O_CLOEXEC);
+			if (fd == -1) continue;
+
+			// The initial read arms the notification; without it the
+			// attribute is only covered by inotify.
+			char buffer[32];
+			if (pread(fd, buffer, sizeof(buffer), 0) < 0) close(fd);
+			else attributes.push_back({file.first, fd});
+
+			if (inotifyFd != -1) {
+				int watch = inotify_add_watch(inotifyFd, file.second.c_str(), IN_CLOSE_WRITE | IN_MODIFY);
+				if (watch != -1) watches.emplace(watch, file.first);
+			}
+		}
+
+		if (stopFd != -1) thread = std::thread([this]() { Run(); });
+	}
+
+	SysfsAttributeWatcher(const SysfsAttributeWatcher &) = delete;
+	SysfsAttributeWatcher &operator=(const SysfsAttributeWatcher &) = delete;
+
+	~SysfsAttributeWatcher() override {
+		if (thread.joinable()) {
+			eventfd_write(stopFd, 1);
+			thread.join();
+		}
+
+		for (const auto &attribute: attributes) close(attribute.fd);
+		if (inotifyFd != -1) close(inotifyFd);
+		if (stopFd != -1) close(stopFd);
+	}
+};
+
+#endif// SYSFS_WATCHER_H
@@ -0,0 +1,548 @@
+#ifndef WIN32_BACKEND_H
+#define WIN32_BACKEND_H
+
+#include "../display_config_helper.h"
+#include "../edid.h"
+#include "../hash.h"
+#include "../utils.h"
+#include "../wmi_client.h"
+#include "display_backend.h"
+#include "display_change_watcher.h"
+#include <algorithm>
+#include <atomic>
+#include <highlevelmonitorconfigurationapi.h>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <physicalmonitorenumerationapi.h>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include <windows.h>
+
+class Win32Backend : public DisplayBackend {
+private:
+	typedef std::tuple<HANDLE, std::wstring, int, int, int, int, bool> MonitorHandleInfo;
+
+	struct EnumContext {
+		Win32Backend *backend;
+		std::vector<MonitorHandleInfo> handles;
+	};
+
+	// COM objects live in the apartment of the thread that created them, so
+	// every thread that talks to WMI keeps its own client for its lifetime.
+	WmiClient &Client() {
+		thread_local WmiClient client;
+		return client;
+	}
+
+	// The monitor's EDID as Windows stored it when the device was installed
+	// (HKLM\SYSTEM\CurrentControlSet\Enum\<instance>\Device Parameters\EDID).
+	// The id is the instance path plus an "_<n>" suffix.
+	bool ReadRegistryEdid(const std::string &id, Edid::Info &info, uint8_t (&buffer)[1024]) {
+		std::string instance = id.substr(0, id.find_last_of('_'));
+		std::string key = "SYSTEM\\CurrentControlSet\\Enum\\" + instance + "\\Device Parameters";
+		DWORD size = sizeof(buffer);
+
+		if (RegGetValueA(HKEY_LOCAL_MACHINE, key.c_str(), "EDID", RRF_RT_REG_BINARY, nullptr, buffer, &size) != ERROR_SUCCESS) return false;
+
+		return Edid::Parse(buffer, size, info);
+	}
+
+	// Turns a monitor device path (\\?\DISPLAY#DEL4200#5&1a2b3c&0&UID4353#{guid})
+	// into the WMI instance name of its occurrence-th monitor
+	// (DISPLAY\DEL4200\5&1a2b3c&0&UID4353_0).
+	std::string DeriveDisplayIdentifier(const std::string &devicePath, const int occurrence) {
+		size_t model = devicePath.find('#');
+		size_t instance = devicePath.find('#', model + 1);
+		size_t end = devicePath.find('#', instance + 1);
+
+		if (model == std::string::npos || instance == std::string::npos) return devicePath + "_" + std::to_string(occurrence);
+
+		return "DISPLAY\\" + devicePath.substr(model + 1, instance - model - 1) + "\\" + devicePath.substr(instance + 1, end - instance - 1) + "_" + std::to_string(occurrence);
+	}
+
+	std::tuple<std::string, std::string> GetDeviceInfoFromPath(DISPLAYCONFIG_PATH_INFO path) {
+		DISPLAYCONFIG_TARGET_DEVICE_NAME deviceName = {};
+		deviceName.header.type = DISPLAYCONFIG_DEVICE_INFO_GET_TARGET_NAME;
+		deviceName.header.size = sizeof(DISPLAYCONFIG_TARGET_DEVICE_NAME);
+		deviceName.header.adapterId = path.targetInfo.adapterId;
+		deviceName.header.id = path.targetInfo.id;
+
+		LONG result = DisplayConfigGetDeviceInfo((DISPLAYCONFIG_DEVICE_INFO_HEADER *) &deviceName);
+
+		if (result == ERROR_SUCCESS) {
+			return {ToUTF8(WideStringFromArray(deviceName.monitorDevicePath)), ToUTF8(WideStringFromArray(deviceName.monitorFriendlyDeviceName))};
+		}
+
+		return {"Unknown", "Unknown"};
+	}
+
+	std::string GetGDIDeviceNameFromPath(DISPLAYCONFIG_PATH_INFO path) {
+		DISPLAYCONFIG_SOURCE_DEVICE_NAME sourceName = {};
+		sourceName.header.type = DISPLAYCONFIG_DEVICE_INFO_GET_SOURCE_NAME;
+		sourceName.header.size = sizeof(DISPLAYCONFIG_SOURCE_DEVICE_NAME);
+		sourceName.header.adapterId = path.targetInfo.adapterId;
+		sourceName.header.id = path.sourceInfo.id;
+
+		LONG result = DisplayConfigGetDeviceInfo((DISPLAYCONFIG_DEVICE_INFO_HEADER *) &sourceName);
+
+		if (result == ERROR_SUCCESS) {
+			return ToUTF8(WideStringFromArray(sourceName.viewGdiDeviceName));
+		}
+
+		return "Unknown";
+	}
+
+	// Ways of reaching a monitor, in the order they are first tried: DDC/CI
+	// through Dxva2 for external monitors, WMI for internal panels.
+	static constexpr size_t DXVA2_PATH = 0;
+	static constexpr size_t WMI_PATH = 1;
+	static constexpr size_t PATH_COUNT = 2;
+
+	PathPreference paths;
+
+	// Counts display change notifications; started with the first stamp.
+	std::atomic<std::uint64_t> displayChanges{0};
+	std::once_flag watcherStarted;
+	std::unique_ptr<DisplayChangeWatcher> watcher;
+
+	bool IsMonitorInternal(const std::string &instanceName) {
+		IEnumWbemClassObject *enumerator = nullptr;
+		HRESULT hres = Client().execQuery("SELECT * FROM WmiMonitorConnectionParams WHERE InstanceName='" +
+		                                         instanceName + "'",
+		                                 &enumerator);
+
+		if (FAILED(hres)) {
+			std::cout << "Failed to execute WMI query. Error code = 0x" << std::hex << hres << std::endl;
+			return false;
+		}
+
+		IWbemClassObject *wmiObject = nullptr;
+		ULONG numReturned = 0;
+
+		while (enumerator->Next(WmiTimeout(), 1, &wmiObject, &numReturned) == S_OK && numReturned > 0) {
+			VARIANT videoOutputTechVariant;
+			VariantInit(&videoOutputTechVariant);
+
+			hres = wmiObject->Get(L"VideoOutputTechnology", 0, &videoOutputTechVariant, nullptr, nullptr);
+
+			if (SUCCEEDED(hres)) {
+				wmiObject->Release();
+				enumerator->Release();
+				bool internal = (videoOutputTechVariant.intVal == 11);
+				VariantClear(&videoOutputTechVariant);
+				return internal;
+			}
+
+			VariantClear(&videoOutputTechVariant);
+			wmiObject->Release();
+		}
+
+		enumerator->Release();
+
+		return false;
+	}
+
+	// Current brightness of every panel WMI knows about, keyed by instance name,
+	// from a single WmiMonitorBrightness query.
+	std::unordered_map<std::string, int> WMIGetAllMonitorBrightness() {
+		std::unordered_map<std::string, int> brightness;
+		IEnumWbemClassObject *pEnumerator = nullptr;
+
+		HRESULT hres = Client().execQuery("SELECT InstanceName, CurrentBrightness FROM WmiMonitorBrightness", &pEnumerator);
+
+		if (FAILED(hres)) return brightness;
+
+		IWbemClassObject *pclsObj = nullptr;
+		ULONG uReturn = 0;
+
+		while (pEnumerator) {
+			hres = pEnumerator->Next(WmiTimeout(), 1, &pclsObj, &uReturn);
+			if (hres != S_OK) {
+				if (hres != WBEM_S_FALSE) {
+					std::cout << "Failed to retrieve next object from enumerator. Error code = 0x"
+					          << std::hex << hres << std::endl;
+				}
+				break;
+			}
+
+			VARIANT instanceName;
+			VARIANT currentBrightness;
+
+			pclsObj->Get(L"InstanceName", 0, &instanceName, nullptr, nullptr);
+			pclsObj->Get(L"CurrentBrightness", 0, &currentBrightness, nullptr, nullptr);
+
+			if (instanceName.vt == VT_BSTR && currentBrightness.vt == VT_UI1) {
+				brightness[ToUTF8(instanceName.bstrVal)] = currentBrightness.bVal;
+			}
+
+			VariantClear(&instanceName);
+			VariantClear(&currentBrightness);
+			pclsObj->Release();
+		}
+
+		pEnumerator->Release();
+
+		return brightness;
+	}
+
+	int WMIGetMonitorBrightness(const std::string monitorId) {
+		auto brightness = WMIGetAllMonitorBrightness();
+		auto it = brightness.find(monitorId);
+		return it != brightness.end() ? it->second : -1;
+	}
+
+	BOOL WMISetMonitorBrightness(const std::string monitorId, const int brightness) {
+		BSTR *path = Client().pathForInstance(monitorId, "WmiMonitorBrightnessMethods");
+
+		if (path == nullptr) return false;
+
+		IWbemClassObject *pClass = NULL;
+		HRESULT hres = Client().getMethod("WmiMonitorBrightnessMethods", &pClass);
+
+		if (FAILED(hres)) return false;
+
+		IWbemClassObject *pInParamsDefinition = NULL;
+		hres = pClass->GetMethod(_bstr_t(L"WmiSetBrightness"), 0, &pInParamsDefinition, NULL);
+
+		if (FAILED(hres)) {
+			std::cout << "Failed to get WmiSetBrightness method." << std::endl;
+			return false;
+		}
+
+		IWbemClassObject *pClassInstance = NULL;
+		hres = pInParamsDefinition->SpawnInstance(0, &pClassInstance);
+
+		if (FAILED(hres)) {
+			std::cout << "Failed to spawn instance." << std::endl;
+			return false;
+		}
+
+		VARIANT timeoutVariant;
+		VariantInit(&timeoutVariant);
+		V_VT(&timeoutVariant) = VT_UI1;
+		V_UI1(&timeoutVariant) = 0;
+
+		hres = pClassInstance->Put(_bstr_t(L"Timeout"),
+		                           0,
+		                           &timeoutVariant,
+		                           CIM_UINT32);
+
+		if (FAILED(hres)) {
+			std::cout << "Failed to insert timeout value." << std::endl;
+			return false;
+		}
+
+		VARIANT brightnessVariant;
+		VariantInit(&brightnessVariant);
+		V_VT(&brightnessVariant) = VT_UI1;
+		V_UI1(&brightnessVariant) = brightness;
+
+		hres = pClassInstance->Put(_bstr_t(L"Brightness"),
+		                           0,
+		                           &brightnessVariant,
+		                           CIM_UINT8);
+
+		if (FAILED(hres)) {
+			std::cout << "Failed to add brightness value." << std::endl;
+			return false;
+		}
+
+		hres = Client().execMethod(*path, "WmiSetBrightness", pClassInstance);
+
+		if (FAILED(hres)) {
+			std::cout << "Failed to execute WmiSetBrightness method." << std::endl;
+			return false;
+		}
+
+		VariantClear(&timeoutVariant);
+		VariantClear(&brightnessVariant);
+		pClassInstance->Release();
+		pClass->Release();
+
+		return true;
+	}
+
+	PHYSICAL_MONITOR GetPhysicalMonitorFromHMONITOR(HMONITOR hMonitor) {
+		PHYSICAL_MONITOR monitor = {};
+		DWORD monitorCount;
+
+		if (!GetNumberOfPhysicalMonitorsFromHMONITOR(hMonitor, &monitorCount)) return monitor;
+
+		if (monitorCount == 0) return monitor;
+
+		std::unique_ptr<PHYSICAL_MONITOR[]> monitors(new PHYSICAL_MONITOR[monitorCount]);
+
+		if (!GetPhysicalMonitorsFromHMONITOR(hMonitor, monitorCount, monitors.get())) return monitor;
+
+		return monitors[0];
+	}
+
+	static BOOL CALLBACK MonitorEnumProcStatic(HMONITOR hMonitor, HDC hdcMonitor, LPRECT lprcMonitor, LPARAM dwData) {
+		EnumContext *context = reinterpret_cast<EnumContext *>(dwData);
+		return context->backend->callback(context->handles, hMonitor, hdcMonitor, lprcMonitor);
+	}
+
+	bool callback(std::vector<MonitorHandleInfo> &handles, HMONITOR hMonitor, HDC hdcMonitor, LPRECT lprcMonitor) {
+		PHYSICAL_MONITOR physicalMonitor = GetPhysicalMonitorFromHMONITOR(hMonitor);
+		MONITORINFOEXW info = {};
+		info.cbSize = sizeof(MONITORINFOEXW);
+		GetMonitorInfoW(hMonitor, &info);
+		auto [width, height, x, y] = GetMonitorInfoWithPosition(info.szDevice, hMonitor);
+		bool primary = (info.dwFlags & MONITORINFOF_PRIMARY) != 0;
+		handles.emplace_back(static_cast<HANDLE>(physicalMonitor.hPhysicalMonitor), std::wstring(info.szDevice), width, height, x, y, primary);
+		return TRUE;
+	}
+
+public:
+	std::tuple<int, int, int, int> GetMonitorInfoWithPosition(const std::wstring& deviceName, HMONITOR hMonitor) {
+		DEVMODEW devMode = {};
+		devMode.dmSize = sizeof(DEVMODEW);
+		int width = 0, height = 0;
+
+		if (EnumDisplaySettingsW(deviceName.c_str(), ENUM_CURRENT_SETTINGS, &devMode)) {
+			width = devMode.dmPelsWidth;
+			height = devMode.dmPelsHeight;
+		}
+
+		MONITORINFOEX monitorInfo = {};
+		monitorInfo.cbSize = sizeof(MONITORINFOEX);
+		int x = 0, y = 0;
+
+		if (GetMonitorInfo(hMonitor, reinterpret_cast<MONITORINFO*>(&monitorInfo))) {
+			x = monitorInfo.rcMonitor.left;
+			y = monitorInfo.rcMonitor.top;
+		}
+
+		return {width, height, x, y};
+	}
+
+	// Counts display change notifications (WM_DISPLAYCHANGE and
+	// WM_DEVICECHANGE), so the display configuration is only enumerated again
+	// after one arrived or on refresh(). Should the watcher window fail to
+	// come up, the monitor count and virtual screen are hashed instead.
+	std::uint64_t GetTopologyStamp() override {
+		std::call_once(watcherStarted, [this]() {
+			watcher = std::make_unique<DisplayChangeWatcher>([this]() { displayChanges++; });
+		});
+
+		if (watcher->IsRunning()) return displayChanges.load();
+
+		const int metrics[] = {SM_CMONITORS, SM_XVIRTUALSCREEN, SM_YVIRTUALSCREEN, SM_CXVIRTUALSCREEN, SM_CYVIRTUALSCREEN};
+		std::uint64_t stamp = 0;
+
+		for (int metric: metrics) {
+			stamp = HashInts64(stamp, static_cast<uint32_t>(GetSystemMetrics(metric)));
+		}
+
+		return stamp;
+	}
+
+	std::vector<MonitorRef> GetMonitorRefs() override {
+		UINT pathCount;
+		UINT modeCount;
+		if (GetDisplayConfigBufferSizes(QDC_ONLY_ACTIVE_PATHS, &pathCount, &modeCount))
+			return {};
+
+		std::vector<DISPLAYCONFIG_PATH_INFO> paths(pathCount);
+		std::vector<DISPLAYCONFIG_MODE_INFO> modes(modeCount);
+		if (QueryDisplayConfig(QDC_ONLY_ACTIVE_PATHS, &pathCount, paths.data(), &modeCount, modes.data(), nullptr))
+			return {};
+
+		EnumContext context = {this, {}};
+
+		EnumDisplayMonitors(
+		        nullptr,
+		        nullptr,
+		        &MonitorEnumProcStatic,
+		        reinterpret_cast<LPARAM>(&context));
+
+		std::vector<MonitorRef> monitors;
+		std::unordered_map<std::string, int> occurrences;
+		auto &handles = context.handles;
+
+		for (UINT i = 0; i < pathCount; i++) {
+			std::tuple<std::string, std::string> info = GetDeviceInfoFromPath(paths[i]);
+			std::string GDIDeviceName = GetGDIDeviceNameFromPath(paths[i]);
+
+			auto target = std::find_if(handles.begin(), handles.end(), [&GDIDeviceName](const MonitorHandleInfo &t) {
+				return (ToUTF8(std::get<1>(t)) == GDIDeviceName);
+			});
+
+			if (target != handles.end()) {
+				MonitorRef monitor;
+				// The device path names the port the monitor is plugged into.
+				monitor.id = DeriveDisplayIdentifier(std::get<0>(info), occurrences[std::get<0>(info)]++);
+				monitor.connector = std::get<0>(info);
+				monitor.name = std::get<1>(info);
+				monitor.handle = std::get<0>(*target);
+				monitor.size.width = std::get<2>(*target);
+				monitor.size.height = std::get<3>(*target);
+				monitor.position.x = std::get<4>(*target);
+				monitor.position.y = std::get<5>(*target);
+				monitor.primary = std::get<6>(*target);
+				monitors.emplace_back(monitor);
+			}
+		}
+
+		return monitors;
+	}
+
+	void ReleaseMonitorRefs(const std::vector<MonitorRef> &refs) override {
+		for (const auto &ref: refs) {
+			if (ref.handle != nullptr) DestroyPhysicalMonitor(ref.handle);
+		}
+	}
+
+	std::vector<Monitor> GetAvailableMonitors(const std::vector<MonitorRef> &refs) override {
+		std::vector<Monitor> monitors;
+		IEnumWbemClassObject *pEnumerator = NULL;
+
+		HRESULT hres = Client().execQuery("SELECT * FROM WmiMonitorID", &pEnumerator);
+
+		if (FAILED(hres)) return {};
+
+		IWbemClassObject *pclsObj = NULL;
+		ULONG uReturn = 0;
+
+		while (pEnumerator) {
+			Monitor monitorInfo;
+
+			pEnumerator->Next(WmiTimeout(), 1, &pclsObj, &uReturn);
+
+			if (0 == uReturn) break;
+
+			VARIANT instanceNameVariant;
+			VARIANT manufacturerVariant;
+			VARIANT serialVariant;
+			VARIANT productCodeVariant;
+
+			pclsObj->Get(L"InstanceName", 0, &instanceNameVariant, 0, 0);
+			pclsObj->Get(L"ManufacturerName", 0, &manufacturerVariant, 0, 0);
+			pclsObj->Get(L"SerialNumberID", 0, &serialVariant, 0, 0);
+			pclsObj->Get(L"ProductCodeID", 0, &productCodeVariant, 0, 0);
+
+			std::string id = ToUTF8(instanceNameVariant.bstrVal);
+
+			monitorInfo.id = id;
+			monitorInfo.internal = IsMonitorInternal(monitorInfo.id);
+
+			uint8_t edid[1024];
+			Edid::Info edidInfo;
+
+			if (ReadRegistryEdid(id, edidInfo, edid)) {
+				monitorInfo.manufacturer = edidInfo.manufacturer;
+				monitorInfo.serialNumber = Edid::SerialString(edidInfo);
+				monitorInfo.productCode = Edid::ProductCodeString(edidInfo);
+			} else {
+				monitorInfo.manufacturer = ConvertVariantToString(manufacturerVariant);
+				monitorInfo.serialNumber = ConvertVariantToString(serialVariant);
+				monitorInfo.productCode = ConvertVariantToString(productCodeVariant);
+			}
+
+			auto it = std::find_if(refs.begin(), refs.end(), [&id](const MonitorRef &ref) {
+				return ref.id == id;
+			});
+
+			if (it != refs.end()) {
+				monitorInfo.name = monitorInfo.internal ? "Built-in" : it->name;
+				monitorInfo.displayId = it->displayId;
+				monitorInfo.handle = it->handle;
+				monitorInfo.size.width = it->size.width;
+				monitorInfo.size.height = it->size.height;
+				monitorInfo.position.x = it->position.x;
+				monitorInfo.position.y = it->position.y;
+			}
+
+			VariantClear(&instanceNameVariant);
+			VariantClear(&manufacturerVariant);
+			VariantClear(&serialVariant);
+			VariantClear(&productCodeVariant);
+
+			pclsObj->Release();
+			monitors.push_back(monitorInfo);
+		}
+
+		pEnumerator->Release();
+
+		return monitors;
+	}
+
+	int GetMonitorBrightness(const MonitorRef &ref) override {
+		int brightness = -1;
+
+		paths.Run(ref.id, PATH_COUNT, [&](size_t path) {
+			if (path == WMI_PATH) {
+				brightness = WMIGetMonitorBrightness(ref.id);
+				return brightness != -1;
+			}
+
+			DWORD minBrightness = 0;
+			DWORD currentBrightness = 0;
+			DWORD maxBrightness = 0;
+
+			if (!HighLevelMonitorConfigurationAPI_h::GetMonitorBrightness(ref.handle, &minBrightness, &currentBrightness, &maxBrightness)) return false;
+			brightness = static_cast<int>(currentBrightness);
+			return true;
+		});
+
+		return brightness;
+	}
+
+	// Internal panels are the monitors WmiMonitorBrightness reports; they are
+	// all answered by one query instead of a failing Dxva2 attempt each.
+	std::unordered_map<std::string, int> GetBatchBrightness(const std::vector<MonitorRef> &refs) override {
+		std::unordered_map<std::string, int> brightness;
+		auto panels = WMIGetAllMonitorBrightness();
+
+		for (const auto &ref: refs) {
+			auto it = panels.find(ref.id);
+			if (it != panels.end()) brightness.emplace(ref.id, it->second);
+		}
+
+		return brightness;
+	}
+
+	bool SetMonitorBrightness(const MonitorRef &monitor, int brightness) override {
+		return paths.Run(monitor.id, PATH_COUNT, [&](size_t path) {
+			if (path == WMI_PATH) return WMISetMonitorBrightness(monitor.id, brightness) != FALSE;
+			return HighLevelMonitorConfigurationAPI_h::SetMonitorBrightness(monitor.handle, static_cast<DWORD>(brightness)) != FALSE;
+		});
+	}
+
+	void SetRetryPolicy(const RetryPolicy &policy) override {
+		paths.SetPolicy(policy);
+	}
+
+	std::unique_ptr<DisplayWatcher> WatchTopology(std::function<void()> onChange) override {
+		return std::make_unique<DisplayChangeWatcher>(std::move(onChange));
+	}
+
+	MonitorCapabilities ProbeMonitor(const MonitorRef &ref) override {
+		MonitorCapabilities capabilities;
+
+		capabilities.brightness = paths.Run(ref.id, PATH_COUNT, [&](size_t path) {
+			if (path == WMI_PATH) {
+				capabilities.maxBrightness = 100;
+				return WMIGetMonitorBrightness(ref.id) != -1;
+			}
+
+			DWORD minBrightness = 0;
+			DWORD currentBrightness = 0;
+			DWORD maxBrightness = 0;
+
+			if (!HighLevelMonitorConfigurationAPI_h::GetMonitorBrightness(ref.handle, &minBrightness, &currentBrightness, &maxBrightness)) return false;
+			capabilities.minBrightness = static_cast<int>(minBrightness);
+			capabilities.maxBrightness = static_cast<int>(maxBrightness);
+			return true;
+		});
+
+		if (!capabilities.brightness) capabilities.maxBrightness = 0;
+
+		return capabilities;
+	}
+};
+
+#endif// WIN32_BACKEND_H
@@ -0,0 +1,33 @@
+#ifndef BARRIER_H
+#define BARRIER_H
+
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Collects the results of operations running in parallel and calls back once,
+// from whichever thread finishes the last one, with all of them in order.
+template<typename T>
+class Barrier {
+private:
+	std::mutex mutex;
+	std::vector<T> results;
+	size_t remaining;
+	std::function<void(std::vector<T>)> done;
+
+public:
+	Barrier(std::vector<T> results, size_t remaining, std::function<void(std::vector<T>)> done)
+	    : results(std::move(results)), remaining(remaining), done(std::move(done)) {}
+
+	void Complete(size_t index, T result) {
+		std::unique_lock<std::mutex> lock(mutex);
+		results[index] = std::move(result);
+		if (--remaining > 0) return;
+		lock.unlock();
+		done(std::move(results));
+	}
+};
+
+#endif// BARRIER_H
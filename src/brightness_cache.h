@@ -0,0 +1,85 @@
+#ifndef BRIGHTNESS_CACHE_H
+#define BRIGHTNESS_CACHE_H
+
+#include <chrono>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+// Last known brightness per monitor id. Entries come from successful reads and
+// writes and are served until they are older than the configured max age.
+class BrightnessCache {
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Entry {
+		int brightness = -1;
+		Clock::time_point updated;
+	};
+
+private:
+	mutable std::shared_mutex mutex;
+	std::unordered_map<std::string, Entry> entries;
+	Clock::duration maxAge;
+
+public:
+	explicit BrightnessCache(Clock::duration maxAge = std::chrono::seconds(1)) : maxAge(maxAge) {}
+
+	// A zero max age disables the cache.
+	void SetMaxAge(Clock::duration age) {
+		std::unique_lock<std::shared_mutex> lock(mutex);
+		maxAge = age;
+	}
+
+	Clock::duration GetMaxAge() const {
+		std::shared_lock<std::shared_mutex> lock(mutex);
+		return maxAge;
+	}
+
+	// Returns true and the cached value if there is an entry younger than the
+	// max age.
+	bool Get(const std::string &id, int &brightness) const {
+		std::shared_lock<std::shared_mutex> lock(mutex);
+		auto it = entries.find(id);
+		if (it == entries.end() || Clock::now() - it->second.updated >= maxAge) return false;
+		brightness = it->second.brightness;
+		return true;
+	}
+
+	// Returns the last known value however old it is.
+	bool Peek(const std::string &id, int &brightness) const {
+		std::shared_lock<std::shared_mutex> lock(mutex);
+		auto it = entries.find(id);
+		if (it == entries.end()) return false;
+		brightness = it->second.brightness;
+		return true;
+	}
+
+	// The same, with how long ago the value was read or written.
+	bool Peek(const std::string &id, int &brightness, Clock::duration &age) const {
+		std::shared_lock<std::shared_mutex> lock(mutex);
+		auto it = entries.find(id);
+		if (it == entries.end()) return false;
+		brightness = it->second.brightness;
+		age = Clock::now() - it->second.updated;
+		return true;
+	}
+
+	void Store(const std::string &id, int brightness) {
+		std::unique_lock<std::shared_mutex> lock(mutex);
+		entries[id] = {brightness, Clock::now()};
+	}
+
+	void Invalidate(const std::string &id) {
+		std::unique_lock<std::shared_mutex> lock(mutex);
+		entries.erase(id);
+	}
+
+	void Clear() {
+		std::unique_lock<std::shared_mutex> lock(mutex);
+		entries.clear();
+	}
+};
+
+#endif// BRIGHTNESS_CACHE_H
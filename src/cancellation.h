@@ -0,0 +1,264 @@
+#ifndef CANCELLATION_H
+#define CANCELLATION_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+enum class CancelReason : std::uint8_t {
+	None,
+	// The request's deadline (timeoutMs) passed.
+	Timeout,
+	// The request's AbortSignal fired.
+	Aborted
+};
+
+// Machine readable code a cancelled request resolves with.
+inline const char *CancelReasonCode(CancelReason reason) {
+	return reason == CancelReason::Aborted ? "ABORTED" : "TIMEOUT";
+}
+
+// Cancels one request, once: when its deadline passes or it is aborted,
+// whichever comes first. Listeners are told right away (or on registration
+// if it already happened). Any thread.
+class Cancellation {
+public:
+	typedef std::chrono::steady_clock Clock;
+	typedef std::function<void(CancelReason)> Listener;
+
+private:
+	mutable std::mutex mutex;
+	CancelReason reason = CancelReason::None;
+	Clock::time_point deadline;
+	std::vector<Listener> listeners;
+
+public:
+	explicit Cancellation(Clock::time_point deadline = Clock::time_point::max()) : deadline(deadline) {}
+
+	Clock::time_point GetDeadline() const {
+		return deadline;
+	}
+
+	// Returns false if the request was already cancelled.
+	bool Cancel(CancelReason value) {
+		std::vector<Listener> notify;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (reason != CancelReason::None) return false;
+			reason = value;
+			notify.swap(listeners);
+		}
+
+		for (auto &listener: notify) listener(value);
+		return true;
+	}
+
+	// Also cancels the request if its deadline has passed, so callers do not
+	// depend on the timer having fired yet.
+	bool IsCancelled() {
+		if (Clock::now() >= deadline) Cancel(CancelReason::Timeout);
+		std::lock_guard<std::mutex> lock(mutex);
+		return reason != CancelReason::None;
+	}
+
+	CancelReason GetReason() const {
+		std::lock_guard<std::mutex> lock(mutex);
+		return reason;
+	}
+
+	void OnCancel(Listener listener) {
+		CancelReason current;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			current = reason;
+			if (current == CancelReason::None) {
+				listeners.push_back(std::move(listener));
+				return;
+			}
+		}
+
+		listener(current);
+	}
+};
+
+// Longest timeoutMs honoured, as with setTimeout(); longer ones, and
+// non-finite ones, mean no deadline.
+constexpr double MAX_TIMEOUT_MS = 2147483647;
+
+// Deadline of a request that may take timeoutMs milliseconds from now, or
+// time_point::max() for none. Negative timeouts are due right away.
+inline Cancellation::Clock::time_point DeadlineAfter(double timeoutMs) {
+	typedef Cancellation::Clock Clock;
+	if (!std::isfinite(timeoutMs) || timeoutMs > MAX_TIMEOUT_MS) return Clock::time_point::max();
+
+	auto now = Clock::now();
+	auto timeout = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(std::max(timeoutMs, 0.0)));
+	return Clock::time_point::max() - now < timeout ? Clock::time_point::max() : now + timeout;
+}
+
+// The cancellation of the request whose I/O the calling thread is doing, for
+// the backends: retry loops and WMI waits stop at its deadline. Null outside
+// a CancellationScope.
+inline Cancellation *&CurrentCancellation() {
+	thread_local Cancellation *current = nullptr;
+	return current;
+}
+
+class CancellationScope {
+private:
+	Cancellation *previous;
+
+public:
+	explicit CancellationScope(Cancellation *cancellation) : previous(CurrentCancellation()) {
+		CurrentCancellation() = cancellation;
+	}
+
+	~CancellationScope() {
+		CurrentCancellation() = previous;
+	}
+
+	CancellationScope(const CancellationScope &) = delete;
+	CancellationScope &operator=(const CancellationScope &) = delete;
+};
+
+// Time left until the current request's deadline, at most limit.
+inline std::chrono::milliseconds RemainingTime(std::chrono::milliseconds limit) {
+	Cancellation *cancellation = CurrentCancellation();
+	if (cancellation == nullptr || cancellation->GetDeadline() == Cancellation::Clock::time_point::max()) return limit;
+
+	auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(cancellation->GetDeadline() - Cancellation::Clock::now());
+	return std::clamp(remaining, std::chrono::milliseconds(0), limit);
+}
+
+// Makes done complete a request exactly once: with the real result, or with
+// whatever cancelled(reason) builds as soon as the request is cancelled,
+// whichever comes first. Without a cancellation done is returned as is.
+template<typename Result>
+std::function<void(Result)> Cancellable(const std::shared_ptr<Cancellation> &cancellation, std::function<void(Result)> done,
+                                        std::function<Result(CancelReason)> cancelled) {
+	if (!cancellation) return done;
+
+	auto finished = std::make_shared<std::once_flag>();
+	auto complete = std::make_shared<std::function<void(Result)>>(std::move(done));
+	// done is let go once called: it may own the request's cancellation.
+	auto finish = [complete](Result result) {
+		std::function<void(Result)> callback = std::move(*complete);
+		*complete = nullptr;
+		callback(std::move(result));
+	};
+
+	cancellation->OnCancel([finished, finish, cancelled](CancelReason reason) {
+		std::call_once(*finished, [&]() { finish(cancelled(reason)); });
+	});
+
+	return [finished, finish](Result result) {
+		std::call_once(*finished, [&]() { finish(std::move(result)); });
+	};
+}
+
+// Cancels requests when their deadline passes. The thread is started with the
+// first deadline; requests that finish earlier take theirs back with
+// Unschedule, so neither the entry nor the cancellation outlives them.
+class DeadlineTimer {
+public:
+	// Identifies a scheduled deadline; 0 means none was.
+	typedef std::uint64_t Token;
+
+private:
+	typedef Cancellation::Clock Clock;
+	typedef std::multimap<Clock::time_point, std::pair<Token, std::weak_ptr<Cancellation>>> Queue;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	Queue pending;
+	std::unordered_map<Token, Queue::iterator> entries;
+	Token nextToken = 1;
+	std::thread thread;
+	bool stopping = false;
+
+	void Run() {
+		std::unique_lock<std::mutex> lock(mutex);
+
+		while (!stopping) {
+			if (pending.empty()) {
+				wake.wait(lock);
+				continue;
+			}
+
+			auto next = pending.begin();
+			if (next->first > Clock::now()) {
+				wake.wait_until(lock, next->first);
+				continue;
+			}
+
+			std::weak_ptr<Cancellation> due = next->second.second;
+			entries.erase(next->second.first);
+			pending.erase(next);
+
+			lock.unlock();
+			if (auto cancellation = due.lock()) cancellation->Cancel(CancelReason::Timeout);
+			lock.lock();
+		}
+	}
+
+public:
+	DeadlineTimer() = default;
+
+	DeadlineTimer(const DeadlineTimer &) = delete;
+	DeadlineTimer &operator=(const DeadlineTimer &) = delete;
+
+	~DeadlineTimer() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+			wake.notify_all();
+		}
+
+		if (thread.joinable()) thread.join();
+	}
+
+	Token Schedule(const std::shared_ptr<Cancellation> &cancellation) {
+		if (!cancellation || cancellation->GetDeadline() == Clock::time_point::max()) return 0;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!thread.joinable()) thread = std::thread([this]() { Run(); });
+
+		Token token = nextToken++;
+		entries.emplace(token, pending.emplace(cancellation->GetDeadline(), std::make_pair(token, cancellation)));
+		wake.notify_all();
+
+		return token;
+	}
+
+	// Drops a deadline that has not fired yet; for requests that finished.
+	void Unschedule(Token token) {
+		if (token == 0) return;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = entries.find(token);
+		if (it == entries.end()) return;
+
+		pending.erase(it->second);
+		entries.erase(it);
+	}
+
+	// Deadlines still waiting.
+	size_t GetPendingCount() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return pending.size();
+	}
+};
+
+#endif// CANCELLATION_H
@@ -0,0 +1,102 @@
+#ifndef DDC_BUS_SCHEDULER_H
+#define DDC_BUS_SCHEDULER_H
+
+#include "ddc_ci.h"
+#include "ddc_transport.h"
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+// Minimum gaps DDC/CI 1.1 requires of the host. A display NAKs, or answers
+// with a null message, when they are not kept.
+struct DdcTiming {
+	// From a Get VCP request to reading its reply.
+	std::chrono::microseconds replyDelay{std::chrono::milliseconds(40)};
+	// From a Set VCP request, or from reading a reply, to the next message.
+	std::chrono::microseconds commandGap{std::chrono::milliseconds(50)};
+
+	// No waiting at all, for transports that do not need it.
+	static DdcTiming Immediate() {
+		return {std::chrono::microseconds(0), std::chrono::microseconds(0)};
+	}
+};
+
+// Paces the VCP transactions of one bus. It knows when the bus is next ready
+// and only waits for whatever part of the gap has not already passed, so a
+// bus that was idle is used right away and a busy one runs at the highest
+// rate the display accepts instead of drawing NAKs and retries. Callers
+// serialize access to the bus; buses are independent, so transactions on
+// different buses overlap freely.
+//
+// A Get for a code that was Set while the bus was still settling is answered
+// with the written value without touching the bus: the display cannot have
+// changed it in the meantime.
+class DdcBusScheduler {
+public:
+	typedef std::chrono::steady_clock Clock;
+
+private:
+	struct Written {
+		std::uint16_t value = 0;
+		Clock::time_point settled;
+	};
+
+	DdcTransport *transport;
+	DdcTiming timing;
+	Clock::time_point ready;
+	std::unordered_map<std::uint8_t, Written> written;
+	// Maximum reported by the last successful read of each code.
+	std::unordered_map<std::uint8_t, std::uint16_t> maximums;
+
+	void WaitUntilReady() {
+		auto now = Clock::now();
+		if (ready <= now) return;
+		waited += std::chrono::duration_cast<std::chrono::microseconds>(ready - now);
+		std::this_thread::sleep_until(ready);
+	}
+
+public:
+	// Transactions that went to the bus and Gets answered from a Set instead.
+	std::uint64_t transactions = 0;
+	std::uint64_t merged = 0;
+	// Total time spent waiting for the bus to become ready.
+	std::chrono::microseconds waited{0};
+
+	DdcBusScheduler(DdcTransport *transport, const DdcTiming &timing) : transport(transport), timing(timing) {}
+
+	bool GetVcp(std::uint8_t code, DdcCi::VcpValue &value) {
+		auto write = written.find(code);
+		auto maximum = maximums.find(code);
+
+		if (write != written.end() && maximum != maximums.end() && Clock::now() < write->second.settled) {
+			value = {write->second.value, maximum->second};
+			merged++;
+			return true;
+		}
+
+		WaitUntilReady();
+		transactions++;
+
+		bool success = DdcCi::Channel(transport, timing.replyDelay).GetVcp(code, value);
+		ready = Clock::now() + timing.commandGap;
+
+		if (success) maximums[code] = value.maximum;
+		return success;
+	}
+
+	bool SetVcp(std::uint8_t code, std::uint16_t value) {
+		WaitUntilReady();
+		transactions++;
+
+		bool success = DdcCi::Channel(transport, timing.replyDelay).SetVcp(code, value);
+		ready = Clock::now() + timing.commandGap;
+
+		if (success) written[code] = {value, ready};
+		else written.erase(code);
+		return success;
+	}
+};
+
+#endif// DDC_BUS_SCHEDULER_H
@@ -0,0 +1,103 @@
+#ifndef DDC_CI_H
+#define DDC_CI_H
+
+#include "ddc_transport.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// DDC/CI message framing (VESA DDC/CI 1.1). Messages from the host start with
+// the host address 0x51 and a length byte (0x80 | payload length); the checksum
+// is the XOR of the destination address and every byte of the message.
+namespace DdcCi {
+	const uint8_t DISPLAY_ADDRESS = 0x6E;
+	const uint8_t HOST_ADDRESS = 0x51;
+	const uint8_t HOST_REPLY_ADDRESS = 0x50;
+
+	const uint8_t GET_VCP_REQUEST = 0x01;
+	const uint8_t GET_VCP_REPLY = 0x02;
+	const uint8_t SET_VCP_REQUEST = 0x03;
+
+	const uint8_t VCP_BRIGHTNESS = 0x10;
+
+	const size_t GET_VCP_REPLY_LENGTH = 11;
+
+	struct VcpValue {
+		uint16_t current = 0;
+		uint16_t maximum = 0;
+	};
+
+	inline uint8_t Checksum(uint8_t seed, const uint8_t *data, size_t length) {
+		uint8_t checksum = seed;
+		for (size_t i = 0; i < length; i++) checksum ^= data[i];
+		return checksum;
+	}
+
+	inline std::vector<uint8_t> EncodeGetVcp(uint8_t code) {
+		std::vector<uint8_t> message = {HOST_ADDRESS, 0x82, GET_VCP_REQUEST, code};
+		message.push_back(Checksum(DISPLAY_ADDRESS, message.data(), message.size()));
+		return message;
+	}
+
+	inline std::vector<uint8_t> EncodeSetVcp(uint8_t code, uint16_t value) {
+		std::vector<uint8_t> message = {HOST_ADDRESS, 0x84, SET_VCP_REQUEST, code,
+		                                static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value & 0xFF)};
+		message.push_back(Checksum(DISPLAY_ADDRESS, message.data(), message.size()));
+		return message;
+	}
+
+	inline std::vector<uint8_t> EncodeGetVcpReply(uint8_t code, bool supported, const VcpValue &value) {
+		std::vector<uint8_t> message = {DISPLAY_ADDRESS, 0x88, GET_VCP_REPLY, static_cast<uint8_t>(supported ? 0x00 : 0x01), code, 0x00,
+		                                static_cast<uint8_t>(value.maximum >> 8), static_cast<uint8_t>(value.maximum & 0xFF),
+		                                static_cast<uint8_t>(value.current >> 8), static_cast<uint8_t>(value.current & 0xFF)};
+		message.push_back(Checksum(HOST_REPLY_ADDRESS, message.data(), message.size()));
+		return message;
+	}
+
+	// Validates a Get VCP Feature reply for the given code. Null messages (the
+	// display is busy), bad checksums and unsupported codes all fail.
+	inline bool DecodeGetVcpReply(const uint8_t *data, size_t length, uint8_t code, VcpValue &value) {
+		if (length < GET_VCP_REPLY_LENGTH) return false;
+		if (data[0] != DISPLAY_ADDRESS || data[1] != 0x88 || data[2] != GET_VCP_REPLY) return false;
+		if (Checksum(HOST_REPLY_ADDRESS, data, GET_VCP_REPLY_LENGTH - 1) != data[GET_VCP_REPLY_LENGTH - 1]) return false;
+		if (data[3] != 0x00 || data[4] != code) return false;
+
+		value.maximum = static_cast<uint16_t>((data[6] << 8) | data[7]);
+		value.current = static_cast<uint16_t>((data[8] << 8) | data[9]);
+
+		return true;
+	}
+
+	// Performs VCP transactions over a transport. The display needs time to
+	// prepare a reply after a Get request, which is what replyDelay waits for.
+	class Channel {
+	private:
+		DdcTransport *transport;
+		std::chrono::microseconds replyDelay;
+
+	public:
+		Channel(DdcTransport *transport, std::chrono::microseconds replyDelay)
+		    : transport(transport), replyDelay(replyDelay) {}
+
+		bool GetVcp(uint8_t code, VcpValue &value) {
+			std::vector<uint8_t> request = EncodeGetVcp(code);
+			if (!transport->Write(request.data(), request.size())) return false;
+
+			std::this_thread::sleep_for(replyDelay);
+
+			uint8_t reply[GET_VCP_REPLY_LENGTH] = {};
+			if (!transport->Read(reply, sizeof(reply))) return false;
+
+			return DecodeGetVcpReply(reply, sizeof(reply), code, value);
+		}
+
+		bool SetVcp(uint8_t code, uint16_t value) {
+			std::vector<uint8_t> request = EncodeSetVcp(code, value);
+			return transport->Write(request.data(), request.size());
+		}
+	};
+}// namespace DdcCi
+
+#endif// DDC_CI_H
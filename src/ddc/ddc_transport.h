@@ -0,0 +1,19 @@
+#ifndef DDC_TRANSPORT_H
+#define DDC_TRANSPORT_H
+
+#include <cstddef>
+#include <cstdint>
+
+// One DDC/CI channel to a single display (I2C slave address 0x37). Write and
+// Read each move a complete I2C message and return false when the display NAKs
+// or the bus reports an error.
+class DdcTransport {
+public:
+	virtual ~DdcTransport() = default;
+
+	virtual bool Write(const uint8_t *data, size_t length) = 0;
+
+	virtual bool Read(uint8_t *data, size_t length) = 0;
+};
+
+#endif// DDC_TRANSPORT_H
@@ -0,0 +1,131 @@
+#ifndef EMULATED_DDC_MONITOR_H
+#define EMULATED_DDC_MONITOR_H
+
+#include "ddc_ci.h"
+#include "ddc_transport.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+struct EmulatedDdcOptions {
+	// Time the emulated display takes to accept each I2C message.
+	std::chrono::microseconds latency{0};
+	// Probability that any single write or read is NAKed.
+	double nakRate = 0;
+	uint16_t brightness = 50;
+	uint16_t maxBrightness = 100;
+	unsigned seed = 1;
+	// Gaps the display insists on, like a real one: reading a reply sooner
+	// than minReplyDelay after its request, or sending a message sooner than
+	// minCommandGap after a Set or a reply, is NAKed as a timing violation.
+	std::chrono::microseconds minReplyDelay{0};
+	std::chrono::microseconds minCommandGap{0};
+};
+
+// An in-process display that speaks DDC/CI, for exercising the DDC stack
+// without an I2C bus. Only VCP 0x10 (brightness) is implemented; other codes
+// are answered as unsupported.
+class EmulatedDdcMonitor : public DdcTransport {
+private:
+	EmulatedDdcOptions options;
+	std::mutex mutex;
+	std::mt19937 random;
+	std::vector<uint8_t> pendingReply;
+	uint16_t brightness;
+	// When the display accepts the next message and the pending reply.
+	std::chrono::steady_clock::time_point ready;
+	std::chrono::steady_clock::time_point replyReady;
+
+	bool Nak() {
+		if (options.nakRate <= 0) return false;
+		if (std::uniform_real_distribution<double>(0, 1)(random) >= options.nakRate) return false;
+		naks++;
+		return true;
+	}
+
+public:
+	std::atomic<int> writes{0};
+	std::atomic<int> reads{0};
+	std::atomic<int> naks{0};
+	std::atomic<int> timingViolations{0};
+
+	explicit EmulatedDdcMonitor(const EmulatedDdcOptions &options = {})
+	    : options(options), random(options.seed), brightness(options.brightness) {}
+
+	uint16_t GetBrightness() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return brightness;
+	}
+
+	bool Write(const uint8_t *data, size_t length) override {
+		auto arrived = std::chrono::steady_clock::now();
+		std::this_thread::sleep_for(options.latency);
+		std::lock_guard<std::mutex> lock(mutex);
+		writes++;
+
+		if (arrived < ready) {
+			timingViolations++;
+			naks++;
+			return false;
+		}
+
+		if (Nak()) return false;
+		if (length < 3 || data[0] != DdcCi::HOST_ADDRESS) return false;
+
+		size_t payload = data[1] & 0x7F;
+		if ((data[1] & 0x80) == 0 || length != payload + 3) return false;
+		if (DdcCi::Checksum(DdcCi::DISPLAY_ADDRESS, data, length - 1) != data[length - 1]) return false;
+
+		if (data[2] == DdcCi::GET_VCP_REQUEST && payload == 2) {
+			bool supported = data[3] == DdcCi::VCP_BRIGHTNESS;
+			pendingReply = DdcCi::EncodeGetVcpReply(data[3], supported, {brightness, options.maxBrightness});
+			replyReady = std::chrono::steady_clock::now() + options.minReplyDelay;
+			ready = replyReady;
+			return true;
+		}
+
+		if (data[2] == DdcCi::SET_VCP_REQUEST && payload == 4) {
+			if (data[3] == DdcCi::VCP_BRIGHTNESS) {
+				brightness = std::min<uint16_t>(static_cast<uint16_t>((data[4] << 8) | data[5]), options.maxBrightness);
+			}
+			ready = std::chrono::steady_clock::now() + options.minCommandGap;
+			return true;
+		}
+
+		return false;
+	}
+
+	bool Read(uint8_t *data, size_t length) override {
+		auto arrived = std::chrono::steady_clock::now();
+		std::this_thread::sleep_for(options.latency);
+		std::lock_guard<std::mutex> lock(mutex);
+		reads++;
+
+		// A reply read too early is lost; the request has to be sent again.
+		if (!pendingReply.empty() && arrived < replyReady) {
+			pendingReply.clear();
+			timingViolations++;
+			naks++;
+			return false;
+		}
+
+		if (Nak()) return false;
+		ready = std::chrono::steady_clock::now() + options.minCommandGap;
+
+		// With nothing to report a display answers with a null message.
+		std::vector<uint8_t> reply = pendingReply.empty() ? std::vector<uint8_t>{DdcCi::DISPLAY_ADDRESS, 0x80, 0xBE} : pendingReply;
+		pendingReply.clear();
+
+		std::fill(data, data + length, 0);
+		std::copy_n(reply.begin(), std::min(length, reply.size()), data);
+
+		return true;
+	}
+};
+
+#endif// EMULATED_DDC_MONITOR_H
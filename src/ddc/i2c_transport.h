@@ -0,0 +1,47 @@
+#ifndef I2C_TRANSPORT_H
+#define I2C_TRANSPORT_H
+
+#include "ddc_transport.h"
+#include <fcntl.h>
+#include <linux/i2c-dev.h>
+#include <string>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+// DDC/CI over the Linux i2c-dev interface. The bus device is opened once and
+// bound to the DDC/CI slave address; the descriptor stays open until the
+// transport is destroyed.
+class I2cTransport : public DdcTransport {
+private:
+	static const int DDC_CI_ADDRESS = 0x37;
+
+	int fd = -1;
+
+public:
+	explicit I2cTransport(const std::string &path) {
+		fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+
+		if (fd != -1 && ioctl(fd, I2C_SLAVE, DDC_CI_ADDRESS) < 0) {
+			close(fd);
+			fd = -1;
+		}
+	}
+
+	~I2cTransport() override {
+		if (fd != -1) close(fd);
+	}
+
+	bool IsOpen() const {
+		return fd != -1;
+	}
+
+	bool Write(const uint8_t *data, size_t length) override {
+		return fd != -1 && write(fd, data, length) == static_cast<ssize_t>(length);
+	}
+
+	bool Read(uint8_t *data, size_t length) override {
+		return fd != -1 && read(fd, data, length) == static_cast<ssize_t>(length);
+	}
+};
+
+#endif// I2C_TRANSPORT_H
@@ -0,0 +1,164 @@
+#ifndef EDID_H
+#define EDID_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+// EDID 1.x base block decoding (VESA E-EDID). The parser works over borrowed
+// bytes and never allocates: numeric fields are decoded in place and the
+// descriptor strings are views into the input, valid as long as it is.
+// Extension blocks are counted but not decoded.
+namespace Edid {
+	const size_t BLOCK_LENGTH = 128;
+
+	const uint8_t DESCRIPTOR_SERIAL = 0xFF;
+	const uint8_t DESCRIPTOR_TEXT = 0xFE;
+	const uint8_t DESCRIPTOR_NAME = 0xFC;
+
+	struct Timing {
+		uint32_t pixelClockKHz = 0;
+		uint16_t width = 0;
+		uint16_t height = 0;
+		// Refresh rate in thousandths of a hertz (59940 for 59.94 Hz).
+		uint32_t refreshMilliHz = 0;
+		// Image size in millimeters; zero if the display does not say.
+		uint16_t widthMm = 0;
+		uint16_t heightMm = 0;
+		bool interlaced = false;
+	};
+
+	struct Info {
+		// Three letter PNP id, e.g. "DEL", NUL terminated.
+		char manufacturer[4] = {};
+		uint16_t productCode = 0;
+		uint32_t serialNumber = 0;
+		uint8_t week = 0;
+		uint16_t year = 0;
+		uint8_t version = 0;
+		uint8_t revision = 0;
+		bool digital = false;
+		// Physical size in centimeters; zero for projectors and unknown sizes.
+		uint8_t widthCm = 0;
+		uint8_t heightCm = 0;
+		// Display descriptors (FC, FF and the first FE), trimmed.
+		std::string_view name;
+		std::string_view serial;
+		std::string_view text;
+		bool hasPreferredTiming = false;
+		Timing preferredTiming;
+		uint8_t extensions = 0;
+	};
+
+	// A descriptor string is up to 13 bytes, ended by a line feed and padded
+	// with spaces.
+	inline std::string_view DescriptorText(const uint8_t *descriptor) {
+		const char *text = reinterpret_cast<const char *>(descriptor + 5);
+		size_t length = 0;
+
+		while (length < 13 && text[length] != '\n' && text[length] != '\0') length++;
+		while (length > 0 && text[length - 1] == ' ') length--;
+
+		return std::string_view(text, length);
+	}
+
+	inline Timing DecodeTiming(const uint8_t *descriptor) {
+		Timing timing;
+		uint32_t clock = static_cast<uint32_t>(descriptor[0] | (descriptor[1] << 8)) * 10;
+		uint32_t width = descriptor[2] | ((descriptor[4] & 0xF0) << 4);
+		uint32_t horizontalBlank = descriptor[3] | ((descriptor[4] & 0x0F) << 8);
+		uint32_t height = descriptor[5] | ((descriptor[7] & 0xF0) << 4);
+		uint32_t verticalBlank = descriptor[6] | ((descriptor[7] & 0x0F) << 8);
+		uint64_t total = static_cast<uint64_t>(width + horizontalBlank) * (height + verticalBlank);
+
+		timing.pixelClockKHz = clock;
+		timing.width = static_cast<uint16_t>(width);
+		timing.height = static_cast<uint16_t>(height);
+		timing.refreshMilliHz = total > 0 ? static_cast<uint32_t>((static_cast<uint64_t>(clock) * 1000000 + total / 2) / total) : 0;
+		timing.widthMm = static_cast<uint16_t>(descriptor[12] | ((descriptor[14] & 0xF0) << 4));
+		timing.heightMm = static_cast<uint16_t>(descriptor[13] | ((descriptor[14] & 0x0F) << 8));
+		timing.interlaced = (descriptor[17] & 0x80) != 0;
+
+		return timing;
+	}
+
+	// Decodes the base block. Fails on short input, a wrong header or a bad
+	// checksum.
+	inline bool Parse(const uint8_t *data, size_t length, Info &info) {
+		static const uint8_t header[8] = {0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00};
+
+		if (data == nullptr || length < BLOCK_LENGTH) return false;
+
+		uint8_t checksum = 0;
+		for (size_t i = 0; i < BLOCK_LENGTH; i++) checksum += data[i];
+		if (checksum != 0) return false;
+
+		for (size_t i = 0; i < sizeof(header); i++) {
+			if (data[i] != header[i]) return false;
+		}
+
+		info = Info();
+
+		// Three 5-bit letters, big endian, 'A' = 1.
+		uint16_t id = static_cast<uint16_t>((data[8] << 8) | data[9]);
+		info.manufacturer[0] = static_cast<char>('A' - 1 + ((id >> 10) & 0x1F));
+		info.manufacturer[1] = static_cast<char>('A' - 1 + ((id >> 5) & 0x1F));
+		info.manufacturer[2] = static_cast<char>('A' - 1 + (id & 0x1F));
+
+		info.productCode = static_cast<uint16_t>(data[10] | (data[11] << 8));
+		info.serialNumber = static_cast<uint32_t>(data[12] | (data[13] << 8) | (data[14] << 16)) | (static_cast<uint32_t>(data[15]) << 24);
+		info.week = data[16];
+		info.year = static_cast<uint16_t>(1990 + data[17]);
+		info.version = data[18];
+		info.revision = data[19];
+		info.digital = (data[20] & 0x80) != 0;
+		info.widthCm = data[21];
+		info.heightCm = data[22];
+		info.extensions = data[126];
+
+		for (size_t offset = 54; offset < 126; offset += 18) {
+			const uint8_t *descriptor = data + offset;
+
+			// A non-zero pixel clock marks a detailed timing; the first one is
+			// the preferred mode.
+			if (descriptor[0] != 0 || descriptor[1] != 0) {
+				if (!info.hasPreferredTiming) {
+					info.preferredTiming = DecodeTiming(descriptor);
+					info.hasPreferredTiming = true;
+				}
+				continue;
+			}
+
+			switch (descriptor[3]) {
+				case DESCRIPTOR_NAME:
+					info.name = DescriptorText(descriptor);
+					break;
+				case DESCRIPTOR_SERIAL:
+					info.serial = DescriptorText(descriptor);
+					break;
+				case DESCRIPTOR_TEXT:
+					if (info.text.empty()) info.text = DescriptorText(descriptor);
+					break;
+			}
+		}
+
+		return true;
+	}
+
+	// Product code as four hex digits, as Windows reports it (e.g. "A0F6").
+	inline std::string ProductCodeString(const Info &info) {
+		char buffer[5];
+		std::snprintf(buffer, sizeof(buffer), "%04X", info.productCode);
+		return buffer;
+	}
+
+	// The serial descriptor if present, the numeric serial otherwise.
+	inline std::string SerialString(const Info &info) {
+		if (!info.serial.empty()) return std::string(info.serial);
+		return std::to_string(info.serialNumber);
+	}
+}// namespace Edid
+
+#endif// EDID_H
@@ -0,0 +1,326 @@
+#ifndef FADE_SCHEDULER_H
+#define FADE_SCHEDULER_H
+
+#include "monitor.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+enum class FadeEasing {
+	Linear,
+	EaseIn,
+	EaseOut,
+	EaseInOut
+};
+
+enum class FadeStatus {
+	Completed,
+	// The final value could not be written to at least one monitor.
+	Failed,
+	Cancelled,
+	// Every monitor of the fade was taken over by a newer fade.
+	Superseded
+};
+
+// Maps linear progress in [0, 1] to eased progress (quadratic curves).
+inline double Ease(FadeEasing easing, double t) {
+	switch (easing) {
+		case FadeEasing::EaseIn:
+			return t * t;
+		case FadeEasing::EaseOut:
+			return t * (2 - t);
+		case FadeEasing::EaseInOut:
+			return t < 0.5 ? 2 * t * t : -1 + (4 - 2 * t) * t;
+		default:
+			return t;
+	}
+}
+
+// Runs brightness fades. One timer thread computes where every running fade
+// should be; each monitor has a writer thread that applies the newest step
+// handed to it. While a write is still on the bus, newer steps replace the
+// pending one, so a slow monitor skips intermediate values instead of falling
+// behind, and steps are scheduled no faster than the monitor's measured write
+// latency.
+class FadeScheduler {
+public:
+	typedef std::function<int(const MonitorRef &)> Reader;
+	typedef std::function<bool(const MonitorRef &, int)> Writer;
+	typedef std::function<void(FadeStatus)> Callback;
+	typedef std::chrono::steady_clock Clock;
+
+private:
+	struct Lane;
+
+	struct Track {
+		MonitorRef ref;
+		// Whatever owns the native handle in ref, held until the last step ran.
+		std::shared_ptr<const void> owner;
+		// Starting level; read by the writer before the first step if unknown.
+		int from = -1;
+		int target = 0;
+		Lane *lane = nullptr;
+		Clock::time_point nextStep;
+		bool finalPosted = false;
+		bool finished = false;
+		bool failed = false;
+		bool superseded = false;
+	};
+
+	struct Fade {
+		std::uint64_t id = 0;
+		Clock::time_point start;
+		Clock::duration duration{0};
+		FadeEasing easing = FadeEasing::Linear;
+		std::vector<std::shared_ptr<Track>> tracks;
+		Callback callback;
+	};
+
+	struct Step {
+		std::shared_ptr<Track> track;
+		double progress = 0;
+		bool final = false;
+	};
+
+	struct Lane {
+		std::thread thread;
+		std::condition_variable wake;
+		std::unique_ptr<Step> pending;
+		int lastWritten = -1;
+		// Smoothed duration of one write on this monitor.
+		Clock::duration latency{0};
+	};
+
+	Reader read;
+	Writer write;
+	Clock::duration frame;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::thread timer;
+	bool stopping = false;
+	std::uint64_t nextId = 1;
+	std::vector<std::unique_ptr<Fade>> fades;
+	std::unordered_map<std::string, std::unique_ptr<Lane>> lanes;
+
+	Lane *LaneFor(const std::string &id) {
+		auto &lane = lanes[id];
+		if (!lane) {
+			lane = std::make_unique<Lane>();
+			Lane *created = lane.get();
+			created->thread = std::thread([this, created]() { RunLane(created); });
+		}
+		return lane.get();
+	}
+
+	void RunLane(Lane *lane) {
+		std::unique_lock<std::mutex> lock(mutex);
+
+		while (true) {
+			lane->wake.wait(lock, [&]() { return stopping || lane->pending; });
+			if (stopping) return;
+
+			Step step = std::move(*lane->pending);
+			lane->pending.reset();
+			Track &track = *step.track;
+			lock.unlock();
+
+			int from = track.from;
+			if (from < 0) from = read(track.ref);
+			if (from < 0) from = track.target;
+
+			int value = static_cast<int>(std::lround(from + (track.target - from) * step.progress));
+			bool written = true;
+			auto started = Clock::now();
+
+			if (step.final || value != lane->lastWritten) written = write(track.ref, value);
+
+			auto elapsed = Clock::now() - started;
+
+			lock.lock();
+			track.from = from;
+			if (written) lane->lastWritten = value;
+			lane->latency = lane->latency.count() == 0 ? elapsed : (lane->latency * 3 + elapsed) / 4;
+
+			if (step.final && !track.superseded) {
+				track.finished = true;
+				track.failed = !written;
+				wake.notify_all();
+			}
+		}
+	}
+
+	void RunTimer() {
+		std::unique_lock<std::mutex> lock(mutex);
+
+		while (!stopping) {
+			auto now = Clock::now();
+			auto next = now + std::chrono::seconds(1);
+			std::vector<std::pair<Callback, FadeStatus>> completed;
+
+			for (auto &fade: fades) {
+				double t = fade->duration.count() > 0 ? std::min(1.0, std::chrono::duration<double>(now - fade->start) / fade->duration) : 1.0;
+
+				for (auto &track: fade->tracks) {
+					if (track->finalPosted) continue;
+
+					if (now >= track->nextStep) {
+						track->finalPosted = t >= 1.0;
+						track->lane->pending = std::make_unique<Step>(Step{track, Ease(fade->easing, t), track->finalPosted});
+						track->lane->wake.notify_one();
+						track->nextStep = now + std::max(frame, track->lane->latency);
+					}
+
+					if (!track->finalPosted) next = std::min(next, track->nextStep);
+				}
+			}
+
+			for (auto it = fades.begin(); it != fades.end();) {
+				auto &tracks = (*it)->tracks;
+				bool finished = std::all_of(tracks.begin(), tracks.end(), [](const std::shared_ptr<Track> &track) { return track->finished; });
+
+				if (finished) {
+					bool failed = std::any_of(tracks.begin(), tracks.end(), [](const std::shared_ptr<Track> &track) { return track->failed; });
+					completed.emplace_back(std::move((*it)->callback), failed ? FadeStatus::Failed : FadeStatus::Completed);
+					it = fades.erase(it);
+				} else {
+					++it;
+				}
+			}
+
+			if (!completed.empty()) {
+				lock.unlock();
+				for (auto &entry: completed) entry.first(entry.second);
+				lock.lock();
+				continue;
+			}
+
+			wake.wait_until(lock, next);
+		}
+	}
+
+public:
+	FadeScheduler(Reader read, Writer write, Clock::duration frame = std::chrono::milliseconds(16))
+	    : read(std::move(read)), write(std::move(write)), frame(frame) {}
+
+	FadeScheduler(const FadeScheduler &) = delete;
+	FadeScheduler &operator=(const FadeScheduler &) = delete;
+
+	~FadeScheduler() {
+		std::vector<Callback> cancelled;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+			for (auto &fade: fades) cancelled.emplace_back(std::move(fade->callback));
+			fades.clear();
+			wake.notify_all();
+			for (auto &lane: lanes) lane.second->wake.notify_all();
+		}
+
+		if (timer.joinable()) timer.join();
+		for (auto &lane: lanes) lane.second->thread.join();
+		for (auto &callback: cancelled) callback(FadeStatus::Cancelled);
+	}
+
+	// Fades every given monitor to target over duration and calls back once the
+	// final value was written everywhere. Monitors already fading are taken
+	// over; a fade that loses all its monitors completes as superseded. A known
+	// starting level can be passed per monitor, otherwise it is read first.
+	// owner is kept alive while the refs are in use.
+	std::uint64_t Start(const std::vector<std::pair<MonitorRef, int>> &monitors, int target, Clock::duration duration,
+	                    FadeEasing easing, std::shared_ptr<const void> owner, Callback callback) {
+		std::vector<Callback> superseded;
+		std::uint64_t id;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			id = nextId++;
+
+			auto fade = std::make_unique<Fade>();
+			fade->id = id;
+			fade->start = Clock::now();
+			fade->duration = duration;
+			fade->easing = easing;
+			fade->callback = std::move(callback);
+
+			for (const auto &monitor: monitors) {
+				for (auto &existing: fades) {
+					for (auto &track: existing->tracks) {
+						if (track->ref.id == monitor.first.id) track->superseded = true;
+					}
+				}
+			}
+
+			for (auto it = fades.begin(); it != fades.end();) {
+				auto &tracks = (*it)->tracks;
+				tracks.erase(std::remove_if(tracks.begin(), tracks.end(), [](const std::shared_ptr<Track> &track) { return track->superseded; }), tracks.end());
+
+				if (tracks.empty()) {
+					superseded.emplace_back(std::move((*it)->callback));
+					it = fades.erase(it);
+				} else {
+					++it;
+				}
+			}
+
+			for (const auto &monitor: monitors) {
+				auto track = std::make_shared<Track>();
+				track->ref = monitor.first;
+				track->owner = owner;
+				track->from = monitor.second;
+				track->target = std::clamp(target, 0, 100);
+				track->lane = LaneFor(monitor.first.id);
+				track->nextStep = fade->start;
+				fade->tracks.emplace_back(track);
+			}
+
+			fades.emplace_back(std::move(fade));
+
+			if (!timer.joinable()) timer = std::thread([this]() { RunTimer(); });
+			wake.notify_all();
+		}
+
+		for (auto &entry: superseded) entry(FadeStatus::Superseded);
+
+		return id;
+	}
+
+	// Stops a running fade where it is. Returns false if it already finished.
+	bool Cancel(std::uint64_t id) {
+		Callback callback;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto it = std::find_if(fades.begin(), fades.end(), [&](const std::unique_ptr<Fade> &fade) { return fade->id == id; });
+			if (it == fades.end()) return false;
+
+			for (auto &track: (*it)->tracks) {
+				track->superseded = true;
+				if (track->lane->pending && track->lane->pending->track == track) track->lane->pending.reset();
+			}
+
+			callback = std::move((*it)->callback);
+			fades.erase(it);
+		}
+
+		callback(FadeStatus::Cancelled);
+		return true;
+	}
+
+	bool IsRunning(std::uint64_t id) {
+		std::lock_guard<std::mutex> lock(mutex);
+		return std::any_of(fades.begin(), fades.end(), [&](const std::unique_ptr<Fade> &fade) { return fade->id == id; });
+	}
+};
+
+#endif// FADE_SCHEDULER_H
@@ -1,105 +1,285 @@
-#include "monitor_service.h"
-#include "utils.h"
-#include "workers/get_brightness.h"
-#include "workers/set_brightness.h"
-#include <napi.h>
-#include <sstream>
-
-Napi::Promise SetBrightness(const Napi::CallbackInfo &info) {
-	Napi::Env env = info.Env();
-
-	std::vector<MonitorBrightnessConfiguration> configList = {};
-
-	if (!info[0].IsUndefined() && info[1].IsUndefined()) {
-		if (info[0].IsObject()) {
-			Napi::Object providedConfig = info[0].As<Napi::Object>();
-			Napi::Array monitors = providedConfig.GetPropertyNames();
-			for (size_t i = 0; i < monitors.Length(); i++) {
-				std::string monitorId = monitors.Get(i).As<Napi::String>().Utf8Value();
-				Napi::Value providedBrightness = providedConfig.Get(monitorId);
-				if (providedBrightness.IsNumber()) {
-					MonitorBrightnessConfiguration config = {};
-					config.monitorId = monitorId;
-					config.brightness = providedBrightness.As<Napi::Number>().Int32Value();
-					configList.emplace_back(config);
-				}
-			}
-		} else if (info[0].IsNumber()) {
-			MonitorBrightnessConfiguration config = {};
-			config.monitorId = "primary";
-			config.brightness = info[0].As<Napi::Number>().Int32Value();
-			configList.emplace_back(config);
-		}
-	} else {
-		MonitorBrightnessConfiguration config = {};
-		config.monitorId = info[0].As<Napi::String>().Utf8Value();
-		config.brightness = info[1].As<Napi::Number>().Uint32Value();
-		configList.emplace_back(config);
-	}
-
-	SetBrightnessWorker *worker = new SetBrightnessWorker(env, configList);
-	auto promise = worker->GetPromise();
-	worker->Queue();
-
-	return promise;
-}
-
-Napi::Promise GetBrightness(const Napi::CallbackInfo &info) {
-	Napi::Env env = info.Env();
-
-	std::string monitorId = "";
-
-	if (!info[0].IsUndefined()) monitorId = info[0].As<Napi::String>().Utf8Value();
-
-	GetBrightnessWorker *worker = new GetBrightnessWorker(env, monitorId);
-	auto promise = worker->GetPromise();
-	worker->Queue();
-
-	return promise;
-}
-
-Napi::Value GetMonitors(const Napi::CallbackInfo &info) {
-	Napi::Env env = info.Env();
-	std::vector<Monitor> monitors = {};
-
-	MonitorService *service = new MonitorService();
-	monitors = service->GetAvailableMonitors();
-
-	Napi::Array jsArray = Napi::Array::New(env, monitors.size());
-
-	for (size_t i = 0; i < monitors.size(); ++i) {
-		auto monitor = monitors[i];
-		Napi::Object result = Napi::Object::New(env);
-		Napi::Object size = Napi::Object::New(env);
-		Napi::Object position = Napi::Object::New(env);
-		result.Set(Napi::String::New(env, "id"), monitor.id);
-		result.Set(Napi::String::New(env, "displayId"), ToNapiString(env, std::to_string(monitor.displayId)));
-		result.Set(Napi::String::New(env, "name"), ToNapiString(env, monitor.name));
-		result.Set(Napi::String::New(env, "manufacturer"), ToNapiString(env, monitor.manufacturer));
-		result.Set(Napi::String::New(env, "serialNumber"), ToNapiString(env, monitor.serialNumber));
-		result.Set(Napi::String::New(env, "productCode"), ToNapiString(env, monitor.productCode));
-		result.Set(Napi::String::New(env, "internal"), Napi::Boolean::New(env, monitor.internal));
-		size.Set(Napi::String::New(env, "width"), Napi::Number::New(env, monitor.size.width));
-		size.Set(Napi::String::New(env, "height"), Napi::Number::New(env, monitor.size.height));
-		position.Set(Napi::String::New(env, "x"), Napi::Number::New(env, monitor.position.x));
-		position.Set(Napi::String::New(env, "y"), Napi::Number::New(env, monitor.position.y));
-		result.Set(Napi::String::New(env, "size"), size);
-		result.Set(Napi::String::New(env, "position"), position);
-		jsArray.Set(i, result);
-	}
-
-	return jsArray;
-}
-
-Napi::Object Init(Napi::Env env, Napi::Object exports) {
-	Napi::HandleScope scope(env);
-
-	exports.Set(Napi::String::New(env, "GLOBAL"), Napi::String::New(env, ALL_MONITORS));
-	exports.Set(Napi::String::New(env, "get"), Napi::Function::New(env, GetBrightness));
-	exports.Set(Napi::String::New(env, "set"), Napi::Function::New(env, SetBrightness));
-	exports.Set(Napi::String::New(env, "monitors"), Napi::Function::New(env, GetMonitors));
-
-	return exports;
-}
-
+#include "backends/default_backend.h"
+#include "monitor_service.h"
+#include "utils.h"
+#include "workers/completion_queue.h"
+#include "workers/discover_monitors.h"
+#include "workers/fade_brightness.h"
+#include "workers/get_all_brightness.h"
+#include "workers/get_brightness.h"
+#include "workers/get_monitors.h"
+#include "workers/request_cancellation.h"
+#include "workers/set_brightness.h"
+#include "workers/set_many_brightness.h"
+#include "workers/watch_brightness.h"
+#include "workers/watch_topology.h"
+#include <algorithm>
+#include <chrono>
+#include <napi.h>
+#include <sstream>
+
+MonitorService &GetMonitorService() {
+	static MonitorService service(CreateDefaultBackend());
+	return service;
+}
+
+SetBrightnessOptions ParseSetBrightnessOptions(const Napi::Value &value) {
+	SetBrightnessOptions options;
+	if (!value.IsObject()) return options;
+
+	Napi::Object object = value.As<Napi::Object>();
+	if (object.Get("coalesce").IsBoolean()) options.coalesce = object.Get("coalesce").As<Napi::Boolean>().Value();
+	options.priority = ParsePriority(object);
+
+	return options;
+}
+
+Napi::Promise SetBrightness(const Napi::CallbackInfo &info) {
+	Napi::Env env = info.Env();
+
+	std::vector<MonitorBrightnessConfiguration> configList = {};
+	Napi::Value providedOptions = env.Undefined();
+
+	if (info[0].IsObject()) {
+		Napi::Object providedConfig = info[0].As<Napi::Object>();
+		Napi::Array monitors = providedConfig.GetPropertyNames();
+		for (size_t i = 0; i < monitors.Length(); i++) {
+			std::string monitorId = monitors.Get(i).As<Napi::String>().Utf8Value();
+			Napi::Value providedBrightness = providedConfig.Get(monitorId);
+			if (providedBrightness.IsNumber()) {
+				MonitorBrightnessConfiguration config = {};
+				config.monitorId = monitorId;
+				config.brightness = providedBrightness.As<Napi::Number>().Int32Value();
+				configList.emplace_back(config);
+			}
+		}
+		providedOptions = info[1];
+	} else if (info[0].IsNumber() && info[1].IsNumber()) {
+		// A handle from lumi.handle(): no id to convert or look up.
+		return SetBrightnessRequest::Start(env, info[0].As<Napi::Number>().Uint32Value(), info[1].As<Napi::Number>().Int32Value(),
+		                                   ParseSetBrightnessOptions(info[2]), RequestCancellation::From(info[2]));
+	} else if (info[0].IsNumber()) {
+		MonitorBrightnessConfiguration config = {};
+		config.monitorId = "primary";
+		config.brightness = info[0].As<Napi::Number>().Int32Value();
+		configList.emplace_back(config);
+		providedOptions = info[1];
+	} else if (info[0].IsString() && info[1].IsNumber()) {
+		MonitorBrightnessConfiguration config = {};
+		config.monitorId = info[0].As<Napi::String>().Utf8Value();
+		config.brightness = info[1].As<Napi::Number>().Uint32Value();
+		configList.emplace_back(config);
+		providedOptions = info[2];
+	}
+
+	return SetBrightnessRequest::Start(env, configList, ParseSetBrightnessOptions(providedOptions), RequestCancellation::From(providedOptions));
+}
+
+Napi::Promise GetBrightness(const Napi::CallbackInfo &info) {
+	Napi::Env env = info.Env();
+
+	std::string monitorId = "";
+	GetBrightnessOptions options;
+	bool targeted = info[0].IsString() || info[0].IsNumber();
+	Napi::Value providedOptions = targeted ? info[1] : info[0];
+
+	if (providedOptions.IsObject()) options.fresh = providedOptions.As<Napi::Object>().Get("fresh").ToBoolean();
+	options.priority = ParsePriority(providedOptions);
+	auto request = RequestCancellation::From(providedOptions);
+	if (info[0].IsNumber()) return GetBrightnessRequest::Start(env, info[0].As<Napi::Number>().Uint32Value(), options, request);
+	if (info[0].IsString()) monitorId = info[0].As<Napi::String>().Utf8Value();
+
+	return GetBrightnessRequest::Start(env, monitorId, options, request);
+}
+
+Napi::Promise GetAllBrightness(const Napi::CallbackInfo &info) {
+	GetBrightnessOptions options;
+	if (info[0].IsObject()) options.fresh = info[0].As<Napi::Object>().Get("fresh").ToBoolean();
+	options.priority = ParsePriority(info[0]);
+
+	return GetAllBrightnessRequest::Start(info.Env(), options, RequestCancellation::From(info[0]));
+}
+
+Napi::Value GetMonitors(const Napi::CallbackInfo &info) {
+	return GetMonitorsRequest::ToArray(info.Env(), GetMonitorService().GetAvailableMonitors());
+}
+
+Napi::Promise GetMonitorsAsync(const Napi::CallbackInfo &info) {
+	return GetMonitorsRequest::Start(info.Env());
+}
+
+Napi::Value GetCachedBrightness(const Napi::CallbackInfo &info) {
+	Napi::Env env = info.Env();
+	MonitorService &service = GetMonitorService();
+	int brightness = -1;
+	std::chrono::milliseconds age;
+	bool known;
+
+	if (info[0].IsNumber()) known = service.GetCachedBrightness(info[0].As<Napi::Number>().Uint32Value(), brightness, age);
+	else known = service.GetCachedBrightness(info[0].IsString() ? info[0].As<Napi::String>().Utf8Value() : "", brightness, age);
+
+	if (!known) return env.Null();
+
+	Napi::Object result = Napi::Object::New(env);
+	result.Set("brightness", Napi::Number::New(env, brightness));
+	result.Set("age", Napi::Number::New(env, static_cast<double>(age.count())));
+	return result;
+}
+
+Napi::Value GetHealth(const Napi::CallbackInfo &info) {
+	Napi::Env env = info.Env();
+	std::vector<MonitorHealth> monitors = GetMonitorService().GetHealth();
+	Napi::Array result = Napi::Array::New(env, monitors.size());
+	static const char *states[] = {"closed", "open", "half-open"};
+
+	for (size_t i = 0; i < monitors.size(); i++) {
+		const MonitorHealth &health = monitors[i];
+		Napi::Object entry = Napi::Object::New(env);
+		entry.Set("id", Napi::String::New(env, health.monitorId));
+		entry.Set("state", Napi::String::New(env, states[static_cast<int>(health.state)]));
+		entry.Set("consecutiveFailures", Napi::Number::New(env, health.consecutiveFailures));
+		entry.Set("successes", Napi::Number::New(env, static_cast<double>(health.successes)));
+		entry.Set("failures", Napi::Number::New(env, static_cast<double>(health.failures)));
+		entry.Set("rejected", Napi::Number::New(env, static_cast<double>(health.rejected)));
+		entry.Set("lastLatency", Napi::Number::New(env, health.lastLatency.count() / 1000.0));
+		entry.Set("averageLatency", Napi::Number::New(env, health.averageLatency.count() / 1000.0));
+		entry.Set("retryIn", Napi::Number::New(env, static_cast<double>(health.retryIn.count())));
+		result.Set(static_cast<uint32_t>(i), entry);
+	}
+
+	return result;
+}
+
+Napi::Value GetIdentityCollisions(const Napi::CallbackInfo &info) {
+	Napi::Env env = info.Env();
+	std::vector<IdentityCollision> collisions = GetMonitorService().GetIdentityCollisions();
+	Napi::Array result = Napi::Array::New(env, collisions.size());
+
+	for (size_t i = 0; i < collisions.size(); i++) {
+		const IdentityCollision &collision = collisions[i];
+		Napi::Array monitorIds = Napi::Array::New(env, collision.monitorIds.size());
+		for (size_t j = 0; j < collision.monitorIds.size(); j++) monitorIds.Set(static_cast<uint32_t>(j), ToNapiString(env, collision.monitorIds[j]));
+
+		Napi::Object entry = Napi::Object::New(env);
+		entry.Set("displayId", ToNapiString(env, std::to_string(collision.displayId)));
+		entry.Set("monitorIds", monitorIds);
+		entry.Set("identical", Napi::Boolean::New(env, collision.identical));
+		result.Set(static_cast<uint32_t>(i), entry);
+	}
+
+	return result;
+}
+
+Napi::Value GetHandle(const Napi::CallbackInfo &info) {
+	Napi::Env env = info.Env();
+	if (!info[0].IsString()) return env.Null();
+
+	std::uint32_t handle = GetMonitorService().GetHandle(info[0].As<Napi::String>().Utf8Value());
+	return handle != 0 ? Napi::Number::New(env, handle) : env.Null();
+}
+
+Napi::Value GetPrimaryMonitor(const Napi::CallbackInfo &info) {
+	Monitor monitor;
+	if (!GetMonitorService().GetPrimaryMonitor(monitor)) return info.Env().Null();
+	return GetMonitorsRequest::ToObject(info.Env(), monitor);
+}
+
+Napi::Value Refresh(const Napi::CallbackInfo &info) {
+	GetMonitorService().Refresh();
+	return info.Env().Undefined();
+}
+
+Napi::Value Configure(const Napi::CallbackInfo &info) {
+	Napi::Env env = info.Env();
+	if (!info[0].IsObject()) return env.Undefined();
+
+	Napi::Object options = info[0].As<Napi::Object>();
+	MonitorService &service = GetMonitorService();
+
+	if (options.Get("cacheMaxAge").IsNumber()) {
+		int64_t cacheMaxAge = options.Get("cacheMaxAge").As<Napi::Number>().Int64Value();
+		service.SetCacheMaxAge(std::chrono::milliseconds(std::max<int64_t>(cacheMaxAge, 0)));
+	}
+
+	if (options.Get("minPollInterval").IsNumber() || options.Get("maxPollInterval").IsNumber()) {
+		int64_t minimum = options.Get("minPollInterval").IsNumber() ? options.Get("minPollInterval").As<Napi::Number>().Int64Value() : 2000;
+		int64_t maximum = options.Get("maxPollInterval").IsNumber() ? options.Get("maxPollInterval").As<Napi::Number>().Int64Value() : 30000;
+		minimum = std::max<int64_t>(minimum, 100);
+		service.SetBrightnessPollIntervals(std::chrono::milliseconds(minimum), std::chrono::milliseconds(std::max(minimum, maximum)));
+	}
+
+	if (options.Get("backgroundShare").IsNumber()) service.SetBackgroundShare(options.Get("backgroundShare").As<Napi::Number>().DoubleValue());
+
+	if (options.Get("circuitBreaker").IsObject()) {
+		Napi::Object breaker = options.Get("circuitBreaker").As<Napi::Object>();
+		HealthPolicy policy;
+
+		if (breaker.Get("failureThreshold").IsNumber()) policy.failureThreshold = std::max(breaker.Get("failureThreshold").As<Napi::Number>().Int32Value(), 0);
+		if (breaker.Get("cooldown").IsNumber()) {
+			policy.cooldown = std::chrono::milliseconds(std::max<int64_t>(breaker.Get("cooldown").As<Napi::Number>().Int64Value(), 0));
+		}
+
+		service.SetHealthPolicy(policy);
+	}
+
+	if (options.Get("retry").IsObject()) {
+		Napi::Object retry = options.Get("retry").As<Napi::Object>();
+		RetryPolicy policy;
+		auto milliseconds = [&](const char *key, std::chrono::microseconds fallback) {
+			if (!retry.Get(key).IsNumber()) return fallback;
+			return std::chrono::microseconds(static_cast<int64_t>(std::max(retry.Get(key).As<Napi::Number>().DoubleValue(), 0.0) * 1000));
+		};
+
+		if (retry.Get("attempts").IsNumber()) policy.attempts = std::max(retry.Get("attempts").As<Napi::Number>().Int32Value(), 1);
+		policy.initialDelay = milliseconds("initialDelay", policy.initialDelay);
+		policy.maxDelay = std::max(milliseconds("maxDelay", policy.maxDelay), policy.initialDelay);
+		if (retry.Get("multiplier").IsNumber()) policy.multiplier = std::max(retry.Get("multiplier").As<Napi::Number>().DoubleValue(), 1.0);
+		if (retry.Get("jitter").IsNumber()) policy.jitter = std::clamp(retry.Get("jitter").As<Napi::Number>().DoubleValue(), 0.0, 1.0);
+		if (retry.Get("learn").IsBoolean()) policy.learn = retry.Get("learn").As<Napi::Boolean>().Value();
+
+		service.SetRetryPolicy(policy);
+	}
+
+	return env.Undefined();
+}
+
+Napi::Object Init(Napi::Env env, Napi::Object exports) {
+	Napi::HandleScope scope(env);
+
+	env.SetInstanceData(new CompletionQueue(env));
+
+	exports.Set(Napi::String::New(env, "GLOBAL"), Napi::String::New(env, ALL_MONITORS));
+
+	Napi::Object setStatus = Napi::Object::New(env);
+	setStatus.Set("OK", Napi::Number::New(env, static_cast<int>(SetStatus::Ok)));
+	setStatus.Set("COALESCED", Napi::Number::New(env, static_cast<int>(SetStatus::Coalesced)));
+	setStatus.Set("NOT_FOUND", Napi::Number::New(env, static_cast<int>(SetStatus::NotFound)));
+	setStatus.Set("WRITE_FAILED", Napi::Number::New(env, static_cast<int>(SetStatus::WriteFailed)));
+	setStatus.Set("UNAVAILABLE", Napi::Number::New(env, static_cast<int>(SetStatus::Unavailable)));
+	setStatus.Set("TIMED_OUT", Napi::Number::New(env, static_cast<int>(SetStatus::TimedOut)));
+	setStatus.Set("ABORTED", Napi::Number::New(env, static_cast<int>(SetStatus::Aborted)));
+	exports.Set(Napi::String::New(env, "SetStatus"), setStatus);
+
+	exports.Set(Napi::String::New(env, "get"), Napi::Function::New(env, GetBrightness));
+	exports.Set(Napi::String::New(env, "getAll"), Napi::Function::New(env, GetAllBrightness));
+	exports.Set(Napi::String::New(env, "getCached"), Napi::Function::New(env, GetCachedBrightness));
+	exports.Set(Napi::String::New(env, "set"), Napi::Function::New(env, SetBrightness));
+	exports.Set(Napi::String::New(env, "setMany"), Napi::Function::New(env, SetManyBrightnessRequest::Start));
+	exports.Set(Napi::String::New(env, "monitors"), Napi::Function::New(env, GetMonitors));
+	exports.Set(Napi::String::New(env, "monitorsAsync"), Napi::Function::New(env, GetMonitorsAsync));
+	exports.Set(Napi::String::New(env, "health"), Napi::Function::New(env, GetHealth));
+	exports.Set(Napi::String::New(env, "collisions"), Napi::Function::New(env, GetIdentityCollisions));
+	exports.Set(Napi::String::New(env, "handle"), Napi::Function::New(env, GetHandle));
+	exports.Set(Napi::String::New(env, "primary"), Napi::Function::New(env, GetPrimaryMonitor));
+	exports.Set(Napi::String::New(env, "discover"), Napi::Function::New(env, DiscoverMonitorsRequest::Start));
+	exports.Set(Napi::String::New(env, "watchTopology"), Napi::Function::New(env, WatchTopologyRequest::Start));
+	exports.Set(Napi::String::New(env, "unwatchTopology"), Napi::Function::New(env, WatchTopologyRequest::Stop));
+	exports.Set(Napi::String::New(env, "watchBrightness"), Napi::Function::New(env, WatchBrightnessRequest::Start));
+	exports.Set(Napi::String::New(env, "unwatchBrightness"), Napi::Function::New(env, WatchBrightnessRequest::Stop));
+	exports.Set(Napi::String::New(env, "refresh"), Napi::Function::New(env, Refresh));
+	exports.Set(Napi::String::New(env, "fade"), Napi::Function::New(env, FadeBrightnessRequest::Start));
+	exports.Set(Napi::String::New(env, "configure"), Napi::Function::New(env, Configure));
+
+	return exports;
+}
+
 NODE_API_MODULE(Lumi, Init);
\ No newline at end of file
@@ -0,0 +1,141 @@
+#ifndef IO_EXECUTOR_H
+#define IO_EXECUTOR_H
+
+#include "priority.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Runs blocking display I/O off the JS thread and off the libuv threadpool.
+// Tasks are posted to a named queue; each queue has its own thread, created on
+// first use, and runs its tasks one at a time. Queues are keyed by physical
+// bus, so monitors on different buses are driven in parallel while
+// transactions on one bus never overlap.
+//
+// A queue runs its highest priority task first, tasks of one priority in
+// order. Background tasks only get a share of the queue's time: after one
+// ran, the next waits long enough for the rest to stay free, so a sweep never
+// leaves interactive work behind more than the background task in progress.
+class IoExecutor {
+public:
+	typedef std::function<void()> Task;
+	typedef std::chrono::steady_clock Clock;
+
+private:
+	struct Queue {
+		std::thread thread;
+		std::condition_variable wake;
+		std::deque<Task> tasks[PRIORITY_COUNT];
+		// When the next background task may start.
+		Clock::time_point backgroundReady;
+	};
+
+	std::mutex mutex;
+	std::unordered_map<std::string, std::unique_ptr<Queue>> queues;
+	bool stopping = false;
+	double backgroundShare = 0.5;
+
+	void Run(Queue *queue) {
+		std::unique_lock<std::mutex> lock(mutex);
+		auto &background = queue->tasks[static_cast<size_t>(Priority::Background)];
+
+		while (true) {
+			std::deque<Task> *next = nullptr;
+
+			for (auto &tasks: queue->tasks) {
+				if (!tasks.empty()) {
+					next = &tasks;
+					break;
+				}
+			}
+
+			if (next == nullptr) {
+				// Pending work is finished before shutting down.
+				if (stopping) return;
+				queue->wake.wait(lock);
+				continue;
+			}
+
+			if (next == &background && !stopping && Clock::now() < queue->backgroundReady) {
+				queue->wake.wait_until(lock, queue->backgroundReady);
+				continue;
+			}
+
+			Task task = std::move(next->front());
+			next->pop_front();
+
+			lock.unlock();
+			auto started = Clock::now();
+			task();
+			auto finished = Clock::now();
+			lock.lock();
+
+			if (next == &background) {
+				double rest = (1 - backgroundShare) / backgroundShare;
+				queue->backgroundReady = finished + std::chrono::duration_cast<Clock::duration>((finished - started) * rest);
+			}
+		}
+	}
+
+public:
+	IoExecutor() = default;
+
+	IoExecutor(const IoExecutor &) = delete;
+	IoExecutor &operator=(const IoExecutor &) = delete;
+
+	~IoExecutor() {
+		std::unique_lock<std::mutex> lock(mutex);
+		stopping = true;
+
+		// Draining tasks may post to queues that do not exist yet, so keep
+		// joining until every queue thread has finished.
+		while (true) {
+			std::vector<Queue *> running;
+			for (auto &queue: queues) {
+				if (queue.second->thread.joinable()) running.push_back(queue.second.get());
+			}
+			if (running.empty()) return;
+
+			for (Queue *queue: running) queue->wake.notify_all();
+			lock.unlock();
+			for (Queue *queue: running) queue->thread.join();
+			lock.lock();
+		}
+	}
+
+	void Post(const std::string &key, Task task, Priority priority = Priority::Normal) {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto &queue = queues[key];
+
+		if (!queue) {
+			queue = std::make_unique<Queue>();
+			Queue *created = queue.get();
+			created->thread = std::thread([this, created]() { Run(created); });
+		}
+
+		queue->tasks[static_cast<size_t>(priority)].emplace_back(std::move(task));
+		queue->wake.notify_one();
+	}
+
+	// Fraction of each queue's time background tasks may take, in (0, 1]; 1
+	// does not limit them.
+	void SetBackgroundShare(double share) {
+		std::lock_guard<std::mutex> lock(mutex);
+		backgroundShare = std::clamp(share, 0.01, 1.0);
+	}
+
+	size_t GetQueueCount() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return queues.size();
+	}
+};
+
+#endif// IO_EXECUTOR_H
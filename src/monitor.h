@@ -0,0 +1,190 @@
+#ifndef MONITOR_H
+#define MONITOR_H
+
+#include "priority.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+class Cancellation;
+
+const std::string ALL_MONITORS = "GLOBAL";
+
+struct Size {
+	int width = 0;
+	int height = 0;
+};
+
+struct Position {
+	int x = 0;
+	int y = 0;
+};
+
+struct MonitorRef {
+	std::string id;
+	// Assigned by the engine from the monitor's identity; see monitor_identity.h.
+	std::uint64_t displayId = 0;
+	std::string name;
+	// Where the monitor is attached (e.g. a DRM connector or the Windows
+	// monitor device path). Stable across enumerations; empty means the id is.
+	std::string connector;
+	// The OS primary display. Platforms without the notion set it nowhere and
+	// the first enumerated monitor is used.
+	bool primary = false;
+	Size size;
+	Position position;
+	void *handle = nullptr;
+	// Physical link shared with other monitors (e.g. an i2c bus). Operations on
+	// one bus are serialized; empty means the monitor has its own.
+	std::string bus;
+	// Index of the backend that produced this ref when several are combined.
+	size_t source = 0;
+};
+
+struct Monitor {
+	std::string id;
+	std::uint64_t displayId = 0;
+	std::string name;
+	std::string manufacturer;
+	std::string serialNumber;
+	std::string productCode;
+	Size size;
+	Position position;
+	void *handle = nullptr;
+	bool internal = false;
+};
+
+// What a probe found out about a monitor. The range is the raw range reported
+// by the hardware; lumi always exposes brightness as 0-100.
+struct MonitorCapabilities {
+	bool brightness = false;
+	int minBrightness = 0;
+	int maxBrightness = 0;
+};
+
+// One step of discover(). A monitor is first reported with what enumeration
+// alone knows, then again once the slower details and the probe came in.
+struct DiscoveryEvent {
+	enum class Kind {
+		// Id, name and geometry; the remaining fields may still be empty.
+		Identity,
+		// Manufacturer, serial number, displayId and the internal flag are
+		// filled in.
+		Details,
+		// The probe finished; brightness is -1 if it could not be read.
+		Capabilities
+	};
+
+	Kind kind = Kind::Identity;
+	Monitor monitor;
+	MonitorCapabilities capabilities;
+	int brightness = -1;
+
+	DiscoveryEvent(Kind kind, Monitor monitor) : kind(kind), monitor(std::move(monitor)) {}
+};
+
+// What changed between two enumerations. Changed monitors kept their id but
+// differ in name, geometry or any other reported field.
+struct TopologyChange {
+	std::vector<Monitor> added;
+	std::vector<Monitor> removed;
+	std::vector<Monitor> changed;
+
+	bool Empty() const {
+		return added.empty() && removed.empty() && changed.empty();
+	}
+};
+
+// A brightness change made outside lumi (hardware keys, the OS, other
+// programs). source tells how it was noticed: "notification" when the system
+// reported it, "poll" when a periodic read found it.
+struct BrightnessChange {
+	std::string monitorId;
+	int brightness = -1;
+	std::string source;
+};
+
+struct MonitorBrightnessConfiguration {
+	std::string monitorId;
+	int brightness;
+};
+
+struct GetBrightnessOptions {
+	// Read the hardware even if a cached value is still valid.
+	bool fresh = false;
+	// Deadline and abort of the request; none if null.
+	std::shared_ptr<Cancellation> cancellation;
+	Priority priority = Priority::Normal;
+
+	GetBrightnessOptions(bool fresh = false, std::shared_ptr<Cancellation> cancellation = nullptr)
+	    : fresh(fresh), cancellation(std::move(cancellation)) {}
+};
+
+struct SetBrightnessOptions {
+	// Collapse pending writes to the same monitor to the newest value.
+	bool coalesce = false;
+	std::shared_ptr<Cancellation> cancellation;
+	Priority priority = Priority::Normal;
+
+	SetBrightnessOptions(bool coalesce = false, std::shared_ptr<Cancellation> cancellation = nullptr)
+	    : coalesce(coalesce), cancellation(std::move(cancellation)) {}
+};
+
+// Outcome of a read for one monitor of getAll().
+struct MonitorGetResult {
+	std::string monitorId;
+	int brightness = -1;
+	// Machine readable reason when brightness is -1: READ_FAILED, NOT_FOUND,
+	// UNAVAILABLE when the monitor's circuit is open, or TIMEOUT or ABORTED
+	// when the request was cancelled first.
+	std::string error;
+};
+
+struct GetAllBrightnessResult {
+	std::vector<MonitorGetResult> monitors;
+	// TIMEOUT or ABORTED if the request was cancelled before every monitor
+	// was read; monitors is empty then.
+	std::string error;
+};
+
+// Outcome of a set() for one of the targeted monitors.
+struct MonitorSetResult {
+	std::string monitorId;
+	bool success = false;
+	bool coalesced = false;
+	// Machine readable reason when success is false: NOT_FOUND, WRITE_FAILED
+	// or UNAVAILABLE (circuit open).
+	std::string error;
+};
+
+// Per-monitor outcome of setMany(), one byte each in its status buffer.
+enum class SetStatus : std::uint8_t {
+	Ok = 0,
+	// Superseded by a newer write to the same monitor; see MonitorSetResult.
+	Coalesced = 1,
+	NotFound = 2,
+	WriteFailed = 3,
+	// Not attempted because the monitor's circuit is open.
+	Unavailable = 4,
+	// The request's deadline passed or it was aborted before the write
+	// finished.
+	TimedOut = 5,
+	Aborted = 6
+};
+
+struct SetBrightnessResult {
+	bool success = false;
+	// Every write in the request was superseded by a newer one before it
+	// reached the monitor.
+	bool coalesced = false;
+	std::string message;
+	// TIMEOUT or ABORTED if the request was cancelled before every write
+	// finished.
+	std::string error;
+	std::vector<MonitorSetResult> monitors;
+};
+
+#endif// MONITOR_H
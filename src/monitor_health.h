@@ -0,0 +1,189 @@
+#ifndef MONITOR_HEALTH_H
+#define MONITOR_HEALTH_H
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+enum class CircuitState : std::uint8_t {
+	// Operations reach the monitor.
+	Closed,
+	// The monitor kept failing; operations fail right away until the cooldown
+	// has passed.
+	Open,
+	// One operation is probing whether the monitor recovered.
+	HalfOpen
+};
+
+struct HealthPolicy {
+	// Consecutive failed operations that open a monitor's circuit; 0 never
+	// opens it.
+	int failureThreshold = 3;
+	// How long an open circuit rejects operations before letting a probe
+	// through.
+	std::chrono::milliseconds cooldown{5000};
+};
+
+// What lumi.health() reports for one monitor.
+struct MonitorHealth {
+	std::string monitorId;
+	CircuitState state = CircuitState::Closed;
+	int consecutiveFailures = 0;
+	std::uint64_t successes = 0;
+	std::uint64_t failures = 0;
+	// Operations failed without touching the monitor while the circuit was
+	// open.
+	std::uint64_t rejected = 0;
+	std::chrono::microseconds lastLatency{0};
+	// Moving average over recent operations.
+	std::chrono::microseconds averageLatency{0};
+	// Time left until an open circuit lets a probe through.
+	std::chrono::milliseconds retryIn{0};
+};
+
+// A circuit breaker per monitor. Every hardware operation (after the backend's
+// own retries) is recorded; enough consecutive failures open the monitor's
+// circuit, so a display in standby or with a lost DDC/CI channel fails fast
+// instead of holding its bus, and a global set, for the full retry budget.
+// Once the cooldown has passed a single operation goes through as a probe:
+// success closes the circuit, failure opens it for another cooldown.
+class HealthTracker {
+public:
+	typedef std::chrono::steady_clock Clock;
+
+private:
+	struct Entry {
+		CircuitState state = CircuitState::Closed;
+		int consecutiveFailures = 0;
+		std::uint64_t successes = 0;
+		std::uint64_t failures = 0;
+		std::uint64_t rejected = 0;
+		Clock::duration lastLatency{0};
+		Clock::duration averageLatency{0};
+		Clock::time_point opened;
+	};
+
+	mutable std::mutex mutex;
+	std::unordered_map<std::string, Entry> entries;
+	HealthPolicy policy;
+
+	bool Expired(const Entry &entry) const {
+		return Clock::now() - entry.opened >= policy.cooldown;
+	}
+
+public:
+	explicit HealthTracker(const HealthPolicy &policy = {}) : policy(policy) {}
+
+	// Takes effect for the next failures; a threshold of 0 also closes every
+	// open circuit.
+	void SetPolicy(const HealthPolicy &value) {
+		std::lock_guard<std::mutex> lock(mutex);
+		policy = value;
+		if (policy.failureThreshold > 0) return;
+		for (auto &entry: entries) entry.second.state = CircuitState::Closed;
+	}
+
+	HealthPolicy GetPolicy() const {
+		std::lock_guard<std::mutex> lock(mutex);
+		return policy;
+	}
+
+	// Whether an operation on id may be queued: false while its circuit is
+	// open and cooling down or a probe is already in flight. Counts the
+	// rejection.
+	bool Admits(const std::string &id) {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = entries.find(id);
+		if (it == entries.end()) return true;
+
+		Entry &entry = it->second;
+		bool admitted = entry.state == CircuitState::Closed || (entry.state == CircuitState::Open && Expired(entry));
+		if (!admitted) entry.rejected++;
+		return admitted;
+	}
+
+	// Called right before the hardware is touched. The first operation after
+	// the cooldown becomes the probe; everything else is rejected (and
+	// counted) while the circuit is not closed. Every admitted operation must
+	// be followed by Record or Abandon.
+	bool Begin(const std::string &id) {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = entries.find(id);
+		if (it == entries.end() || it->second.state == CircuitState::Closed) return true;
+
+		Entry &entry = it->second;
+		if (entry.state == CircuitState::Open && Expired(entry)) {
+			entry.state = CircuitState::HalfOpen;
+			return true;
+		}
+
+		entry.rejected++;
+		return false;
+	}
+
+	void Record(const std::string &id, bool success, Clock::duration latency) {
+		std::lock_guard<std::mutex> lock(mutex);
+		Entry &entry = entries[id];
+
+		entry.lastLatency = latency;
+		entry.averageLatency = entry.successes + entry.failures == 0 ? latency : entry.averageLatency + (latency - entry.averageLatency) / 8;
+
+		if (success) {
+			entry.successes++;
+			entry.consecutiveFailures = 0;
+			entry.state = CircuitState::Closed;
+			return;
+		}
+
+		entry.failures++;
+		entry.consecutiveFailures++;
+
+		if (policy.failureThreshold <= 0) return;
+		if (entry.state == CircuitState::HalfOpen || entry.consecutiveFailures >= policy.failureThreshold) {
+			entry.state = CircuitState::Open;
+			entry.opened = Clock::now();
+		}
+	}
+
+	// Ends an operation admitted by Begin without an outcome, e.g. one whose
+	// request was cancelled part way: nothing is counted, and an interrupted
+	// probe lets the next operation probe again.
+	void Abandon(const std::string &id) {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = entries.find(id);
+		if (it != entries.end() && it->second.state == CircuitState::HalfOpen) it->second.state = CircuitState::Open;
+	}
+
+	MonitorHealth Get(const std::string &id) const {
+		std::lock_guard<std::mutex> lock(mutex);
+		MonitorHealth health;
+		health.monitorId = id;
+
+		auto it = entries.find(id);
+		if (it == entries.end()) return health;
+
+		const Entry &entry = it->second;
+		health.state = entry.state;
+		health.consecutiveFailures = entry.consecutiveFailures;
+		health.successes = entry.successes;
+		health.failures = entry.failures;
+		health.rejected = entry.rejected;
+		health.lastLatency = std::chrono::duration_cast<std::chrono::microseconds>(entry.lastLatency);
+		health.averageLatency = std::chrono::duration_cast<std::chrono::microseconds>(entry.averageLatency);
+
+		if (entry.state == CircuitState::Open && !Expired(entry)) {
+			health.retryIn = std::chrono::duration_cast<std::chrono::milliseconds>(entry.opened + policy.cooldown - Clock::now());
+		}
+
+		return health;
+	}
+
+	void Clear() {
+		std::lock_guard<std::mutex> lock(mutex);
+		entries.clear();
+	}
+};
+
+#endif// MONITOR_HEALTH_H
@@ -0,0 +1,140 @@
+#ifndef MONITOR_IDENTITY_H
+#define MONITOR_IDENTITY_H
+
+#include "monitor.h"
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// 64-bit MurmurHash2 (MurmurHash64A). Ids derived from it are persisted by
+// callers, so it must not change between versions.
+inline std::uint64_t Hash64(const void *data, size_t length, std::uint64_t seed = 0) {
+	const std::uint64_t m = 0xc6a4a7935bd1e995ULL;
+	const int r = 47;
+	const auto *bytes = static_cast<const unsigned char *>(data);
+	std::uint64_t h = seed ^ (length * m);
+
+	for (size_t i = 0; i + 8 <= length; i += 8) {
+		std::uint64_t k;
+		std::memcpy(&k, bytes + i, 8);
+		k *= m;
+		k ^= k >> r;
+		k *= m;
+		h ^= k;
+		h *= m;
+	}
+
+	const unsigned char *tail = bytes + (length & ~static_cast<size_t>(7));
+	switch (length & 7) {
+		case 7: h ^= static_cast<std::uint64_t>(tail[6]) << 48; [[fallthrough]];
+		case 6: h ^= static_cast<std::uint64_t>(tail[5]) << 40; [[fallthrough]];
+		case 5: h ^= static_cast<std::uint64_t>(tail[4]) << 32; [[fallthrough]];
+		case 4: h ^= static_cast<std::uint64_t>(tail[3]) << 24; [[fallthrough]];
+		case 3: h ^= static_cast<std::uint64_t>(tail[2]) << 16; [[fallthrough]];
+		case 2: h ^= static_cast<std::uint64_t>(tail[1]) << 8; [[fallthrough]];
+		case 1:
+			h ^= static_cast<std::uint64_t>(tail[0]);
+			h *= m;
+	}
+
+	h ^= h >> r;
+	h *= m;
+	h ^= h >> r;
+
+	return h;
+}
+
+// Two monitors that ended up with the same identity. Identical means they
+// report the same EDID identity on the same connector, which only a broken
+// EDID or backend produces; otherwise two different identities hashed alike.
+// Either way every monitor still gets a distinct displayId, but the later
+// ones are not stable across enumerations.
+struct IdentityCollision {
+	std::uint64_t displayId = 0;
+	std::vector<std::string> monitorIds;
+	bool identical = false;
+};
+
+// Derives each monitor's displayId from its EDID identity (manufacturer,
+// product code and serial number), which follows the monitor from port to
+// port. The connector is mixed in when the serial is missing or shared with
+// another connected monitor, so identical panels stay apart. monitors and
+// refs are matched by id; a ref without a monitor (the backend could not
+// describe it) is identified by its connector alone, like a monitor without
+// an EDID identity. index receives displayId -> ref position.
+inline std::vector<IdentityCollision> AssignIdentities(std::vector<MonitorRef> &refs, std::vector<Monitor> &monitors,
+                                                       std::unordered_map<std::uint64_t, size_t> &index) {
+	const char separator = '\x1f';
+	std::unordered_map<std::string, size_t> refPositions;
+	std::vector<std::string> keys(monitors.size());
+	std::vector<bool> connected(monitors.size());
+	std::unordered_map<std::string, size_t> uses;
+	std::vector<IdentityCollision> collisions;
+
+	for (size_t i = 0; i < refs.size(); i++) refPositions.emplace(refs[i].id, i);
+
+	auto connectorOf = [&](const Monitor &monitor) -> const std::string & {
+		auto it = refPositions.find(monitor.id);
+		return it != refPositions.end() && !refs[it->second].connector.empty() ? refs[it->second].connector : monitor.id;
+	};
+
+	for (size_t i = 0; i < monitors.size(); i++) {
+		const Monitor &monitor = monitors[i];
+		keys[i] = monitor.manufacturer + separator + monitor.productCode + separator + monitor.serialNumber;
+		connected[i] = monitor.serialNumber.empty() || monitor.serialNumber == "0";
+		if (connected[i]) keys[i] += separator + connectorOf(monitor);
+		uses[keys[i]]++;
+	}
+
+	for (size_t i = 0; i < monitors.size(); i++) {
+		if (!connected[i] && uses[keys[i]] > 1) keys[i] += separator + connectorOf(monitors[i]);
+	}
+
+	// The monitor (by id) that first took each displayId.
+	std::unordered_map<std::uint64_t, std::pair<std::string, std::string>> owners;
+	std::vector<bool> assigned(refs.size());
+	index.clear();
+
+	auto assign = [&](const std::string &key, const std::string &monitorId) {
+		std::uint64_t seed = 0;
+		std::uint64_t id = Hash64(key.data(), key.size());
+
+		// Zero means unassigned, so it is never handed out.
+		while (id == 0 || owners.count(id) != 0) {
+			if (id != 0) {
+				const auto &owner = owners[id];
+				IdentityCollision collision;
+				collision.displayId = id;
+				collision.monitorIds = {owner.first, monitorId};
+				collision.identical = owner.second == key;
+				collisions.push_back(collision);
+			}
+			id = Hash64(key.data(), key.size(), ++seed);
+		}
+
+		owners.emplace(id, std::make_pair(monitorId, key));
+
+		auto ref = refPositions.find(monitorId);
+		if (ref != refPositions.end()) {
+			refs[ref->second].displayId = id;
+			assigned[ref->second] = true;
+			index.emplace(id, ref->second);
+		}
+		return id;
+	};
+
+	for (size_t i = 0; i < monitors.size(); i++) monitors[i].displayId = assign(keys[i], monitors[i].id);
+
+	for (size_t i = 0; i < refs.size(); i++) {
+		if (assigned[i]) continue;
+		const std::string &connector = refs[i].connector.empty() ? refs[i].id : refs[i].connector;
+		assign(std::string(3, separator) + connector, refs[i].id);
+	}
+
+	return collisions;
+}
+
+#endif// MONITOR_IDENTITY_H
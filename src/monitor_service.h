@@ -1,507 +1,1112 @@
-#ifndef MONITOR_SERVICE_H
-#define MONITOR_SERVICE_H
-
-#include "wmi_client.h"
-#include <algorithm>
-#include <execution>
-#include <highlevelmonitorconfigurationapi.h>
-#include <physicalmonitorenumerationapi.h>
-#include <string>
-#include <thread>
-#include <tuple>
-#include <unordered_map>
-#include <vector>
-#include <windows.h>
-#include "hash.h"
-#include "utils.h"
-#include "display_config_helper.h"
-#include <iostream>
-#include <format>
-
-const std::string ALL_MONITORS = "GLOBAL";
-
-struct Size {
-	int width;
-	int height;
-};
-
-struct Position {
-	int x;
-	int y;
-};
-
-struct MonitorRef {
-	std::string id;
-	std::int64_t displayId;
-	std::string name;
-	Size size;
-	Position position;
-	HANDLE handle;
-};
-
-struct Monitor {
-	std::string id;
-	std::int64_t displayId;
-	std::string name;
-	std::string manufacturer;
-	std::string serialNumber;
-	std::string productCode;
-	Size size;
-	Position position;
-	HANDLE handle;
-	bool internal;
-};
-
-struct MonitorBrightnessConfiguration {
-	std::string monitorId;
-	int brightness;
-};
-
-class MonitorService {
-private:
-	WmiClient *client;
-
-	std::string DeriveDisplayIdentifier(const std::string &displayDeviceString, const int occurrence) {
-		std::vector<std::string> parts = SplitString(displayDeviceString, '#');
-		return "DISPLAY\\" + parts[1] + "\\" + parts[2] + "_" + std::to_string(occurrence);
-	}
-
-	std::tuple<std::string, std::string> GetDeviceInfoFromPath(DISPLAYCONFIG_PATH_INFO path) {
-		DISPLAYCONFIG_TARGET_DEVICE_NAME deviceName = {};
-		deviceName.header.type = DISPLAYCONFIG_DEVICE_INFO_GET_TARGET_NAME;
-		deviceName.header.size = sizeof(DISPLAYCONFIG_TARGET_DEVICE_NAME);
-		deviceName.header.adapterId = path.targetInfo.adapterId;
-		deviceName.header.id = path.targetInfo.id;
-
-		LONG result = DisplayConfigGetDeviceInfo((DISPLAYCONFIG_DEVICE_INFO_HEADER *) &deviceName);
-
-		if (result == ERROR_SUCCESS) {
-			return {ToUTF8(WideStringFromArray(deviceName.monitorDevicePath)), ToUTF8(WideStringFromArray(deviceName.monitorFriendlyDeviceName))};
-		}
-
-		return {"Unknown", "Unknown"};
-	}
-
-	std::string GetGDIDeviceNameFromPath(DISPLAYCONFIG_PATH_INFO path) {
-		DISPLAYCONFIG_SOURCE_DEVICE_NAME sourceName = {};
-		sourceName.header.type = DISPLAYCONFIG_DEVICE_INFO_GET_SOURCE_NAME;
-		sourceName.header.size = sizeof(DISPLAYCONFIG_SOURCE_DEVICE_NAME);
-		sourceName.header.adapterId = path.targetInfo.adapterId;
-		sourceName.header.id = path.sourceInfo.id;
-
-		LONG result = DisplayConfigGetDeviceInfo((DISPLAYCONFIG_DEVICE_INFO_HEADER *) &sourceName);
-
-		if (result == ERROR_SUCCESS) {
-			return ToUTF8(WideStringFromArray(sourceName.viewGdiDeviceName));
-		}
-
-		return "Unknown";
-	}
-
-	BOOL AttemptToGetMonitorBrightness(const HANDLE &monitorHandle, DWORD &minBrightness, DWORD &currentBrightness,
-	                                   DWORD &maxBrightness, int maxRetries = 10) {
-		BOOL success = false;
-		int tries = 0;
-
-		while (!success && tries < maxRetries) {
-			success = HighLevelMonitorConfigurationAPI_h::GetMonitorBrightness(monitorHandle, &minBrightness, &currentBrightness, &maxBrightness);
-			tries = tries + 1;
-		}
-
-		return success;
-	}
-
-	BOOL AttemptToSetMonitorBrightness(const HANDLE &monitorHandle, int brightness, int maxRetries = 10) {
-		BOOL success = false;
-		int tries = 0;
-
-		while (!success && tries < maxRetries) {
-			success = HighLevelMonitorConfigurationAPI_h::SetMonitorBrightness(monitorHandle, static_cast<DWORD>(brightness));
-			tries = tries + 1;
-		}
-
-		return success;
-	}
-
-	bool IsMonitorInternal(const std::string &instanceName) {
-		IEnumWbemClassObject *enumerator = nullptr;
-		HRESULT hres = client->execQuery("SELECT * FROM WmiMonitorConnectionParams WHERE InstanceName='" +
-		                                         instanceName + "'",
-		                                 &enumerator);
-
-		if (FAILED(hres)) {
-			std::cout << "Failed to execute WMI query. Error code = 0x" << std::hex << hres << std::endl;
-			return false;
-		}
-
-		IWbemClassObject *wmiObject = nullptr;
-		ULONG numReturned = 0;
-
-		while (enumerator->Next(WBEM_INFINITE, 1, &wmiObject, &numReturned) == S_OK && numReturned > 0) {
-			VARIANT videoOutputTechVariant;
-			VariantInit(&videoOutputTechVariant);
-
-			hres = wmiObject->Get(L"VideoOutputTechnology", 0, &videoOutputTechVariant, nullptr, nullptr);
-
-			if (SUCCEEDED(hres)) {
-				wmiObject->Release();
-				enumerator->Release();
-				bool internal = (videoOutputTechVariant.intVal == 11);
-				VariantClear(&videoOutputTechVariant);
-				return internal;
-			}
-
-			VariantClear(&videoOutputTechVariant);
-			wmiObject->Release();
-		}
-
-		enumerator->Release();
-
-		return false;
-	}
-
-	int WMIGetMonitorBrightness(const std::string monitorId) {
-		IEnumWbemClassObject *pEnumerator = nullptr;
-
-		HRESULT hres = client->execQuery("SELECT * FROM WmiMonitorBrightness", &pEnumerator);
-
-		if (FAILED(hres)) return -1;
-
-		IWbemClassObject *pclsObj = nullptr;
-		ULONG uReturn = 0;
-
-		while (pEnumerator) {
-			hres = pEnumerator->Next(WBEM_INFINITE, 1, &pclsObj, &uReturn);
-			if (hres != S_OK) {
-				if (hres == WBEM_S_FALSE) {
-					break;
-				} else {
-					std::cout << "Failed to retrieve next object from enumerator. Error code = 0x"
-					          << std::hex << hres << std::endl;
-					break;
-				}
-			}
-
-			VARIANT instanceName;
-			pclsObj->Get(L"InstanceName", 0, &instanceName, nullptr, nullptr);
-
-			if (ToUTF8(instanceName.bstrVal) == monitorId) {
-				VARIANT currentBrightness;
-				int brightness = -1;
-
-				pclsObj->Get(L"CurrentBrightness", 0, &currentBrightness, nullptr, nullptr);
-
-				if (currentBrightness.vt == VT_UI1) {
-					brightness = currentBrightness.bVal;
-				}
-
-				VariantClear(&instanceName);
-				VariantClear(&currentBrightness);
-
-				pclsObj->Release();
-				pEnumerator->Release();
-				return brightness;
-			}
-
-			VariantClear(&instanceName);
-			pclsObj->Release();
-		}
-
-		pEnumerator->Release();
-
-		return -1;
-	}
-
-	BOOL WMISetMonitorBrightness(const std::string monitorId, const int brightness) {
-		BSTR *path = client->pathForInstance(monitorId, "WmiMonitorBrightnessMethods");
-
-		if (path == nullptr) return false;
-
-		IWbemClassObject *pClass = NULL;
-		HRESULT hres = client->getMethod("WmiMonitorBrightnessMethods", &pClass);
-
-		if (FAILED(hres)) return false;
-
-		IWbemClassObject *pInParamsDefinition = NULL;
-		hres = pClass->GetMethod(_bstr_t(L"WmiSetBrightness"), 0, &pInParamsDefinition, NULL);
-
-		if (FAILED(hres)) {
-			std::cout << "Failed to get WmiSetBrightness method." << std::endl;
-			return false;
-		}
-
-		IWbemClassObject *pClassInstance = NULL;
-		hres = pInParamsDefinition->SpawnInstance(0, &pClassInstance);
-
-		if (FAILED(hres)) {
-			std::cout << "Failed to spawn instance." << std::endl;
-			return false;
-		}
-
-		VARIANT timeoutVariant;
-		VariantInit(&timeoutVariant);
-		V_VT(&timeoutVariant) = VT_UI1;
-		V_UI1(&timeoutVariant) = 0;
-
-		hres = pClassInstance->Put(_bstr_t(L"Timeout"),
-		                           0,
-		                           &timeoutVariant,
-		                           CIM_UINT32);
-
-		if (FAILED(hres)) {
-			std::cout << "Failed to insert timeout value." << std::endl;
-			return false;
-		}
-
-		VARIANT brightnessVariant;
-		VariantInit(&brightnessVariant);
-		V_VT(&brightnessVariant) = VT_UI1;
-		V_UI1(&brightnessVariant) = brightness;
-
-		hres = pClassInstance->Put(_bstr_t(L"Brightness"),
-		                           0,
-		                           &brightnessVariant,
-		                           CIM_UINT8);
-
-		if (FAILED(hres)) {
-			std::cout << "Failed to add brightness value." << std::endl;
-			return false;
-		}
-
-		hres = client->execMethod(*path, "WmiSetBrightness", pClassInstance);
-
-		if (FAILED(hres)) {
-			std::cout << "Failed to execute WmiSetBrightness method." << std::endl;
-			return false;
-		}
-
-		VariantClear(&timeoutVariant);
-		VariantClear(&brightnessVariant);
-		pClassInstance->Release();
-		pClass->Release();
-
-		return true;
-	}
-
-	PHYSICAL_MONITOR GetPhysicalMonitorFromHMONITOR(HMONITOR hMonitor) {
-		PHYSICAL_MONITOR monitor = {};
-		DWORD monitorCount;
-
-		if (!GetNumberOfPhysicalMonitorsFromHMONITOR(hMonitor, &monitorCount)) return monitor;
-
-		if (monitorCount == 0) return monitor;
-
-		std::unique_ptr<PHYSICAL_MONITOR[]> monitors(new PHYSICAL_MONITOR[monitorCount]);
-
-		if (!GetPhysicalMonitorsFromHMONITOR(hMonitor, monitorCount, monitors.get())) return monitor;
-
-		return monitors[0];
-	}
-
-	std::vector<std::tuple<HANDLE, std::wstring, int64_t, int, int, int, int>> handles;
-
-	static BOOL CALLBACK MonitorEnumProcStatic(HMONITOR hMonitor, HDC hdcMonitor, LPRECT lprcMonitor, LPARAM dwData) {
-		MonitorService *monitorService = reinterpret_cast<MonitorService *>(dwData);
-		return monitorService->callback(hMonitor, hdcMonitor, lprcMonitor);
-	}
-
-	bool callback(HMONITOR hMonitor, HDC hdcMonitor, LPRECT lprcMonitor) {
-		PHYSICAL_MONITOR physicalMonitor = GetPhysicalMonitorFromHMONITOR(hMonitor);
-		MONITORINFOEXW info = {};
-		info.cbSize = sizeof(MONITORINFOEXW);
-		GetMonitorInfoW(hMonitor, &info);
-		auto [id, width, height, x, y] = GetMonitorInfoWithPosition(info.szDevice, hMonitor);
-		handles.emplace_back(static_cast<HANDLE>(physicalMonitor.hPhysicalMonitor), std::wstring(info.szDevice), id, width, height, x, y);
-		return TRUE;
-	}
-
-public:
-	std::tuple<int64_t, int, int, int, int> GetMonitorInfoWithPosition(const std::wstring& deviceName, HMONITOR hMonitor) {
-		DEVMODEW devMode = {};
-		devMode.dmSize = sizeof(DEVMODEW);
-		int width = 0, height = 0;
-
-		if (EnumDisplaySettingsW(deviceName.c_str(), ENUM_CURRENT_SETTINGS, &devMode)) {
-			width = devMode.dmPelsWidth;
-			height = devMode.dmPelsHeight;
-		}
-
-		MONITORINFOEX monitorInfo = {};
-		monitorInfo.cbSize = sizeof(MONITORINFOEX);
-		int x = 0, y = 0;
-		int64_t id = 0;
-
-		if (GetMonitorInfo(hMonitor, reinterpret_cast<MONITORINFO*>(&monitorInfo))) {
-			x = monitorInfo.rcMonitor.left;
-			y = monitorInfo.rcMonitor.top;
-			id = DisplayIdFromMonitorInfo(static_cast<const MONITORINFOEX&>(monitorInfo));
-		}
-
-		return {id, width, height, x, y};
-	}
-	
-std::int64_t DisplayIdFromMonitorInfo(const MONITORINFOEX& monitor) {
-  std::optional<DISPLAYCONFIG_PATH_INFO> config_path =
-      GetDisplayConfigPathInfo(static_cast<MONITORINFOEX>(monitor));
-
-  if (config_path.has_value()) {
-    return static_cast<int64_t>(PersistentHash(StringPrintf(
-        "%lu/%li/%u", config_path->targetInfo.adapterId.LowPart,
-        config_path->targetInfo.adapterId.HighPart,
-        config_path->targetInfo.id)));
-  }
-
-  return static_cast<int64_t>(PersistentHash(
-      WideToUTF8(FixedArrayToStringView(NarrowStringToWideString(monitor.szDevice).c_str()))));
-}
-
-	std::unordered_map<std::string, MonitorRef> GetMonitorRefs() {
-		UINT pathCount;
-		UINT modeCount;
-		if (GetDisplayConfigBufferSizes(QDC_ONLY_ACTIVE_PATHS, &pathCount, &modeCount))
-			return {};
-
-		std::vector<DISPLAYCONFIG_PATH_INFO> paths(pathCount);
-		std::vector<DISPLAYCONFIG_MODE_INFO> modes(modeCount);
-		if (QueryDisplayConfig(QDC_ONLY_ACTIVE_PATHS, &pathCount, paths.data(), &modeCount, modes.data(), nullptr))
-			return {};
-
-		EnumDisplayMonitors(
-		        nullptr,
-		        nullptr,
-		        &MonitorEnumProcStatic,
-		        reinterpret_cast<LPARAM>(this));
-
-		std::unordered_map<std::string, MonitorRef> monitors;
-		std::vector<std::string> monitorIdList;
-
-		for (UINT i = 0; i < pathCount; i++) {
-			std::tuple<std::string, std::string> info = GetDeviceInfoFromPath(paths[i]);
-			std::string GDIDeviceName = GetGDIDeviceNameFromPath(paths[i]);
-
-			auto target = std::find_if(handles.begin(), handles.end(), [&GDIDeviceName](const std::tuple<HANDLE, std::wstring, int64_t, int, int, int, int> &t) {
-				return (ToUTF8(std::get<1>(t)) == GDIDeviceName);
-			});
-
-			if (target != handles.end()) {
-				MonitorRef monitor;
-				int instance = CountOccurrence(monitorIdList, std::get<0>(info));
-				monitor.id = DeriveDisplayIdentifier(std::get<0>(info), instance);
-				monitor.displayId = std::get<2>(*target);
-				monitor.name = std::get<1>(info);
-				monitor.handle = std::get<0>(*target);
-				monitor.size.width = std::get<3>(*target);
-				monitor.size.height = std::get<4>(*target);
-				monitor.position.x = std::get<5>(*target);
-				monitor.position.y = std::get<6>(*target);
-				monitorIdList.emplace_back(std::get<0>(info));
-				monitors[monitor.id] = monitor;
-			}
-		}
-
-		return monitors;
-	}
-
-	std::vector<Monitor> GetAvailableMonitors() {
-		std::unordered_map<std::string, MonitorRef> refs = GetMonitorRefs();
-		std::vector<Monitor> monitors;
-		IEnumWbemClassObject *pEnumerator = NULL;
-
-		HRESULT hres = client->execQuery("SELECT * FROM WmiMonitorID", &pEnumerator);
-
-		if (FAILED(hres)) return {};
-
-		IWbemClassObject *pclsObj = NULL;
-		ULONG uReturn = 0;
-
-		while (pEnumerator) {
-			Monitor monitorInfo;
-
-			pEnumerator->Next(WBEM_INFINITE, 1, &pclsObj, &uReturn);
-
-			if (0 == uReturn) break;
-
-			VARIANT instanceNameVariant;
-			VARIANT manufacturerVariant;
-			VARIANT serialVariant;
-			VARIANT productCodeVariant;
-
-			pclsObj->Get(L"InstanceName", 0, &instanceNameVariant, 0, 0);
-			pclsObj->Get(L"ManufacturerName", 0, &manufacturerVariant, 0, 0);
-			pclsObj->Get(L"SerialNumberID", 0, &serialVariant, 0, 0);
-			pclsObj->Get(L"ProductCodeID", 0, &productCodeVariant, 0, 0);
-
-			std::string id = ToUTF8(instanceNameVariant.bstrVal);
-
-			monitorInfo.id = id;
-			monitorInfo.internal = IsMonitorInternal(monitorInfo.id);
-			monitorInfo.manufacturer = ConvertVariantToString(manufacturerVariant);
-			monitorInfo.serialNumber = ConvertVariantToString(serialVariant);
-			monitorInfo.productCode = ConvertVariantToString(productCodeVariant);
-
-			auto it = refs.find(id);
-
-			if (it != refs.end()) {
-				monitorInfo.name = monitorInfo.internal ? "Built-in" : it->second.name;
-				monitorInfo.displayId = it->second.displayId;
-				monitorInfo.handle = it->second.handle;
-				monitorInfo.size.width = it->second.size.width;
-				monitorInfo.size.height = it->second.size.height;
-				monitorInfo.position.x = it->second.position.x;
-				monitorInfo.position.y = it->second.position.y;
-			}
-
-			VariantClear(&instanceNameVariant);
-			VariantClear(&manufacturerVariant);
-			VariantClear(&serialVariant);
-			VariantClear(&productCodeVariant);
-
-			pclsObj->Release();
-			monitors.push_back(monitorInfo);
-		}
-
-		pEnumerator->Release();
-
-		return monitors;
-	}
-
-	int GetMonitorBrightness(const MonitorRef ref) {
-		DWORD minBrightness = 0;
-		DWORD currentBrightness = 0;
-		DWORD maxBrightness = 0;
-
-		if (AttemptToGetMonitorBrightness(ref.handle, minBrightness, currentBrightness, maxBrightness)) return static_cast<int>(currentBrightness);
-
-		return WMIGetMonitorBrightness(ref.id);
-	}
-
-	BOOL SetMonitorBrightness(const MonitorRef monitor, const int brightness) {
-		if (AttemptToSetMonitorBrightness(monitor.handle, brightness)) return true;
-		return WMISetMonitorBrightness(monitor.id, brightness);
-	}
-
-	BOOL SetGlobalBrightness(int brightness) {
-		std::unordered_map<std::string, MonitorRef> monitors = GetMonitorRefs();
-
-		std::for_each(
-		        std::execution::par_unseq,
-		        monitors.begin(),
-		        monitors.end(),
-		        [&](auto &&monitor) {
-			        SetMonitorBrightness(monitor.second, brightness);
-		        });
-
-		return true;
-	}
-
-	MonitorService() {
-		client = new WmiClient();
-	}
-
-	~MonitorService() {
-		delete client;
-		delete this;
-	}
-};
-
-#endif//MONITOR_SERVICE_H
+#ifndef MONITOR_SERVICE_H
+#define MONITOR_SERVICE_H
+
+#include "adaptive_poller.h"
+#include "backends/display_backend.h"
+#include "barrier.h"
+#include "brightness_cache.h"
+#include "cancellation.h"
+#include "fade_scheduler.h"
+#include "io_executor.h"
+#include "monitor.h"
+#include "monitor_health.h"
+#include "monitor_identity.h"
+#include "write_coalescer.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// An immutable view of the displays known to the engine. Callers hold on to the
+// snapshot for the duration of an operation, so a concurrent rebuild never
+// invalidates the refs (and native handles) they are using.
+struct Topology {
+	std::uint64_t stamp = 0;
+	std::vector<MonitorRef> refs;
+	std::vector<Monitor> monitors;
+	std::unordered_map<std::string, size_t> index;
+	// displayId -> position in refs.
+	std::unordered_map<std::uint64_t, size_t> identities;
+	std::vector<IdentityCollision> collisions;
+	// Position of the primary display in refs.
+	size_t primary = 0;
+	std::shared_ptr<DisplayBackend> backend;
+
+	const MonitorRef *Find(const std::string &id) const {
+		auto it = index.find(id);
+		return it != index.end() ? &refs[it->second] : nullptr;
+	}
+
+	const MonitorRef *Find(std::uint64_t displayId) const {
+		auto it = identities.find(displayId);
+		return it != identities.end() ? &refs[it->second] : nullptr;
+	}
+
+	const MonitorRef *Primary() const {
+		return refs.empty() ? nullptr : &refs[primary];
+	}
+
+	~Topology() {
+		if (backend) backend->ReleaseMonitorRefs(refs);
+	}
+};
+
+inline bool SameMonitor(const Monitor &a, const Monitor &b) {
+	return a.id == b.id && a.displayId == b.displayId && a.name == b.name && a.manufacturer == b.manufacturer &&
+	       a.serialNumber == b.serialNumber && a.productCode == b.productCode && a.size.width == b.size.width &&
+	       a.size.height == b.size.height && a.position.x == b.position.x && a.position.y == b.position.y && a.internal == b.internal;
+}
+
+inline TopologyChange DiffTopology(const Topology &previous, const Topology &current) {
+	TopologyChange change;
+	std::unordered_map<std::string, const Monitor *> known;
+
+	for (const auto &monitor: previous.monitors) known.emplace(monitor.id, &monitor);
+
+	for (const auto &monitor: current.monitors) {
+		auto it = known.find(monitor.id);
+		if (it == known.end()) {
+			change.added.push_back(monitor);
+			continue;
+		}
+		if (!SameMonitor(*it->second, monitor)) change.changed.push_back(monitor);
+		known.erase(it);
+	}
+
+	for (const auto &monitor: previous.monitors) {
+		if (known.count(monitor.id) != 0) change.removed.push_back(monitor);
+	}
+
+	return change;
+}
+
+class MonitorService {
+private:
+	std::shared_ptr<DisplayBackend> backend;
+	std::shared_ptr<const Topology> topology;
+	std::mutex topologyMutex;
+	bool stale = true;
+	// The last snapshot built, for lookups that must not wait for a rebuild
+	// (topologyMutex is held while one runs); dropped by Refresh().
+	std::shared_ptr<const Topology> latest;
+	std::mutex latestMutex;
+	WriteCoalescer coalescer;
+	BrightnessCache cache;
+	HealthTracker health;
+	DeadlineTimer deadlines;
+	// Topology subscribers, the snapshot they last heard about and the backend's
+	// watcher, which only runs while someone listens. Control queue only.
+	std::unordered_map<std::uint64_t, std::function<void(const TopologyChange &)>> topologyListeners;
+	std::atomic<std::uint64_t> nextListener{1};
+	std::shared_ptr<const Topology> published;
+	std::unique_ptr<DisplayWatcher> topologyWatcher;
+	// Brightness subscribers, the snapshot being watched, the backend's watcher
+	// for monitors that can push changes and the internal topology listener
+	// that restarts watching after display changes. Control queue only.
+	std::unordered_map<std::uint64_t, std::function<void(const BrightnessChange &)>> brightnessListeners;
+	std::shared_ptr<const Topology> watched;
+	std::unique_ptr<DisplayWatcher> brightnessWatcher;
+	std::uint64_t brightnessTopologyListener = 0;
+	// Handles given out by GetHandle(): handle n is handles[n - 1]. They follow
+	// the displayId across rebuilds and are never reused.
+	struct HandleEntry {
+		std::uint64_t displayId;
+		std::string monitorId;
+	};
+	std::mutex handleMutex;
+	std::vector<HandleEntry> handles;
+	std::unordered_map<std::uint64_t, std::uint32_t> handleIndex;
+	// Numbers set requests as they are made; the last number that went to
+	// each monitor and whether its write landed (see WriteInOrder).
+	struct LastWrite {
+		std::uint64_t sequence = 0;
+		bool written = true;
+	};
+	std::atomic<std::uint64_t> nextWrite{1};
+	std::mutex writeMutex;
+	std::unordered_map<std::string, LastWrite> lastWrites;
+	IoExecutor executor;
+	// Monitors that cannot push changes are polled; each poll is a read on the
+	// monitor's bus queue.
+	AdaptivePoller poller{
+	        [this](const std::string &id, AdaptivePoller::Done done) {
+		        executor.Post(CONTROL_QUEUE, [this, id, done]() { CheckBrightness(id, "poll", done); }, Priority::Background);
+	        },
+	        std::chrono::seconds(2), std::chrono::seconds(30)};
+	// Declared last: its threads write through this service until destroyed.
+	FadeScheduler fades{
+	        [this](const MonitorRef &ref) { return ReadFadeStart(ref); },
+	        [this](const MonitorRef &ref, int brightness) { return WriteFadeStep(ref, brightness); }};
+
+	// Resolves requests (and rebuilds the topology when needed) in order, off
+	// the JS thread; device I/O then goes to the queue of the monitor's bus.
+	static constexpr const char *CONTROL_QUEUE = "";
+	// Bulk reads through the backend (see GetBatchBrightness), which are not
+	// tied to one bus.
+	static constexpr const char *BATCH_QUEUE = "#batch";
+
+	static std::string QueueFor(const MonitorRef &ref) {
+		return ref.bus.empty() ? ref.id : ref.bus;
+	}
+
+	typedef std::function<void(const std::vector<MonitorRef> &)> RefsObserver;
+
+	static bool Cancelled(const std::shared_ptr<Cancellation> &cancellation) {
+		return cancellation && cancellation->IsCancelled();
+	}
+
+	// Makes done fire exactly once: with the result, or with what cancelled
+	// builds as soon as the request's deadline passes or it is aborted. Work
+	// still queued for a cancelled request is skipped before it reaches the
+	// bus; I/O already under way is bounded by the deadline where the backend
+	// allows (see CurrentCancellation) and its result dropped. Either way the
+	// deadline is taken off the timer.
+	template<typename Result>
+	std::function<void(Result)> Watch(const std::shared_ptr<Cancellation> &cancellation, std::function<void(Result)> done,
+	                                  std::function<Result(CancelReason)> cancelled) {
+		DeadlineTimer::Token token = deadlines.Schedule(cancellation);
+		if (token != 0) {
+			done = [this, token, done](Result result) {
+				deadlines.Unschedule(token);
+				done(std::move(result));
+			};
+		}
+
+		return Cancellable<Result>(cancellation, std::move(done), std::move(cancelled));
+	}
+
+
+	static Monitor MonitorFromRef(const MonitorRef &ref) {
+		Monitor monitor;
+		monitor.id = ref.id;
+		monitor.displayId = ref.displayId;
+		monitor.name = ref.name;
+		monitor.size = ref.size;
+		monitor.position = ref.position;
+		monitor.handle = ref.handle;
+		return monitor;
+	}
+
+	// onRefs, if set, sees the refs before the (slower) monitor details are
+	// queried.
+	std::shared_ptr<const Topology> BuildTopology(std::uint64_t stamp, const RefsObserver &onRefs) {
+		auto snapshot = std::make_shared<Topology>();
+		snapshot->stamp = stamp;
+
+		if (!backend) return snapshot;
+
+		snapshot->refs = backend->GetMonitorRefs();
+		snapshot->backend = backend;
+
+		for (size_t i = 0; i < snapshot->refs.size(); i++) {
+			snapshot->index.emplace(snapshot->refs[i].id, i);
+		}
+
+		auto primary = std::find_if(snapshot->refs.begin(), snapshot->refs.end(), [](const MonitorRef &ref) { return ref.primary; });
+		if (primary != snapshot->refs.end()) snapshot->primary = primary - snapshot->refs.begin();
+
+		if (onRefs) onRefs(snapshot->refs);
+
+		snapshot->monitors = backend->GetAvailableMonitors(snapshot->refs);
+		snapshot->collisions = AssignIdentities(snapshot->refs, snapshot->monitors, snapshot->identities);
+
+		return snapshot;
+	}
+
+	// (Re)starts watching the brightness of every monitor of the current
+	// topology: through the backend where it can push changes, by polling
+	// otherwise. Monitors without a known value are read once as a baseline.
+	// Stops watching once nobody listens. Control queue only.
+	void StartBrightnessWatch() {
+		brightnessWatcher.reset();
+		watched.reset();
+		poller.SetKeys({});
+
+		if (brightnessListeners.empty() || !backend) return;
+
+		watched = GetTopology();
+		std::vector<MonitorRef> pushed;
+		std::vector<std::string> polled;
+
+		for (const auto &ref: watched->refs) {
+			if (backend->CanWatchBrightness(ref)) pushed.push_back(ref);
+			else polled.push_back(ref.id);
+
+			int brightness;
+			if (!cache.Peek(ref.id, brightness)) CheckBrightness(ref.id, "poll", nullptr);
+		}
+
+		if (!pushed.empty()) {
+			brightnessWatcher = backend->WatchBrightness(pushed, [this](const std::string &id) {
+				executor.Post(CONTROL_QUEUE, [this, id]() { CheckBrightness(id, "notification", nullptr); });
+			});
+		}
+
+		poller.SetKeys(polled);
+	}
+
+	// Reads a watched monitor on its bus queue and reports the value if it
+	// differs from the last known one. Writes by lumi go through the same
+	// queue and update that value first, so they are not reported. Polls run
+	// as background work. Control queue only.
+	void CheckBrightness(const std::string &id, const std::string &source, AdaptivePoller::Done done) {
+		auto snapshot = watched;
+		const MonitorRef *ref = snapshot ? snapshot->Find(id) : nullptr;
+
+		if (ref == nullptr) {
+			if (done) done(false);
+			return;
+		}
+
+		Priority priority = source == "poll" ? Priority::Background : Priority::Normal;
+
+		executor.Post(QueueFor(*ref), [this, snapshot, ref, source, done]() {
+			int previous = -1;
+			bool known = cache.Peek(ref->id, previous);
+			int brightness = GetMonitorBrightness(*ref);
+			bool changed = known && brightness != -1 && brightness != previous;
+
+			if (done) done(changed);
+			if (!changed) return;
+
+			BrightnessChange change{ref->id, brightness, source};
+			executor.Post(CONTROL_QUEUE, [this, change]() {
+				for (const auto &listener: brightnessListeners) listener.second(change);
+			});
+		}, priority);
+	}
+
+	// Re-enumerates after a change notification and tells the listeners what
+	// changed. Runs on the control queue.
+	void PublishTopologyChange() {
+		if (topologyListeners.empty() || !published) return;
+
+		{
+			std::lock_guard<std::mutex> lock(topologyMutex);
+			stale = true;
+		}
+
+		auto current = GetTopology();
+		TopologyChange change = DiffTopology(*published, *current);
+		published = current;
+
+		for (const auto &monitor: change.removed) cache.Invalidate(monitor.id);
+		for (const auto &monitor: change.changed) cache.Invalidate(monitor.id);
+
+		if (change.Empty()) return;
+		for (const auto &listener: topologyListeners) listener.second(change);
+	}
+
+public:
+	explicit MonitorService(std::shared_ptr<DisplayBackend> backend) : backend(std::move(backend)) {}
+
+	MonitorService(const MonitorService &) = delete;
+	MonitorService &operator=(const MonitorService &) = delete;
+
+	~MonitorService() {
+		// The watchers post to the executor, so they have to stop first.
+		std::promise<void> stopped;
+		executor.Post(CONTROL_QUEUE, [this, &stopped]() {
+			topologyWatcher.reset();
+			brightnessWatcher.reset();
+			poller.SetKeys({});
+			stopped.set_value();
+		});
+		stopped.get_future().get();
+	}
+
+	// Returns the cached topology, rebuilding it only if it was invalidated or the
+	// backend reports a different display configuration. onRefs is only called
+	// when a rebuild happens.
+	std::shared_ptr<const Topology> GetTopology(const RefsObserver &onRefs = nullptr) {
+		std::uint64_t stamp = backend ? backend->GetTopologyStamp() : 0;
+		std::lock_guard<std::mutex> lock(topologyMutex);
+
+		if (stale || !topology || topology->stamp != stamp) {
+			topology = BuildTopology(stamp, onRefs);
+			stale = false;
+
+			std::lock_guard<std::mutex> latestLock(latestMutex);
+			latest = topology;
+		}
+
+		return topology;
+	}
+
+	// The last snapshot built, as is; null before the first one.
+	std::shared_ptr<const Topology> LatestTopology() {
+		std::lock_guard<std::mutex> lock(latestMutex);
+		return latest;
+	}
+
+	// The snapshot for synchronous calls on the JS thread: the last one built,
+	// never checked against the backend, so the call cannot end up
+	// enumerating or waiting for a rebuild. Only before the first snapshot
+	// exists, or after refresh() dropped it, is one built here.
+	std::shared_ptr<const Topology> SnapshotForCaller() {
+		auto snapshot = LatestTopology();
+		return snapshot ? snapshot : GetTopology();
+	}
+
+	void Refresh() {
+		std::lock_guard<std::mutex> lock(topologyMutex);
+		stale = true;
+		cache.Clear();
+		health.Clear();
+
+		std::lock_guard<std::mutex> latestLock(latestMutex);
+		latest.reset();
+	}
+
+	// Calls listener with the difference whenever the backend reports that
+	// displays were connected, disconnected or rearranged. Watching starts with
+	// the first listener and stops with the last; returns an id for
+	// UnwatchTopology.
+	std::uint64_t WatchTopology(std::function<void(const TopologyChange &)> listener) {
+		std::uint64_t id = nextListener++;
+
+		executor.Post(CONTROL_QUEUE, [this, id, listener]() {
+			if (topologyListeners.empty() && backend) {
+				published = GetTopology();
+				topologyWatcher = backend->WatchTopology([this]() {
+					executor.Post(CONTROL_QUEUE, [this]() { PublishTopologyChange(); });
+				});
+			}
+			topologyListeners.emplace(id, listener);
+		});
+
+		return id;
+	}
+
+	// Removes a listener; done is called once it can no longer be called.
+	void UnwatchTopology(std::uint64_t id, std::function<void()> done) {
+		executor.Post(CONTROL_QUEUE, [this, id, done]() {
+			topologyListeners.erase(id);
+			if (topologyListeners.empty()) {
+				topologyWatcher.reset();
+				published.reset();
+			}
+			if (done) done();
+		});
+	}
+
+	// Calls listener whenever a monitor's brightness changes outside lumi.
+	// Monitors that can push changes are watched, the others polled at an
+	// adaptive interval. Watching starts with the first listener and stops
+	// with the last; returns an id for UnwatchBrightness.
+	std::uint64_t WatchBrightness(std::function<void(const BrightnessChange &)> listener) {
+		std::uint64_t id = nextListener++;
+
+		executor.Post(CONTROL_QUEUE, [this, id, listener]() {
+			bool first = brightnessListeners.empty();
+			brightnessListeners.emplace(id, listener);
+			if (!first) return;
+
+			brightnessTopologyListener = WatchTopology([this](const TopologyChange &) { StartBrightnessWatch(); });
+			StartBrightnessWatch();
+		});
+
+		return id;
+	}
+
+	// Removes a listener; done is called once it can no longer be called.
+	void UnwatchBrightness(std::uint64_t id, std::function<void()> done) {
+		executor.Post(CONTROL_QUEUE, [this, id, done]() {
+			brightnessListeners.erase(id);
+			if (brightnessListeners.empty() && brightnessTopologyListener != 0) {
+				UnwatchTopology(brightnessTopologyListener, nullptr);
+				brightnessTopologyListener = 0;
+				StartBrightnessWatch();
+			}
+			if (done) done();
+		});
+	}
+
+	// Bounds of the adaptive polling interval used for monitors that cannot
+	// report brightness changes themselves.
+	void SetBrightnessPollIntervals(std::chrono::milliseconds minimum, std::chrono::milliseconds maximum) {
+		poller.SetIntervals(minimum, maximum);
+	}
+
+	// How long a read or written brightness value is served from the cache.
+	void SetCacheMaxAge(std::chrono::milliseconds maxAge) {
+		cache.SetMaxAge(maxAge);
+	}
+
+	// Fraction of each bus's time background operations (polls included) may
+	// take; see IoExecutor.
+	void SetBackgroundShare(double share) {
+		executor.SetBackgroundShare(share);
+	}
+
+	// When a monitor's circuit opens and how long it stays open.
+	void SetHealthPolicy(const HealthPolicy &policy) {
+		health.SetPolicy(policy);
+	}
+
+	// Circuit state, outcome counts and latency of every connected monitor.
+	std::vector<MonitorHealth> GetHealth() {
+		auto snapshot = SnapshotForCaller();
+		std::vector<MonitorHealth> result;
+		for (const auto &ref: snapshot->refs) result.push_back(health.Get(ref.id));
+		return result;
+	}
+
+	// How the backend retries failed monitor operations and whether it learns
+	// which way of reaching each monitor works.
+	void SetRetryPolicy(const RetryPolicy &policy) {
+		if (backend) backend->SetRetryPolicy(policy);
+	}
+
+	std::vector<Monitor> GetAvailableMonitors() {
+		return GetTopology()->monitors;
+	}
+
+	// Enumerates on the control queue, off the caller's thread.
+	void GetAvailableMonitors(std::function<void(std::vector<Monitor>)> done) {
+		executor.Post(CONTROL_QUEUE, [this, done]() { done(GetTopology()->monitors); });
+	}
+
+	// A small integer naming the monitor ("primary" allowed) in the handle
+	// forms of GetBrightness and SetBrightness, or 0 if there is no such
+	// monitor. The same monitor always gets the same handle; it keeps working
+	// across display changes for as long as the monitor is connected.
+	std::uint32_t GetHandle(const std::string &monitorId) {
+		auto snapshot = SnapshotForCaller();
+		const MonitorRef *ref = monitorId == "primary" ? snapshot->Primary() : snapshot->Find(monitorId);
+		if (ref == nullptr) return 0;
+
+		std::lock_guard<std::mutex> lock(handleMutex);
+		auto it = handleIndex.find(ref->displayId);
+		if (it != handleIndex.end()) return it->second;
+
+		handles.push_back({ref->displayId, ref->id});
+		auto handle = static_cast<std::uint32_t>(handles.size());
+		handleIndex.emplace(ref->displayId, handle);
+		return handle;
+	}
+
+	// The last brightness known for a monitor ("primary" and an empty id mean
+	// the primary monitor) and how old it is, without touching the hardware.
+	// Reads, writes and brightness watching all keep it current. The primary
+	// monitor and handles are looked up in the last snapshot built, which is
+	// never checked or rebuilt here. False if nothing is known.
+	bool GetCachedBrightness(const std::string &monitorId, int &brightness, std::chrono::milliseconds &age) {
+		BrightnessCache::Clock::duration elapsed;
+
+		if (monitorId.empty() || monitorId == "primary") {
+			auto snapshot = LatestTopology();
+			const MonitorRef *ref = snapshot ? snapshot->Primary() : nullptr;
+			if (ref == nullptr || !cache.Peek(ref->id, brightness, elapsed)) return false;
+		} else if (!cache.Peek(monitorId, brightness, elapsed)) {
+			return false;
+		}
+
+		age = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed);
+		return true;
+	}
+
+	// The same for a handle from GetHandle().
+	bool GetCachedBrightness(std::uint32_t handle, int &brightness, std::chrono::milliseconds &age) {
+		auto snapshot = LatestTopology();
+		const MonitorRef *ref = snapshot ? snapshot->Find(DisplayIdForHandle(handle)) : nullptr;
+		BrightnessCache::Clock::duration elapsed;
+
+		if (ref == nullptr || !cache.Peek(ref->id, brightness, elapsed)) return false;
+
+		age = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed);
+		return true;
+	}
+
+	// The OS primary display; false if there are no monitors.
+	bool GetPrimaryMonitor(Monitor &monitor) {
+		auto snapshot = SnapshotForCaller();
+		const MonitorRef *ref = snapshot->Primary();
+		if (ref == nullptr) return false;
+
+		for (const auto &candidate: snapshot->monitors) {
+			if (candidate.id == ref->id) {
+				monitor = candidate;
+				return true;
+			}
+		}
+
+		monitor = MonitorFromRef(*ref);
+		return true;
+	}
+
+	// Monitors of the current topology that could not be told apart by their
+	// identity; empty when every displayId is stable.
+	std::vector<IdentityCollision> GetIdentityCollisions() {
+		return SnapshotForCaller()->collisions;
+	}
+
+	// Deadlines of requests still in flight.
+	size_t GetPendingDeadlineCount() {
+		return deadlines.GetPendingCount();
+	}
+
+	// Streams the monitors as they become known. On a rebuild every monitor is
+	// reported as soon as enumeration found it and again with its details;
+	// with a current topology the details come right away. Each monitor is
+	// then probed on its bus queue, so one slow display does not hold back the
+	// others. done is called after the last event.
+	void Discover(std::function<void(const DiscoveryEvent &)> onEvent, std::function<void()> done) {
+		executor.Post(CONTROL_QUEUE, [this, onEvent, done]() {
+			bool rebuilt = false;
+			auto snapshot = GetTopology([&](const std::vector<MonitorRef> &refs) {
+				rebuilt = true;
+				for (const auto &ref: refs) onEvent({DiscoveryEvent::Kind::Identity, MonitorFromRef(ref)});
+			});
+
+			std::vector<std::pair<const MonitorRef *, Monitor>> probes;
+
+			for (const auto &monitor: snapshot->monitors) {
+				onEvent({rebuilt ? DiscoveryEvent::Kind::Details : DiscoveryEvent::Kind::Identity, monitor});
+				if (const MonitorRef *ref = snapshot->Find(monitor.id)) probes.emplace_back(ref, monitor);
+			}
+
+			if (probes.empty()) return done();
+
+			auto barrier = std::make_shared<Barrier<bool>>(std::vector<bool>(probes.size()), probes.size(), [done](std::vector<bool>) { done(); });
+
+			for (size_t i = 0; i < probes.size(); i++) {
+				const MonitorRef *ref = probes[i].first;
+				Monitor monitor = probes[i].second;
+
+				executor.Post(QueueFor(*ref), [this, snapshot, ref, monitor, onEvent, barrier, i]() {
+					DiscoveryEvent event{DiscoveryEvent::Kind::Capabilities, monitor};
+					event.capabilities = ProbeMonitor(*ref);
+					if (event.capabilities.brightness) event.brightness = GetMonitorBrightness(*ref, GetBrightnessOptions());
+					onEvent(event);
+					barrier->Complete(i, true);
+				});
+			}
+		});
+	}
+
+	// Records the outcome of an operation on ref that started at started. A
+	// failure because the current request was cancelled part way (its retries
+	// stopped at the deadline) says nothing about the monitor and is not
+	// counted.
+	void RecordHealth(const MonitorRef &ref, bool success, HealthTracker::Clock::time_point started) {
+		Cancellation *cancellation = CurrentCancellation();
+		if (!success && cancellation != nullptr && cancellation->IsCancelled()) return health.Abandon(ref.id);
+		health.Record(ref.id, success, HealthTracker::Clock::now() - started);
+	}
+
+	// Reads the hardware and refreshes the cached value. Fails without
+	// touching a monitor whose circuit is open.
+	int GetMonitorBrightness(const MonitorRef &ref) {
+		if (!backend || !health.Begin(ref.id)) return -1;
+
+		auto started = HealthTracker::Clock::now();
+		int brightness = backend->GetMonitorBrightness(ref);
+		RecordHealth(ref, brightness != -1, started);
+
+		if (brightness != -1) cache.Store(ref.id, brightness);
+		return brightness;
+	}
+
+	// Writes the hardware; a successful write also updates the cache.
+	bool SetMonitorBrightness(const MonitorRef &ref, int brightness) {
+		if (!backend || !health.Begin(ref.id)) return false;
+
+		auto started = HealthTracker::Clock::now();
+		bool success = backend->SetMonitorBrightness(ref, brightness);
+		RecordHealth(ref, success, started);
+
+		if (!success) return false;
+		cache.Store(ref.id, std::clamp(brightness, 0, 100));
+		return true;
+	}
+
+	// Serves the cached value unless it expired or a fresh read is requested.
+	int GetMonitorBrightness(const MonitorRef &ref, const GetBrightnessOptions &options) {
+		int brightness = -1;
+		if (!options.fresh && cache.Get(ref.id, brightness)) return brightness;
+		return GetMonitorBrightness(ref);
+	}
+
+	MonitorCapabilities ProbeMonitor(const MonitorRef &ref) {
+		return backend ? backend->ProbeMonitor(ref) : MonitorCapabilities();
+	}
+
+	// Runs write for the request numbered sequence unless a newer request's
+	// write, which jumped ahead with a higher priority, already went to
+	// monitorId. An overtaken write takes on the newer one's outcome:
+	// Coalesced if it landed, Failed if not, so it never reports a value that
+	// did not reach the monitor as set. The newer write ran earlier on the same
+	// bus queue, so its outcome is known by then. Bus queues only.
+	WriteOutcome WriteInOrder(const std::string &monitorId, std::uint64_t sequence, const std::function<bool()> &write) {
+		{
+			std::lock_guard<std::mutex> lock(writeMutex);
+			LastWrite &last = lastWrites[monitorId];
+			if (last.sequence > sequence) return last.written ? WriteOutcome::Coalesced : WriteOutcome::Failed;
+			last.sequence = sequence;
+		}
+
+		bool written = write();
+
+		std::lock_guard<std::mutex> lock(writeMutex);
+		LastWrite &last = lastWrites[monitorId];
+		if (last.sequence == sequence) last.written = written;
+		return written ? WriteOutcome::Written : WriteOutcome::Failed;
+	}
+
+	// Posts one write to the monitor's bus queue, collapsing it with a write
+	// still waiting there when coalescing, or rejects it right away if the
+	// monitor's circuit is open. A write overtaken by a newer one of higher
+	// priority is dropped, so the older value never lands last (see
+	// WriteInOrder); sequence numbers the request. snapshot keeps ref alive.
+	void WriteBrightness(std::shared_ptr<const Topology> snapshot, const MonitorRef *ref, int brightness, const SetBrightnessOptions &options,
+	                     std::uint64_t sequence, std::function<void(WriteOutcome)> done) {
+		if (!health.Admits(ref->id)) return done(WriteOutcome::Rejected);
+
+		std::string bus = QueueFor(*ref);
+		Priority priority = options.priority;
+		auto cancellation = options.cancellation;
+		auto write = [this, snapshot, ref, brightness, cancellation]() {
+			CancellationScope scope(cancellation.get());
+			return SetMonitorBrightness(*ref, brightness);
+		};
+
+		if (options.coalesce) {
+			// The coalescer only ever holds the newest write, which is still
+			// reported as coalesced if a non-coalescing one overtook it.
+			auto claimed = [this, ref, sequence, cancellation, write]() {
+				// The request already completed as cancelled.
+				if (Cancelled(cancellation)) return WriteOutcome::Failed;
+				return WriteInOrder(ref->id, sequence, write);
+			};
+			coalescer.Submit(ref->id, claimed, std::move(done), [this, bus, priority](std::function<void()> task) {
+				executor.Post(bus, std::move(task), priority);
+			}, priority);
+		} else {
+			executor.Post(bus, [this, ref, sequence, cancellation, write, done]() {
+				if (Cancelled(cancellation)) return done(WriteOutcome::Failed);
+				done(WriteInOrder(ref->id, sequence, write));
+			}, priority);
+		}
+	}
+
+	// displayId of a handle; 0, which matches no monitor, for unknown handles.
+	std::uint64_t DisplayIdForHandle(std::uint32_t handle) {
+		std::lock_guard<std::mutex> lock(handleMutex);
+		return handle != 0 && handle <= handles.size() ? handles[handle - 1].displayId : 0;
+	}
+
+	// Monitor id a handle was created for, to report it as not found.
+	std::string MonitorIdForHandle(std::uint32_t handle) {
+		std::lock_guard<std::mutex> lock(handleMutex);
+		return handle != 0 && handle <= handles.size() ? handles[handle - 1].monitorId : std::to_string(handle);
+	}
+
+	// Serves ref from the cache or reads it on its bus queue, unless the
+	// request was cancelled while it waited there. Control queue only.
+	void ReadBrightness(std::shared_ptr<const Topology> snapshot, const MonitorRef *ref, const GetBrightnessOptions &options,
+	                    std::function<void(MonitorGetResult)> done) {
+		int brightness = -1;
+
+		if (ref == nullptr) return done({"", -1, "NOT_FOUND"});
+		if (!options.fresh && cache.Get(ref->id, brightness)) return done({ref->id, brightness, ""});
+		if (!health.Admits(ref->id)) return done({ref->id, -1, "UNAVAILABLE"});
+
+		executor.Post(QueueFor(*ref), [this, snapshot, ref, options, done]() {
+			if (Cancelled(options.cancellation)) return;
+
+			CancellationScope scope(options.cancellation.get());
+			int brightness = GetMonitorBrightness(*ref);
+			done({ref->id, brightness, brightness == -1 ? "READ_FAILED" : ""});
+		}, options.priority);
+	}
+
+	// Completes a set(): reports ids that were not found and, if anything is
+	// left to write, posts the writes and reports their outcome. Control queue
+	// only.
+	void ApplyWrites(std::shared_ptr<const Topology> snapshot, const std::vector<std::pair<const MonitorRef *, int>> &writes,
+	                 const std::vector<std::string> &missing, bool global, const SetBrightnessOptions &options, std::uint64_t sequence,
+	                 std::function<void(SetBrightnessResult)> done) {
+		if (writes.empty()) {
+			SetBrightnessResult result;
+			for (const auto &monitorId: missing) result.monitors.push_back({monitorId, false, false, "NOT_FOUND"});
+			return done(result);
+		}
+
+		// All writes are posted at once and the request completes when the
+		// slowest monitor has answered.
+		WriteBrightness(snapshot, writes, options, sequence, [snapshot, writes, missing, global, done](std::vector<WriteOutcome> outcomes) {
+			SetBrightnessResult result;
+
+			for (size_t i = 0; i < writes.size(); i++) {
+				MonitorSetResult monitor;
+				monitor.monitorId = writes[i].first->id;
+				monitor.success = outcomes[i] == WriteOutcome::Written || outcomes[i] == WriteOutcome::Coalesced;
+				monitor.coalesced = outcomes[i] == WriteOutcome::Coalesced;
+				if (outcomes[i] == WriteOutcome::Failed) monitor.error = "WRITE_FAILED";
+				if (outcomes[i] == WriteOutcome::Rejected) monitor.error = "UNAVAILABLE";
+				result.monitors.push_back(monitor);
+			}
+
+			// Unknown ids are reported but, as before, do not fail the request.
+			for (const auto &monitorId: missing) result.monitors.push_back({monitorId, false, false, "NOT_FOUND"});
+
+			// Global writes have always reported success regardless of the outcome.
+			result.success = global || std::all_of(outcomes.begin(), outcomes.end(), [](WriteOutcome outcome) {
+				return outcome == WriteOutcome::Written || outcome == WriteOutcome::Coalesced;
+			});
+			result.coalesced = std::all_of(outcomes.begin(), outcomes.end(), [](WriteOutcome outcome) { return outcome == WriteOutcome::Coalesced; });
+			done(result);
+		});
+	}
+
+	// Posts several writes at once and calls back when the last one finished.
+	void WriteBrightness(std::shared_ptr<const Topology> snapshot, const std::vector<std::pair<const MonitorRef *, int>> &writes,
+	                     const SetBrightnessOptions &options, std::uint64_t sequence, std::function<void(std::vector<WriteOutcome>)> done) {
+		if (writes.empty()) return done({});
+
+		auto barrier = std::make_shared<Barrier<WriteOutcome>>(std::vector<WriteOutcome>(writes.size(), WriteOutcome::Failed), writes.size(), std::move(done));
+
+		for (size_t i = 0; i < writes.size(); i++) {
+			WriteBrightness(snapshot, writes[i].first, writes[i].second, options, sequence, [barrier, i](WriteOutcome outcome) {
+				barrier->Complete(i, outcome);
+			});
+		}
+	}
+
+	// Fade steps go through the monitor's bus queue like any other request, so
+	// they wait their turn behind interactive work and a step overtaken by a
+	// newer set is dropped (see WriteInOrder). Both block the fade's lane until
+	// the bus ran them; the fade holds the snapshot that owns ref.
+	int ReadFadeStart(const MonitorRef &ref) {
+		std::promise<int> read;
+		executor.Post(QueueFor(ref), [this, &ref, &read]() { read.set_value(GetMonitorBrightness(ref, GetBrightnessOptions())); }, Priority::Normal);
+		return read.get_future().get();
+	}
+
+	bool WriteFadeStep(const MonitorRef &ref, int brightness) {
+		std::promise<WriteOutcome> written;
+		WriteBrightness(nullptr, &ref, brightness, SetBrightnessOptions(), nextWrite++, [&written](WriteOutcome outcome) { written.set_value(outcome); });
+		WriteOutcome outcome = written.get_future().get();
+		return outcome == WriteOutcome::Written || outcome == WriteOutcome::Coalesced;
+	}
+
+	// Reads the pending monitors of a getAll() (positions in snapshot->refs)
+	// with one bulk query and completes them in barrier. The batch touches the
+	// hardware like any read, so each monitor in it is admitted by its circuit
+	// and gets one outcome: the ones the batch answered share its latency, the
+	// others are read one by one on their bus queues and recorded there. Batch
+	// queue only.
+	void ReadBatch(std::shared_ptr<const Topology> snapshot, const std::vector<size_t> &pending,
+	               std::shared_ptr<Barrier<MonitorGetResult>> barrier, const GetBrightnessOptions &options) {
+		if (Cancelled(options.cancellation)) {
+			std::string code = CancelReasonCode(options.cancellation->GetReason());
+			for (size_t i: pending) barrier->Complete(i, {snapshot->refs[i].id, -1, code});
+			return;
+		}
+
+		std::vector<MonitorRef> refs;
+		std::vector<size_t> batched;
+		for (size_t i: pending) {
+			if (!health.Begin(snapshot->refs[i].id)) {
+				barrier->Complete(i, {snapshot->refs[i].id, -1, "UNAVAILABLE"});
+				continue;
+			}
+			refs.push_back(snapshot->refs[i]);
+			batched.push_back(i);
+		}
+
+		CancellationScope scope(options.cancellation.get());
+		auto started = HealthTracker::Clock::now();
+		auto batch = refs.empty() ? std::unordered_map<std::string, int>() : backend->GetBatchBrightness(refs);
+		auto elapsed = HealthTracker::Clock::now() - started;
+
+		for (size_t i: batched) {
+			const MonitorRef *ref = &snapshot->refs[i];
+			auto it = batch.find(ref->id);
+
+			if (it != batch.end() && it->second != -1) {
+				health.Record(ref->id, true, elapsed);
+				cache.Store(ref->id, it->second);
+				barrier->Complete(i, {ref->id, it->second, ""});
+				continue;
+			}
+
+			health.Abandon(ref->id);
+			if (!health.Admits(ref->id)) {
+				barrier->Complete(i, {ref->id, -1, "UNAVAILABLE"});
+				continue;
+			}
+
+			executor.Post(QueueFor(*ref), [this, snapshot, ref, barrier, i, options]() {
+				if (Cancelled(options.cancellation)) return barrier->Complete(i, {ref->id, -1, CancelReasonCode(options.cancellation->GetReason())});
+
+				CancellationScope scope(options.cancellation.get());
+				barrier->Complete(i, {ref->id, GetMonitorBrightness(*ref), ""});
+			}, options.priority);
+		}
+	}
+
+	// Watch() for a single read of monitorId.
+	std::function<void(MonitorGetResult)> WatchRead(const GetBrightnessOptions &options, const std::string &monitorId,
+	                                                std::function<void(MonitorGetResult)> done) {
+		return Watch<MonitorGetResult>(options.cancellation, std::move(done), [monitorId](CancelReason reason) {
+			return MonitorGetResult{monitorId, -1, CancelReasonCode(reason)};
+		});
+	}
+
+	// Watch() for a set(); the writes that did finish are not reported.
+	std::function<void(SetBrightnessResult)> WatchWrite(const SetBrightnessOptions &options, std::function<void(SetBrightnessResult)> done) {
+		return Watch<SetBrightnessResult>(options.cancellation, std::move(done), [](CancelReason reason) {
+			SetBrightnessResult result;
+			result.error = CancelReasonCode(reason);
+			result.message = reason == CancelReason::Aborted ? "Aborted." : "Timed out.";
+			return result;
+		});
+	}
+
+	// Reads one monitor by id on its bus queue; an empty id means the primary
+	// monitor. Calls back with brightness -1 and a reason on failure.
+	void GetBrightness(const std::string &monitorId, const GetBrightnessOptions &options, std::function<void(MonitorGetResult)> done) {
+		done = WatchRead(options, monitorId, std::move(done));
+
+		executor.Post(CONTROL_QUEUE, [this, monitorId, options, done]() {
+			if (Cancelled(options.cancellation)) return;
+			auto snapshot = GetTopology();
+			ReadBrightness(snapshot, monitorId.empty() ? snapshot->Primary() : snapshot->Find(monitorId), options, done);
+		}, options.priority);
+	}
+
+	// The same for a handle from GetHandle(), which resolves without building
+	// or hashing a string.
+	void GetBrightness(std::uint32_t handle, const GetBrightnessOptions &options, std::function<void(MonitorGetResult)> done) {
+		std::uint64_t displayId = DisplayIdForHandle(handle);
+		done = WatchRead(options, MonitorIdForHandle(handle), std::move(done));
+
+		executor.Post(CONTROL_QUEUE, [this, displayId, options, done]() {
+			if (Cancelled(options.cancellation)) return;
+			auto snapshot = GetTopology();
+			ReadBrightness(snapshot, snapshot->Find(displayId), options, done);
+		}, options.priority);
+	}
+
+	// Reads every monitor: cached values first, then whatever the backend can
+	// serve in one bulk query, then the rest in parallel on their bus queues.
+	void GetAllBrightness(const GetBrightnessOptions &options, std::function<void(GetAllBrightnessResult)> done) {
+		done = Watch<GetAllBrightnessResult>(options.cancellation, std::move(done), [](CancelReason reason) {
+			GetAllBrightnessResult result;
+			result.error = CancelReasonCode(reason);
+			return result;
+		});
+
+		executor.Post(CONTROL_QUEUE, [this, options, done]() {
+			if (Cancelled(options.cancellation)) return;
+			auto snapshot = GetTopology();
+			std::vector<MonitorGetResult> results(snapshot->refs.size());
+			std::vector<size_t> pending;
+
+			for (size_t i = 0; i < snapshot->refs.size(); i++) {
+				results[i].monitorId = snapshot->refs[i].id;
+				if (options.fresh || !cache.Get(results[i].monitorId, results[i].brightness)) pending.push_back(i);
+			}
+
+			auto finish = [done](std::vector<MonitorGetResult> results) {
+				for (auto &result: results) {
+					if (result.brightness == -1 && result.error.empty()) result.error = "READ_FAILED";
+				}
+				done({std::move(results), ""});
+			};
+
+			if (pending.empty() || !backend) return finish(std::move(results));
+
+			// The bulk read can be as slow as a WMI query, so it runs on its own
+			// queue rather than holding up every other request here.
+			auto barrier = std::make_shared<Barrier<MonitorGetResult>>(std::move(results), pending.size(), finish);
+			executor.Post(BATCH_QUEUE, [this, snapshot, pending, barrier, options]() {
+				ReadBatch(snapshot, pending, barrier, options);
+			}, options.priority);
+		}, options.priority);
+	}
+
+	// Applies a set() request: a single monitor ("primary" or ALL_MONITORS
+	// allowed) or a list of monitor/level pairs, which succeeds only if every
+	// listed monitor exists and was updated. A coalesced write counts as
+	// successful; the newer write that replaced it reports the real outcome.
+	void SetBrightness(const std::vector<MonitorBrightnessConfiguration> &configurations, const SetBrightnessOptions &options,
+	                   std::function<void(SetBrightnessResult)> done) {
+		done = WatchWrite(options, std::move(done));
+		std::uint64_t sequence = nextWrite++;
+
+		executor.Post(CONTROL_QUEUE, [this, configurations, options, sequence, done]() {
+			if (Cancelled(options.cancellation)) return;
+			SetBrightnessResult result;
+			auto snapshot = GetTopology();
+
+			if (snapshot->refs.empty()) {
+				result.message = "No monitors available.";
+				return done(result);
+			}
+
+			std::vector<std::pair<const MonitorRef *, int>> writes;
+			std::vector<std::string> missing;
+			bool global = false;
+
+			if (configurations.size() == 1) {
+				auto monitorId = configurations[0].monitorId;
+				if (monitorId == "primary") monitorId = snapshot->Primary()->id;
+				global = monitorId == ALL_MONITORS;
+
+				if (global) {
+					for (const auto &ref: snapshot->refs) writes.emplace_back(&ref, configurations[0].brightness);
+				} else if (const MonitorRef *ref = snapshot->Find(monitorId)) {
+					writes.emplace_back(ref, configurations[0].brightness);
+				} else {
+					missing.push_back(monitorId);
+				}
+			} else {
+				for (const auto &config: configurations) {
+					const MonitorRef *ref = snapshot->Find(config.monitorId);
+					if (ref != nullptr) writes.emplace_back(ref, config.brightness);
+					else missing.push_back(config.monitorId);
+				}
+			}
+
+			ApplyWrites(snapshot, writes, missing, global, options, sequence, done);
+		}, options.priority);
+	}
+
+	// The same for a single monitor named by a handle from GetHandle().
+	void SetBrightness(std::uint32_t handle, int brightness, const SetBrightnessOptions &options, std::function<void(SetBrightnessResult)> done) {
+		std::uint64_t displayId = DisplayIdForHandle(handle);
+		done = WatchWrite(options, std::move(done));
+		std::uint64_t sequence = nextWrite++;
+
+		executor.Post(CONTROL_QUEUE, [this, handle, displayId, brightness, options, sequence, done]() {
+			if (Cancelled(options.cancellation)) return;
+			auto snapshot = GetTopology();
+			const MonitorRef *ref = snapshot->Find(displayId);
+
+			if (snapshot->refs.empty()) {
+				SetBrightnessResult result;
+				result.message = "No monitors available.";
+				return done(result);
+			}
+
+			if (ref == nullptr) return ApplyWrites(snapshot, {}, {MonitorIdForHandle(handle)}, false, options, sequence, done);
+			ApplyWrites(snapshot, {{ref, brightness}}, {}, false, options, sequence, done);
+		}, options.priority);
+	}
+
+	// Writes writes[i].second to the monitor of handle writes[i].first, all in
+	// parallel, and reports one status per write in the same order.
+	void SetManyBrightness(const std::vector<std::pair<std::uint32_t, int>> &writes, const SetBrightnessOptions &options,
+	                       std::function<void(std::vector<SetStatus>)> done) {
+		std::vector<std::uint64_t> displayIds(writes.size());
+
+		{
+			std::lock_guard<std::mutex> lock(handleMutex);
+			for (size_t i = 0; i < writes.size(); i++) {
+				std::uint32_t handle = writes[i].first;
+				displayIds[i] = handle != 0 && handle <= handles.size() ? handles[handle - 1].displayId : 0;
+			}
+		}
+
+		done = Watch<std::vector<SetStatus>>(options.cancellation, std::move(done), [displayIds](CancelReason reason) {
+			SetStatus cancelled = reason == CancelReason::Aborted ? SetStatus::Aborted : SetStatus::TimedOut;
+			std::vector<SetStatus> statuses;
+			for (std::uint64_t displayId: displayIds) statuses.push_back(displayId != 0 ? cancelled : SetStatus::NotFound);
+			return statuses;
+		});
+
+		std::uint64_t sequence = nextWrite++;
+
+		executor.Post(CONTROL_QUEUE, [this, writes, displayIds, options, sequence, done]() {
+			if (Cancelled(options.cancellation)) return;
+			auto snapshot = GetTopology();
+			std::vector<SetStatus> statuses(writes.size(), SetStatus::NotFound);
+			std::vector<std::pair<const MonitorRef *, int>> found;
+			std::vector<size_t> positions;
+
+			for (size_t i = 0; i < writes.size(); i++) {
+				if (const MonitorRef *ref = snapshot->Find(displayIds[i])) {
+					found.emplace_back(ref, writes[i].second);
+					positions.push_back(i);
+				}
+			}
+
+			WriteBrightness(snapshot, found, options, sequence, [statuses, positions, done](std::vector<WriteOutcome> outcomes) mutable {
+				for (size_t i = 0; i < outcomes.size(); i++) {
+					SetStatus status = SetStatus::Ok;
+					if (outcomes[i] == WriteOutcome::Failed) status = SetStatus::WriteFailed;
+					else if (outcomes[i] == WriteOutcome::Rejected) status = SetStatus::Unavailable;
+					else if (outcomes[i] == WriteOutcome::Coalesced) status = SetStatus::Coalesced;
+					statuses[positions[i]] = status;
+				}
+				done(std::move(statuses));
+			});
+		}, options.priority);
+	}
+
+	// Blocking forms of the calls above, for native callers that are not on an
+	// executor queue themselves.
+	int GetBrightness(const std::string &monitorId, const GetBrightnessOptions &options = {}) {
+		std::promise<int> result;
+		GetBrightness(monitorId, options, [&result](MonitorGetResult value) { result.set_value(value.brightness); });
+		return result.get_future().get();
+	}
+
+	SetBrightnessResult SetBrightness(const std::vector<MonitorBrightnessConfiguration> &configurations, const SetBrightnessOptions &options = {}) {
+		std::promise<SetBrightnessResult> result;
+		SetBrightness(configurations, options, [&result](SetBrightnessResult value) { result.set_value(value); });
+		return result.get_future().get();
+	}
+
+	bool SetGlobalBrightness(int brightness) {
+		return SetBrightness({{ALL_MONITORS, brightness}}).success;
+	}
+
+	// Starts a fade on one monitor ("primary" and ALL_MONITORS allowed; an empty
+	// id means the primary monitor). Returns 0, without calling back, if no such
+	// monitor exists.
+	std::uint64_t Fade(const std::string &monitorId, int target, std::chrono::milliseconds duration, FadeEasing easing, FadeScheduler::Callback callback) {
+		auto snapshot = SnapshotForCaller();
+		std::vector<std::pair<MonitorRef, int>> monitors;
+
+		if (snapshot->refs.empty()) return 0;
+
+		auto add = [&](const MonitorRef &ref) {
+			int brightness = -1;
+			cache.Get(ref.id, brightness);
+			monitors.emplace_back(ref, brightness);
+		};
+
+		if (monitorId == ALL_MONITORS) {
+			for (const auto &ref: snapshot->refs) add(ref);
+		} else if (monitorId.empty() || monitorId == "primary") {
+			add(*snapshot->Primary());
+		} else if (const MonitorRef *ref = snapshot->Find(monitorId)) {
+			add(*ref);
+		}
+
+		if (monitors.empty()) return 0;
+
+		return fades.Start(monitors, target, duration, easing, snapshot, std::move(callback));
+	}
+
+	bool CancelFade(std::uint64_t id) {
+		return fades.Cancel(id);
+	}
+};
+
+// The process-wide engine owned by the addon.
+MonitorService &GetMonitorService();
+
+#endif//MONITOR_SERVICE_H
@@ -0,0 +1,18 @@
+#ifndef PRIORITY_H
+#define PRIORITY_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Which work a bus serves first; see IoExecutor.
+enum class Priority : std::uint8_t {
+	// Someone is waiting on the result, e.g. a slider being dragged.
+	Interactive,
+	Normal,
+	// Schedules, sweeps and polls; rate limited so they cannot saturate a bus.
+	Background
+};
+
+constexpr size_t PRIORITY_COUNT = 3;
+
+#endif// PRIORITY_H
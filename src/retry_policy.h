@@ -0,0 +1,123 @@
+#ifndef RETRY_POLICY_H
+#define RETRY_POLICY_H
+
+#include "cancellation.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+// How a backend retries a failed monitor operation: up to attempts tries, the
+// n-th retry after initialDelay * multiplier^(n-1), capped at maxDelay. jitter
+// is the fraction of each delay that is random (0.5 waits between half and all
+// of it), so monitors on one bus that failed together do not retry in step.
+struct RetryPolicy {
+	int attempts = 3;
+	std::chrono::microseconds initialDelay{std::chrono::milliseconds(5)};
+	std::chrono::microseconds maxDelay{std::chrono::milliseconds(100)};
+	double multiplier = 2;
+	double jitter = 0.5;
+	// Try the way of reaching a monitor that worked last time first (see
+	// PathPreference). Off, every operation starts from the first one.
+	bool learn = true;
+
+	// Delay before the given retry (1 for the first).
+	std::chrono::microseconds Delay(int retry, std::mt19937 &random) const {
+		double delay = static_cast<double>(initialDelay.count()) * std::pow(multiplier, retry - 1);
+		delay = std::min(delay, static_cast<double>(maxDelay.count()));
+
+		double fraction = std::clamp(jitter, 0.0, 1.0);
+		delay *= 1 - fraction * std::uniform_real_distribution<double>(0, 1)(random);
+
+		return std::chrono::microseconds(static_cast<long long>(delay));
+	}
+};
+
+// Calls attempt until it returns true or the policy gives up, sleeping the
+// backoff delay in between. Gives up early once the current request (see
+// CurrentCancellation) is cancelled, and never sleeps past its deadline.
+// Returns the last result.
+template<typename Attempt>
+bool Retry(const RetryPolicy &policy, Attempt attempt) {
+	thread_local std::mt19937 random(std::random_device{}());
+	Cancellation *cancellation = CurrentCancellation();
+
+	for (int tries = 1;; tries++) {
+		if (attempt()) return true;
+		if (tries >= policy.attempts) return false;
+
+		auto delay = policy.Delay(tries, random);
+		if (cancellation != nullptr) {
+			auto remaining = cancellation->GetDeadline() - Cancellation::Clock::now();
+			if (remaining < delay) delay = std::chrono::duration_cast<std::chrono::microseconds>(std::max(remaining, Cancellation::Clock::duration(0)));
+		}
+		if (delay.count() > 0) std::this_thread::sleep_for(delay);
+		if (cancellation != nullptr && cancellation->IsCancelled()) return false;
+	}
+}
+
+// Remembers, per monitor, which of a backend's ways of reaching it (e.g. DDC/CI
+// through Dxva2, then WMI on Windows) last worked. Operations go straight to
+// that path; the others are only probed again after it failed, so a laptop
+// panel without DDC/CI pays for the failing path once instead of on every call.
+class PathPreference {
+private:
+	mutable std::mutex mutex;
+	std::unordered_map<std::string, size_t> preferred;
+	RetryPolicy policy;
+
+public:
+	explicit PathPreference(const RetryPolicy &policy = {}) : policy(policy) {}
+
+	void SetPolicy(const RetryPolicy &value) {
+		std::lock_guard<std::mutex> lock(mutex);
+		policy = value;
+		if (!policy.learn) preferred.clear();
+	}
+
+	RetryPolicy GetPolicy() const {
+		std::lock_guard<std::mutex> lock(mutex);
+		return policy;
+	}
+
+	// The path that last worked for id, or paths if none did yet.
+	size_t Preferred(const std::string &id, size_t paths) const {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = preferred.find(id);
+		return it != preferred.end() && it->second < paths ? it->second : paths;
+	}
+
+	// Runs attempt(path), retrying under the policy, on the preferred path and
+	// then on the others in order until one succeeds or the current request
+	// is cancelled.
+	template<typename Attempt>
+	bool Run(const std::string &id, size_t paths, Attempt attempt) {
+		RetryPolicy current = GetPolicy();
+		size_t first = current.learn ? Preferred(id, paths) : paths;
+		Cancellation *cancellation = CurrentCancellation();
+
+		if (first < paths && Retry(current, [&]() { return attempt(first); })) return true;
+
+		for (size_t path = 0; path < paths; path++) {
+			if (cancellation != nullptr && cancellation->IsCancelled()) return false;
+			if (path == first || !Retry(current, [&]() { return attempt(path); })) continue;
+
+			if (current.learn) {
+				std::lock_guard<std::mutex> lock(mutex);
+				preferred[id] = path;
+			}
+			return true;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		preferred.erase(id);
+		return false;
+	}
+};
+
+#endif// RETRY_POLICY_H
@@ -1,169 +1,183 @@
-#ifndef WMI_CLIENT_H
-#define WMI_CLIENT_H
-
-#include "utils.h"
-#include <combaseapi.h>
-#include <comdef.h>
-#include <iostream>
-#include <string>
-#include <vector>
-#include <wbemidl.h>
-#include <windows.h>
-
-class WmiClient {
-
-private:
-	bool createLocator() {
-		HRESULT hres = CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
-
-		if (FAILED(hres)) {
-			std::cout << "Failed to initialize COM library. Error code = 0x"
-			          << std::hex << hres << std::endl;
-			return false;
-		}
-
-		hres = CoCreateInstance(CLSID_WbemLocator, 0, CLSCTX_INPROC_SERVER, IID_IWbemLocator, reinterpret_cast<LPVOID *>(&locator));
-
-		if (FAILED(hres)) return false;
-		return true;
-	}
-
-	bool createService() {
-		if (locator == nullptr) return false;
-
-		HRESULT hres = locator->ConnectServer(_bstr_t(L"ROOT\\WMI"), NULL, NULL, 0, NULL, 0, 0, &service);
-
-		if (FAILED(hres)) return false;
-
-		hres = CoSetProxyBlanket(service, RPC_C_AUTHN_WINNT, RPC_C_AUTHZ_NONE, NULL, RPC_C_AUTHN_LEVEL_CALL, RPC_C_IMP_LEVEL_IMPERSONATE, NULL, EOAC_NONE);
-
-		if (FAILED(hres)) return false;
-
-		return true;
-	}
-
-	void destroyLocator() {
-		if (locator != nullptr) locator->Release();
-		locator = nullptr;
-	}
-
-	void destroyService() {
-		if (service != nullptr) service->Release();
-		service = nullptr;
-	}
-
-	void init() {
-		createLocator();
-		createService();
-	}
-
-public:
-	IWbemServices *service = nullptr;
-	IWbemLocator *locator = nullptr;
-
-	WmiClient() {
-		init();
-	}
-
-	~WmiClient() {
-		destroyLocator();
-		destroyService();
-		CoUninitialize();
-	}
-
-	HRESULT execQuery(const std::string &query, IEnumWbemClassObject **enumObj) {
-		std::string escapedQuery = EscapeString(query);
-		std::wstring wideQuery(escapedQuery.begin(), escapedQuery.end());
-
-		HRESULT hres = service->ExecQuery(
-		        _bstr_t(L"WQL"),
-		        _bstr_t(wideQuery.c_str()),
-		        WBEM_FLAG_FORWARD_ONLY | WBEM_FLAG_RETURN_IMMEDIATELY,
-		        nullptr,
-		        enumObj);
-
-		if (FAILED(hres)) {
-			_com_error err(hres);
-			LPCTSTR errMsg = err.ErrorMessage();
-			std::cout << "Failed to execute WMI query: " << errMsg << std::endl;
-			return hres;
-		}
-
-		return S_OK;
-	}
-
-	HRESULT getMethod(const std::string name, IWbemClassObject **pClass) {
-		HRESULT result = service->GetObject(_bstr_t(name.c_str()), 0, NULL, pClass, NULL);
-
-		if (FAILED(result)) {
-			std::cout << "Failed to get " + name + " class." << std::endl;
-		}
-
-		return result;
-	}
-
-	HRESULT execMethod(const std::wstring path, const std::string method, IWbemClassObject *instance) {
-		HRESULT result = service->ExecMethod(_bstr_t(path.c_str()),
-		                                     _bstr_t(method.c_str()),
-		                                     0,
-		                                     NULL,
-		                                     instance,
-		                                     NULL,
-		                                     NULL);
-
-		if (FAILED(result)) {
-			std::cout << "Failed to execute " + method << std::endl;
-		}
-
-		return result;
-	}
-
-	BSTR *pathForInstance(const std::string &instanceName, const std::string className) {
-		IEnumWbemClassObject *enumObj = nullptr;
-
-		HRESULT hres = execQuery("SELECT * FROM " + className + " WHERE InstanceName='" + instanceName + "'", &enumObj);
-
-		if (FAILED(hres)) {
-			std::cout << "Failed to execute " + className + " query." << std::endl;
-			return nullptr;
-		}
-
-		IWbemClassObject *pObj = nullptr;
-		ULONG numReturned = 0;
-
-		hres = enumObj->Next(WBEM_INFINITE, 1, &pObj, &numReturned);
-
-		enumObj->Release();
-
-		if (FAILED(hres) || numReturned == 0) {
-			std::cout << "Failed retrieving object." << std::endl;
-			return nullptr;
-		}
-
-		VARIANT pathVariant;
-		VariantInit(&pathVariant);
-
-		hres = pObj->Get(_bstr_t(L"__PATH"),
-		                 0,
-		                 &pathVariant,
-		                 NULL,
-		                 NULL);
-
-		pObj->Release();
-
-		if (FAILED(hres)) {
-			std::cout << "Failed retrieving object path." << std::endl;
-			return nullptr;
-		}
-
-		BSTR *path = new BSTR;
-
-		*path = SysAllocString(pathVariant.bstrVal);
-
-		VariantClear(&pathVariant);
-
-		return path;
-	}
-};
-
-#endif// WMI_CLIENT_H
+#ifndef WMI_CLIENT_H
+#define WMI_CLIENT_H
+
+#include "cancellation.h"
+#include "utils.h"
+#include <chrono>
+#include <combaseapi.h>
+#include <comdef.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <wbemidl.h>
+#include <windows.h>
+
+// Longest an enumerator's Next() waits for a WMI provider, instead of
+// WBEM_INFINITE: a hung provider fails the operation rather than holding its
+// queue forever.
+constexpr std::chrono::milliseconds WMI_TIMEOUT{5000};
+
+// Timeout for the next Next() call: WMI_TIMEOUT, or less when the current
+// request's deadline is nearer. Next() then returns WBEM_S_TIMEDOUT with no
+// object.
+inline long WmiTimeout() {
+	return static_cast<long>(RemainingTime(WMI_TIMEOUT).count());
+}
+
+class WmiClient {
+
+private:
+	bool createLocator() {
+		HRESULT hres = CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
+
+		if (FAILED(hres)) {
+			std::cout << "Failed to initialize COM library. Error code = 0x"
+			          << std::hex << hres << std::endl;
+			return false;
+		}
+
+		hres = CoCreateInstance(CLSID_WbemLocator, 0, CLSCTX_INPROC_SERVER, IID_IWbemLocator, reinterpret_cast<LPVOID *>(&locator));
+
+		if (FAILED(hres)) return false;
+		return true;
+	}
+
+	bool createService() {
+		if (locator == nullptr) return false;
+
+		HRESULT hres = locator->ConnectServer(_bstr_t(L"ROOT\\WMI"), NULL, NULL, 0, NULL, 0, 0, &service);
+
+		if (FAILED(hres)) return false;
+
+		hres = CoSetProxyBlanket(service, RPC_C_AUTHN_WINNT, RPC_C_AUTHZ_NONE, NULL, RPC_C_AUTHN_LEVEL_CALL, RPC_C_IMP_LEVEL_IMPERSONATE, NULL, EOAC_NONE);
+
+		if (FAILED(hres)) return false;
+
+		return true;
+	}
+
+	void destroyLocator() {
+		if (locator != nullptr) locator->Release();
+		locator = nullptr;
+	}
+
+	void destroyService() {
+		if (service != nullptr) service->Release();
+		service = nullptr;
+	}
+
+	void init() {
+		createLocator();
+		createService();
+	}
+
+public:
+	IWbemServices *service = nullptr;
+	IWbemLocator *locator = nullptr;
+
+	WmiClient() {
+		init();
+	}
+
+	~WmiClient() {
+		destroyLocator();
+		destroyService();
+		CoUninitialize();
+	}
+
+	HRESULT execQuery(const std::string &query, IEnumWbemClassObject **enumObj) {
+		std::string escapedQuery = EscapeString(query);
+		std::wstring wideQuery(escapedQuery.begin(), escapedQuery.end());
+
+		HRESULT hres = service->ExecQuery(
+		        _bstr_t(L"WQL"),
+		        _bstr_t(wideQuery.c_str()),
+		        WBEM_FLAG_FORWARD_ONLY | WBEM_FLAG_RETURN_IMMEDIATELY,
+		        nullptr,
+		        enumObj);
+
+		if (FAILED(hres)) {
+			_com_error err(hres);
+			LPCTSTR errMsg = err.ErrorMessage();
+			std::cout << "Failed to execute WMI query: " << errMsg << std::endl;
+			return hres;
+		}
+
+		return S_OK;
+	}
+
+	HRESULT getMethod(const std::string name, IWbemClassObject **pClass) {
+		HRESULT result = service->GetObject(_bstr_t(name.c_str()), 0, NULL, pClass, NULL);
+
+		if (FAILED(result)) {
+			std::cout << "Failed to get " + name + " class." << std::endl;
+		}
+
+		return result;
+	}
+
+	HRESULT execMethod(const std::wstring path, const std::string method, IWbemClassObject *instance) {
+		HRESULT result = service->ExecMethod(_bstr_t(path.c_str()),
+		                                     _bstr_t(method.c_str()),
+		                                     0,
+		                                     NULL,
+		                                     instance,
+		                                     NULL,
+		                                     NULL);
+
+		if (FAILED(result)) {
+			std::cout << "Failed to execute " + method << std::endl;
+		}
+
+		return result;
+	}
+
+	BSTR *pathForInstance(const std::string &instanceName, const std::string className) {
+		IEnumWbemClassObject *enumObj = nullptr;
+
+		HRESULT hres = execQuery("SELECT * FROM " + className + " WHERE InstanceName='" + instanceName + "'", &enumObj);
+
+		if (FAILED(hres)) {
+			std::cout << "Failed to execute " + className + " query." << std::endl;
+			return nullptr;
+		}
+
+		IWbemClassObject *pObj = nullptr;
+		ULONG numReturned = 0;
+
+		hres = enumObj->Next(WmiTimeout(), 1, &pObj, &numReturned);
+
+		enumObj->Release();
+
+		if (FAILED(hres) || numReturned == 0) {
+			std::cout << "Failed retrieving object." << std::endl;
+			return nullptr;
+		}
+
+		VARIANT pathVariant;
+		VariantInit(&pathVariant);
+
+		hres = pObj->Get(_bstr_t(L"__PATH"),
+		                 0,
+		                 &pathVariant,
+		                 NULL,
+		                 NULL);
+
+		pObj->Release();
+
+		if (FAILED(hres)) {
+			std::cout << "Failed retrieving object path." << std::endl;
+			return nullptr;
+		}
+
+		BSTR *path = new BSTR;
+
+		*path = SysAllocString(pathVariant.bstrVal);
+
+		VariantClear(&pathVariant);
+
+		return path;
+	}
+};
+
+#endif// WMI_CLIENT_H
@@ -0,0 +1,69 @@
+#ifndef COMPLETION_QUEUE_H
+#define COMPLETION_QUEUE_H
+
+#include <functional>
+#include <napi.h>
+
+// Delivers results computed on engine threads to the JS thread. One
+// thread-safe function per environment carries every completion, and it only
+// keeps the event loop alive while completions are outstanding.
+class CompletionQueue {
+public:
+	typedef std::function<void(Napi::Env)> Completion;
+	// Hands a completion to the JS thread; callable once from any thread.
+	typedef std::function<void(Completion)> Sender;
+	// Hands any number of completions to the JS thread, the final one with
+	// last set; callable from any thread.
+	typedef std::function<void(Completion, bool last)> StreamSender;
+
+private:
+	struct Item {
+		Completion completion;
+		bool last;
+	};
+
+	static void Call(Napi::Env env, Napi::Function, CompletionQueue *queue, Item *item) {
+		if (env != nullptr) {
+			Napi::HandleScope scope(env);
+			item->completion(env);
+			if (item->last && --queue->pending == 0) queue->function.Unref(env);
+		}
+
+		delete item;
+	}
+
+	typedef Napi::TypedThreadSafeFunction<CompletionQueue, Item, Call> Function;
+
+	Function function;
+	// Touched only on the JS thread.
+	size_t pending = 0;
+
+public:
+	explicit CompletionQueue(Napi::Env env) {
+		function = Function::New(env, "lumi", 0, 1, this);
+		function.Unref(env);
+	}
+
+	static CompletionQueue &For(Napi::Env env) {
+		return *env.GetInstanceData<CompletionQueue>();
+	}
+
+	// Registers an outstanding operation. Must be called on the JS thread.
+	Sender Begin(Napi::Env env) {
+		StreamSender send = BeginStream(env);
+		return [send](Completion completion) { send(std::move(completion), true); };
+	}
+
+	// Registers an operation that delivers several results. Must be called on
+	// the JS thread.
+	StreamSender BeginStream(Napi::Env env) {
+		if (pending++ == 0) function.Ref(env);
+
+		Function target = function;
+		return [target](Completion completion, bool last) {
+			target.BlockingCall(new Item{std::move(completion), last});
+		};
+	}
+};
+
+#endif// COMPLETION_QUEUE_H
@@ -0,0 +1,72 @@
+#ifndef DISCOVER_MONITORS_H
+#define DISCOVER_MONITORS_H
+
+#include "../monitor_service.h"
+#include "completion_queue.h"
+#include "get_monitors.h"
+#include <napi.h>
+
+// Glue behind lumi.discover(). The native export takes a callback that receives
+// every discovery event and finally null; index.js turns it into an async
+// iterator.
+class DiscoverMonitorsRequest {
+private:
+	static const char *KindName(DiscoveryEvent::Kind kind) {
+		switch (kind) {
+			case DiscoveryEvent::Kind::Details:
+				return "details";
+			case DiscoveryEvent::Kind::Capabilities:
+				return "capabilities";
+			default:
+				return "identity";
+		}
+	}
+
+	static Napi::Object ToObject(Napi::Env env, const DiscoveryEvent &event) {
+		Napi::Object result = Napi::Object::New(env);
+		result.Set("type", Napi::String::New(env, KindName(event.kind)));
+		result.Set("monitor", GetMonitorsRequest::ToObject(env, event.monitor));
+
+		if (event.kind == DiscoveryEvent::Kind::Capabilities) {
+			Napi::Object capabilities = Napi::Object::New(env);
+			capabilities.Set("brightness", Napi::Boolean::New(env, event.capabilities.brightness));
+			capabilities.Set("minBrightness", Napi::Number::New(env, event.capabilities.minBrightness));
+			capabilities.Set("maxBrightness", Napi::Number::New(env, event.capabilities.maxBrightness));
+			result.Set("capabilities", capabilities);
+			result.Set("brightness", event.brightness == -1 ? env.Null() : Napi::Number::New(env, event.brightness));
+		}
+
+		return result;
+	}
+
+public:
+	// discover(callback)
+	static Napi::Value Start(const Napi::CallbackInfo &info) {
+		Napi::Env env = info.Env();
+
+		if (!info[0].IsFunction()) {
+			Napi::TypeError::New(env, "discover expects a callback").ThrowAsJavaScriptException();
+			return env.Undefined();
+		}
+
+		// Only touched on the JS thread; released by the final completion.
+		auto *callback = new Napi::FunctionReference(Napi::Persistent(info[0].As<Napi::Function>()));
+		CompletionQueue::StreamSender send = CompletionQueue::For(env).BeginStream(env);
+
+		GetMonitorService().Discover(
+		        [callback, send](const DiscoveryEvent &event) {
+			        send([callback, event](Napi::Env env) { callback->Call({ToObject(env, event)}); }, false);
+		        },
+		        [callback, send]() {
+			        send([callback](Napi::Env env) {
+				        callback->Call({env.Null()});
+				        delete callback;
+			        },
+			             true);
+		        });
+
+		return env.Undefined();
+	}
+};
+
+#endif// DISCOVER_MONITORS_H
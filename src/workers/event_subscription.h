@@ -0,0 +1,62 @@
+#ifndef EVENT_SUBSCRIPTION_H
+#define EVENT_SUBSCRIPTION_H
+
+#include "completion_queue.h"
+#include <cstdint>
+#include <functional>
+#include <napi.h>
+
+// A JS callback fed by engine threads until it is stopped, behind the native
+// watch/unwatch pairs that index.js turns into lumi.on()/off(). The handle
+// given to JS is an External wrapping the subscription; the subscription frees
+// itself with the final completion once the engine is done with it.
+class EventSubscription {
+private:
+	Napi::FunctionReference callback;
+	CompletionQueue::StreamSender send;
+	bool stopped = false;
+
+	EventSubscription(Napi::Env env, Napi::Function callback)
+	    : callback(Napi::Persistent(callback)), send(CompletionQueue::For(env).BeginStream(env)) {}
+
+public:
+	// Engine id of the listener feeding this subscription.
+	std::uint64_t id = 0;
+
+	// Must be called on the JS thread; returns null (with a pending exception)
+	// if no callback was given.
+	static EventSubscription *Create(const Napi::CallbackInfo &info) {
+		if (!info[0].IsFunction()) {
+			Napi::TypeError::New(info.Env(), "Expected a callback").ThrowAsJavaScriptException();
+			return nullptr;
+		}
+		return new EventSubscription(info.Env(), info[0].As<Napi::Function>());
+	}
+
+	// Resolves the handle passed back from JS to stop it; a handle must not be
+	// used again after that. Returns null if it is not a handle. Must be called
+	// on the JS thread.
+	static EventSubscription *FromHandle(const Napi::Value &handle) {
+		if (!handle.IsExternal()) return nullptr;
+		EventSubscription *subscription = handle.As<Napi::External<EventSubscription>>().Data();
+		if (subscription->stopped) return nullptr;
+		subscription->stopped = true;
+		return subscription;
+	}
+
+	Napi::Value Handle(Napi::Env env) {
+		return Napi::External<EventSubscription>::New(env, this);
+	}
+
+	// Calls the JS callback with whatever make builds. Any thread, until Finish.
+	void Emit(std::function<Napi::Value(Napi::Env)> make) {
+		send([this, make](Napi::Env env) { callback.Call({make(env)}); }, false);
+	}
+
+	// Called once the engine will not Emit any more. Any thread.
+	void Finish() {
+		send([this](Napi::Env) { delete this; }, true);
+	}
+};
+
+#endif// EVENT_SUBSCRIPTION_H
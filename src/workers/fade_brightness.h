@@ -0,0 +1,76 @@
+#ifndef FADE_BRIGHTNESS_H
+#define FADE_BRIGHTNESS_H
+
+#include "../fade_scheduler.h"
+#include "../monitor_service.h"
+#include "completion_queue.h"
+#include <memory>
+#include <napi.h>
+#include <string>
+
+// Glue between lumi.fade() and the engine's fade scheduler. Fades finish on
+// the scheduler's threads; their promises are settled through the completion
+// queue.
+class FadeBrightnessRequest {
+private:
+	static const char *StatusName(FadeStatus status) {
+		switch (status) {
+			case FadeStatus::Completed:
+				return "completed";
+			case FadeStatus::Cancelled:
+				return "cancelled";
+			case FadeStatus::Superseded:
+				return "superseded";
+			default:
+				return "failed";
+		}
+	}
+
+	static FadeEasing ParseEasing(const Napi::Value &value) {
+		std::string easing = value.IsString() ? value.As<Napi::String>().Utf8Value() : "";
+		if (easing == "easeIn") return FadeEasing::EaseIn;
+		if (easing == "easeOut") return FadeEasing::EaseOut;
+		if (easing == "easeInOut") return FadeEasing::EaseInOut;
+		return FadeEasing::Linear;
+	}
+
+public:
+	// fade(monitorId, target, durationMs, {easing}) -> Promise<FadeResult> & {cancel()}
+	static Napi::Value Start(const Napi::CallbackInfo &info) {
+		Napi::Env env = info.Env();
+
+		std::string monitorId = info[0].IsString() ? info[0].As<Napi::String>().Utf8Value() : "";
+		int target = info[1].IsNumber() ? info[1].As<Napi::Number>().Int32Value() : -1;
+		int64_t duration = info[2].IsNumber() ? info[2].As<Napi::Number>().Int64Value() : 0;
+		FadeEasing easing = info[3].IsObject() ? ParseEasing(info[3].As<Napi::Object>().Get("easing")) : FadeEasing::Linear;
+
+		auto deferred = std::make_shared<Napi::Promise::Deferred>(Napi::Promise::Deferred::New(env));
+		Napi::Promise promise = deferred->Promise();
+		CompletionQueue::Sender send = CompletionQueue::For(env).Begin(env);
+
+		auto complete = [deferred, send](FadeStatus status) {
+			send([deferred, status](Napi::Env env) {
+				Napi::Object result = Napi::Object::New(env);
+
+				result.Set("success", Napi::Boolean::New(env, status == FadeStatus::Completed));
+				result.Set("status", Napi::String::New(env, StatusName(status)));
+
+				deferred->Resolve(result);
+			});
+		};
+
+		std::uint64_t id = 0;
+		if (target >= 0) {
+			id = GetMonitorService().Fade(monitorId, target, std::chrono::milliseconds(std::max<int64_t>(duration, 0)), easing, complete);
+		}
+		if (id == 0) complete(FadeStatus::Failed);
+
+		promise.Set("cancel", Napi::Function::New(env, [id](const Napi::CallbackInfo &info) {
+			return Napi::Boolean::New(info.Env(), id != 0 && GetMonitorService().CancelFade(id));
+		}));
+
+		return promise;
+	}
+};
+
+#endif// FADE_BRIGHTNESS_H
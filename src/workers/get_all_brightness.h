@@ -0,0 +1,51 @@
+#ifndef GET_ALL_BRIGHTNESS_H
+#define GET_ALL_BRIGHTNESS_H
+
+#include "../monitor_service.h"
+#include "completion_queue.h"
+#include "request_cancellation.h"
+#include <memory>
+#include <napi.h>
+#include <vector>
+
+// Runs getAll() on the engine's executor and resolves its promise on the JS
+// thread with {success, brightness: {id: level | null}, errors: {id: reason},
+// error}; error is set, and brightness empty, when the request was cancelled.
+class GetAllBrightnessRequest {
+public:
+	static Napi::Promise Start(Napi::Env env, GetBrightnessOptions options, std::shared_ptr<RequestCancellation> request) {
+		if (request) options.cancellation = request->Get();
+		auto deferred = std::make_shared<Napi::Promise::Deferred>(Napi::Promise::Deferred::New(env));
+		CompletionQueue::Sender send = CompletionQueue::For(env).Begin(env);
+
+		GetMonitorService().GetAllBrightness(options, [deferred, send, request](GetAllBrightnessResult values) {
+			send([deferred, request, values](Napi::Env env) {
+				if (request) request->Release();
+
+				Napi::Object result = Napi::Object::New(env);
+				Napi::Object brightness = Napi::Object::New(env);
+				Napi::Object errors = Napi::Object::New(env);
+				bool success = values.error.empty();
+
+				for (const auto &value: values.monitors) {
+					brightness.Set(value.monitorId, value.brightness != -1 ? Napi::Number::New(env, value.brightness) : env.Null());
+					if (!value.error.empty()) {
+						errors.Set(value.monitorId, Napi::String::New(env, value.error));
+						success = false;
+					}
+				}
+
+				result.Set("success", Napi::Boolean::New(env, success));
+				result.Set("brightness", brightness);
+				result.Set("errors", errors);
+				result.Set("error", success || values.error.empty() ? env.Null() : Napi::String::New(env, values.error));
+
+				deferred->Resolve(result);
+			});
+		});
+
+		return deferred->Promise();
+	}
+};
+
+#endif// GET_ALL_BRIGHTNESS_H
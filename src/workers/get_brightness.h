@@ -1,62 +1,53 @@
-#ifndef GET_BRIGHTNESS_WORKER_H
-#define GET_BRIGHTNESS_WORKER_H
-
-#include "../monitor_service.h"
-#include "../utils.h"
-#include <napi.h>
-#include <unordered_map>
-
-class GetBrightnessWorker : public Napi::AsyncWorker {
-public:
-	GetBrightnessWorker(Napi::Env &env, const std::string &monitorId)
-	    : Napi::AsyncWorker(env), deferred(Napi::Promise::Deferred::New(env)), monitorId(monitorId), success(false), brightness(-1) {}
-
-	~GetBrightnessWorker() override {}
-
-	void Execute() override {
-		std::thread thread([&]() {
-			MonitorService *service = new MonitorService();
-			auto monitors = service->GetMonitorRefs();
-
-			if (monitors.empty()) {
-				return;
-			}
-
-			if (monitorId.empty()) {
-				brightness = service->GetMonitorBrightness(monitors.begin()->second);
-				return;
-			}
-
-			auto it = monitors.find(monitorId);
-			if (it != monitors.end()) {
-				brightness = service->GetMonitorBrightness(it->second);
-			}
-		});
-
-		thread.join();
-	}
-
-	void OnOK() override {
-		Napi::HandleScope scope(Env());
-		Napi::Object result = Napi::Object::New(Env());
-
-		success = brightness != -1;
-
-		result.Set("success", Napi::Boolean::New(Env(), success));
-		result.Set("brightness", success ? Napi::Number::New(Env(), brightness) : Env().Null());
-
-		deferred.Resolve(result);
-	}
-
-	Napi::Promise GetPromise() {
-		return deferred.Promise();
-	}
-
-private:
-	Napi::Promise::Deferred deferred;
-	std::string monitorId;
-	bool success;
-	int brightness;
-};
-
-#endif// GET_BRIGHTNESS_WORKER_H
+#ifndef GET_BRIGHTNESS_H
+#define GET_BRIGHTNESS_H
+
+#include "../monitor_service.h"
+#include "completion_queue.h"
+#include "request_cancellation.h"
+#include <cstdint>
+#include <memory>
+#include <napi.h>
+#include <string>
+#include <utility>
+
+// Runs get() on the engine's executor and resolves its promise on the JS
+// thread.
+class GetBrightnessRequest {
+private:
+	// monitor is a monitor id or a handle from lumi.handle().
+	template<typename Target>
+	static Napi::Promise Run(Napi::Env env, const Target &monitor, GetBrightnessOptions options, std::shared_ptr<RequestCancellation> request) {
+		if (request) options.cancellation = request->Get();
+		auto deferred = std::make_shared<Napi::Promise::Deferred>(Napi::Promise::Deferred::New(env));
+		CompletionQueue::Sender send = CompletionQueue::For(env).Begin(env);
+
+		GetMonitorService().GetBrightness(monitor, options, [deferred, send, request](MonitorGetResult value) {
+			send([deferred, request, value](Napi::Env env) {
+				if (request) request->Release();
+
+				Napi::Object result = Napi::Object::New(env);
+				bool success = value.brightness != -1;
+
+				result.Set("success", Napi::Boolean::New(env, success));
+				result.Set("brightness", success ? Napi::Number::New(env, value.brightness) : env.Null());
+				result.Set("error", value.error.empty() ? env.Null() : Napi::String::New(env, value.error));
+
+				deferred->Resolve(result);
+			});
+		});
+
+		return deferred->Promise();
+	}
+
+public:
+	static Napi::Promise Start(Napi::Env env, const std::string &monitorId, const GetBrightnessOptions &options,
+	                           std::shared_ptr<RequestCancellation> request) {
+		return Run(env, monitorId, options, std::move(request));
+	}
+
+	static Napi::Promise Start(Napi::Env env, std::uint32_t handle, const GetBrightnessOptions &options, std::shared_ptr<RequestCancellation> request) {
+		return Run(env, handle, options, std::move(request));
+	}
+};
+
+#endif// GET_BRIGHTNESS_H
@@ -0,0 +1,62 @@
+#ifndef GET_MONITORS_H
+#define GET_MONITORS_H
+
+#include "../monitor_service.h"
+#include "../utils.h"
+#include "completion_queue.h"
+#include <memory>
+#include <napi.h>
+#include <string>
+#include <vector>
+
+// Converts monitors to the JS shape shared by monitors() and monitorsAsync(),
+// and runs the asynchronous enumeration.
+class GetMonitorsRequest {
+public:
+	static Napi::Object ToObject(Napi::Env env, const Monitor &monitor) {
+		Napi::Object result = Napi::Object::New(env);
+		Napi::Object size = Napi::Object::New(env);
+		Napi::Object position = Napi::Object::New(env);
+		result.Set(Napi::String::New(env, "id"), monitor.id);
+		result.Set(Napi::String::New(env, "displayId"), ToNapiString(env, std::to_string(monitor.displayId)));
+		result.Set(Napi::String::New(env, "name"), ToNapiString(env, monitor.name));
+		result.Set(Napi::String::New(env, "manufacturer"), ToNapiString(env, monitor.manufacturer));
+		result.Set(Napi::String::New(env, "serialNumber"), ToNapiString(env, monitor.serialNumber));
+		result.Set(Napi::String::New(env, "productCode"), ToNapiString(env, monitor.productCode));
+		result.Set(Napi::String::New(env, "internal"), Napi::Boolean::New(env, monitor.internal));
+		size.Set(Napi::String::New(env, "width"), Napi::Number::New(env, monitor.size.width));
+		size.Set(Napi::String::New(env, "height"), Napi::Number::New(env, monitor.size.height));
+		position.Set(Napi::String::New(env, "x"), Napi::Number::New(env, monitor.position.x));
+		position.Set(Napi::String::New(env, "y"), Napi::Number::New(env, monitor.position.y));
+		result.Set(Napi::String::New(env, "size"), size);
+		result.Set(Napi::String::New(env, "position"), position);
+		return result;
+	}
+
+	static Napi::Array ToArray(Napi::Env env, const std::vector<Monitor> &monitors) {
+		Napi::Array array = Napi::Array::New(env, monitors.size());
+
+		for (size_t i = 0; i < monitors.size(); ++i) {
+			array.Set(i, ToObject(env, monitors[i]));
+		}
+
+		return array;
+	}
+
+	// Enumerates on the engine's control queue, so building a new topology
+	// never blocks the JS thread.
+	static Napi::Promise Start(Napi::Env env) {
+		auto deferred = std::make_shared<Napi::Promise::Deferred>(Napi::Promise::Deferred::New(env));
+		CompletionQueue::Sender send = CompletionQueue::For(env).Begin(env);
+
+		GetMonitorService().GetAvailableMonitors([deferred, send](std::vector<Monitor> monitors) {
+			send([deferred, monitors](Napi::Env env) {
+				deferred->Resolve(ToArray(env, monitors));
+			});
+		});
+
+		return deferred->Promise();
+	}
+};
+
+#endif// GET_MONITORS_H
@@ -0,0 +1,72 @@
+#ifndef REQUEST_CANCELLATION_H
+#define REQUEST_CANCELLATION_H
+
+#include "../cancellation.h"
+#include <chrono>
+#include <memory>
+#include <napi.h>
+
+// The {timeoutMs, signal} options of a get or set: a deadline counted from the
+// call and an AbortSignal, both feeding one Cancellation the engine checks.
+// The abort listener is removed again once the request has settled, so a
+// signal shared by many calls does not collect them.
+class RequestCancellation {
+private:
+	std::shared_ptr<Cancellation> cancellation;
+	Napi::ObjectReference signal;
+	Napi::FunctionReference listener;
+
+public:
+	// Null when the options ask for neither. Must be called on the JS thread.
+	static std::shared_ptr<RequestCancellation> From(const Napi::Value &options) {
+		if (!options.IsObject()) return nullptr;
+
+		Napi::Object object = options.As<Napi::Object>();
+		Napi::Value timeout = object.Get("timeoutMs");
+		Napi::Value provided = object.Get("signal");
+		bool timed = timeout.IsNumber() && DeadlineAfter(timeout.As<Napi::Number>().DoubleValue()) != Cancellation::Clock::time_point::max();
+		bool signalled = provided.IsObject() && provided.As<Napi::Object>().Get("addEventListener").IsFunction();
+		if (!timed && !signalled) return nullptr;
+
+		auto request = std::make_shared<RequestCancellation>();
+		auto deadline = Cancellation::Clock::time_point::max();
+		if (timed) deadline = DeadlineAfter(timeout.As<Napi::Number>().DoubleValue());
+		request->cancellation = std::make_shared<Cancellation>(deadline);
+
+		if (!signalled) return request;
+
+		Napi::Object target = provided.As<Napi::Object>();
+		if (target.Get("aborted").ToBoolean()) {
+			request->cancellation->Cancel(CancelReason::Aborted);
+			return request;
+		}
+
+		std::weak_ptr<Cancellation> weak = request->cancellation;
+		Napi::Function abort = Napi::Function::New(options.Env(), [weak](const Napi::CallbackInfo &) {
+			if (auto cancellation = weak.lock()) cancellation->Cancel(CancelReason::Aborted);
+		});
+
+		target.Get("addEventListener").As<Napi::Function>().Call(target, {Napi::String::New(options.Env(), "abort"), abort});
+		request->signal = Napi::Persistent(target);
+		request->listener = Napi::Persistent(abort);
+		return request;
+	}
+
+	std::shared_ptr<Cancellation> Get() const {
+		return cancellation;
+	}
+
+	// Removes the abort listener. Must be called on the JS thread.
+	void Release() {
+		if (signal.IsEmpty()) return;
+
+		Napi::Object target = signal.Value();
+		Napi::Value remove = target.Get("removeEventListener");
+		if (remove.IsFunction()) remove.As<Napi::Function>().Call(target, {Napi::String::New(target.Env(), "abort"), listener.Value()});
+
+		signal.Reset();
+		listener.Reset();
+	}
+};
+
+#endif// REQUEST_CANCELLATION_H
@@ -1,76 +1,66 @@
-#ifndef SET_BRIGHTNESS_WORKER_H
-#define SET_BRIGHTNESS_WORKER_H
-
-#include "../monitor_service.h"
-#include "../utils.h"
-#include <napi.h>
-#include <unordered_map>
-
-class SetBrightnessWorker : public Napi::AsyncWorker {
-public:
-	SetBrightnessWorker(Napi::Env &env, std::vector<MonitorBrightnessConfiguration> &configurations)
-	    : Napi::AsyncWorker(env), deferred(Napi::Promise::Deferred::New(env)), configurations(configurations), success(false), message("") {}
-
-	~SetBrightnessWorker() override {}
-
-	void Execute() override {
-		std::thread thread([&]() {
-			MonitorService *service = new MonitorService();
-			auto monitors = service->GetMonitorRefs();
-
-			if (monitors.empty()) {
-				message = "No monitors available.";
-				return;
-			}
-
-			if (!configurations.empty()) {
-				if (configurations.size() == 1) {
-					auto monitorId = configurations[0].monitorId;
-					if (monitorId == "primary") monitorId = monitors.begin()->first;
-					if (monitorId == ALL_MONITORS) {
-						success = service->SetGlobalBrightness(configurations[0].brightness);
-						return;
-					}
-
-					auto it = monitors.find(monitorId);
-					if (it != monitors.end()) {
-						success = service->SetMonitorBrightness(it->second, configurations[0].brightness);
-					}
-				} else {
-					std::vector<bool> results;
-					for (const auto &config: configurations) {
-						auto it = monitors.find(config.monitorId);
-						if (it != monitors.end()) {
-							results.emplace_back(service->SetMonitorBrightness(it->second, config.brightness));
-						}
-					}
-					success = Every(results);
-				}
-			}
-		});
-
-		thread.join();
-	}
-
-	void OnOK() override {
-		Napi::HandleScope scope(Env());
-		Napi::Object result = Napi::Object::New(Env());
-
-		result.Set("success", Napi::Boolean::New(Env(), success));
-		result.Set("message", message.empty() ? Env().Null() : Napi::String::New(Env(), message));
-
-		deferred.Resolve(result);
-	}
-
-	Napi::Promise GetPromise() {
-		return deferred.Promise();
-	}
-
-private:
-	Napi::Promise::Deferred deferred;
-	std::vector<MonitorBrightnessConfiguration> configurations;
-	bool success;
-	std::string message;
-};
-
-#endif// SET_BRIGHTNESS_WORKER_H
+#ifndef SET_BRIGHTNESS_H
+#define SET_BRIGHTNESS_H
+
+#include "../monitor_service.h"
+#include "completion_queue.h"
+#include "request_cancellation.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <napi.h>
+#include <vector>
+
+// Runs set() on the engine's executor and resolves its promise on the JS
+// thread.
+class SetBrightnessRequest {
+private:
+	static std::function<void(SetBrightnessResult)> Resolver(Napi::Env env, std::shared_ptr<Napi::Promise::Deferred> deferred,
+	                                                         std::shared_ptr<RequestCancellation> request) {
+		CompletionQueue::Sender send = CompletionQueue::For(env).Begin(env);
+
+		return [deferred, send, request](SetBrightnessResult value) {
+			send([deferred, request, value](Napi::Env env) {
+				if (request) request->Release();
+
+				Napi::Object result = Napi::Object::New(env);
+
+				result.Set("success", Napi::Boolean::New(env, value.success));
+				result.Set("message", value.message.empty() ? env.Null() : Napi::String::New(env, value.message));
+				result.Set("coalesced", Napi::Boolean::New(env, value.coalesced));
+				result.Set("error", value.error.empty() ? env.Null() : Napi::String::New(env, value.error));
+
+				Napi::Object monitors = Napi::Object::New(env);
+				for (const auto &monitor: value.monitors) {
+					Napi::Object entry = Napi::Object::New(env);
+					entry.Set("success", Napi::Boolean::New(env, monitor.success));
+					entry.Set("coalesced", Napi::Boolean::New(env, monitor.coalesced));
+					entry.Set("error", monitor.error.empty() ? env.Null() : Napi::String::New(env, monitor.error));
+					monitors.Set(monitor.monitorId, entry);
+				}
+				result.Set("monitors", monitors);
+
+				deferred->Resolve(result);
+			});
+		};
+	}
+
+public:
+	static Napi::Promise Start(Napi::Env env, const std::vector<MonitorBrightnessConfiguration> &configurations, SetBrightnessOptions options,
+	                           std::shared_ptr<RequestCancellation> request) {
+		auto deferred = std::make_shared<Napi::Promise::Deferred>(Napi::Promise::Deferred::New(env));
+		if (request) options.cancellation = request->Get();
+		GetMonitorService().SetBrightness(configurations, options, Resolver(env, deferred, request));
+		return deferred->Promise();
+	}
+
+	// set() on a handle from lumi.handle().
+	static Napi::Promise Start(Napi::Env env, std::uint32_t handle, int brightness, SetBrightnessOptions options,
+	                           std::shared_ptr<RequestCancellation> request) {
+		auto deferred = std::make_shared<Napi::Promise::Deferred>(Napi::Promise::Deferred::New(env));
+		if (request) options.cancellation = request->Get();
+		GetMonitorService().SetBrightness(handle, brightness, options, Resolver(env, deferred, request));
+		return deferred->Promise();
+	}
+};
+
+#endif// SET_BRIGHTNESS_H
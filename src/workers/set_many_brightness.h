@@ -0,0 +1,94 @@
+#ifndef SET_MANY_BRIGHTNESS_H
+#define SET_MANY_BRIGHTNESS_H
+
+#include "../monitor_service.h"
+#include "../utils.h"
+#include "completion_queue.h"
+#include "request_cancellation.h"
+#include <cstdint>
+#include <memory>
+#include <napi.h>
+#include <utility>
+#include <vector>
+
+// Runs setMany() on the engine's executor. Handles and levels are read
+// straight from the typed arrays' memory; the statuses are written into the
+// caller's Uint8Array (or a new one) on the JS thread, which the promise then
+// resolves with.
+class SetManyBrightnessRequest {
+public:
+	static Napi::Value Start(const Napi::CallbackInfo &info) {
+		Napi::Env env = info.Env();
+
+		if (!info[0].IsTypedArray() || info[0].As<Napi::TypedArray>().TypedArrayType() != napi_uint32_array ||
+		    !info[1].IsTypedArray() || info[1].As<Napi::TypedArray>().TypedArrayType() != napi_uint8_array) {
+			Napi::TypeError::New(env, "Expected a Uint32Array of handles and a Uint8Array of levels").ThrowAsJavaScriptException();
+			return env.Undefined();
+		}
+
+		Napi::Uint32Array handles = info[0].As<Napi::Uint32Array>();
+		Napi::Uint8Array levels = info[1].As<Napi::Uint8Array>();
+		size_t count = handles.ElementLength();
+
+		if (levels.ElementLength() != count) {
+			Napi::TypeError::New(env, "Expected as many levels as handles").ThrowAsJavaScriptException();
+			return env.Undefined();
+		}
+
+		SetBrightnessOptions options;
+		Napi::Uint8Array status;
+
+		if (info[2].IsObject()) {
+			Napi::Object object = info[2].As<Napi::Object>();
+			Napi::Value provided = object.Get("status");
+			if (object.Get("coalesce").IsBoolean()) options.coalesce = object.Get("coalesce").As<Napi::Boolean>().Value();
+			options.priority = ParsePriority(object);
+
+			if (!provided.IsUndefined()) {
+				if (!provided.IsTypedArray() || provided.As<Napi::TypedArray>().TypedArrayType() != napi_uint8_array) {
+					Napi::TypeError::New(env, "Expected a Uint8Array of statuses").ThrowAsJavaScriptException();
+					return env.Undefined();
+				}
+
+				if (provided.As<Napi::TypedArray>().ElementLength() < count) {
+					Napi::TypeError::New(env, "status buffer shorter than handles").ThrowAsJavaScriptException();
+					return env.Undefined();
+				}
+
+				status = provided.As<Napi::Uint8Array>();
+			}
+		}
+
+		if (status.IsEmpty()) status = Napi::Uint8Array::New(env, count);
+
+		std::shared_ptr<RequestCancellation> request = RequestCancellation::From(info[2]);
+		if (request) options.cancellation = request->Get();
+
+		std::vector<std::pair<std::uint32_t, int>> writes(count);
+		const std::uint32_t *handleData = handles.Data();
+		const std::uint8_t *levelData = levels.Data();
+		for (size_t i = 0; i < count; i++) writes[i] = {handleData[i], levelData[i]};
+
+		auto deferred = std::make_shared<Napi::Promise::Deferred>(Napi::Promise::Deferred::New(env));
+		CompletionQueue::Sender send = CompletionQueue::For(env).Begin(env);
+		// Deleted on the JS thread once the statuses are in.
+		auto *reference = new Napi::Reference<Napi::Uint8Array>(Napi::Persistent(status));
+
+		GetMonitorService().SetManyBrightness(writes, options, [deferred, send, reference, request](std::vector<SetStatus> statuses) {
+			send([deferred, reference, request, statuses](Napi::Env) {
+				if (request) request->Release();
+
+				Napi::Uint8Array status = reference->Value();
+				std::uint8_t *data = status.Data();
+				for (size_t i = 0; i < statuses.size(); i++) data[i] = static_cast<std::uint8_t>(statuses[i]);
+
+				deferred->Resolve(status);
+				delete reference;
+			});
+		});
+
+		return deferred->Promise();
+	}
+};
+
+#endif// SET_MANY_BRIGHTNESS_H
@@ -0,0 +1,42 @@
+#ifndef WATCH_BRIGHTNESS_H
+#define WATCH_BRIGHTNESS_H
+
+#include "../monitor_service.h"
+#include "event_subscription.h"
+#include <napi.h>
+
+// Glue behind lumi.on('brightness'): watchBrightness(callback) returns a
+// handle for unwatchBrightness(handle); the callback receives
+// {id, brightness, source}.
+class WatchBrightnessRequest {
+private:
+	static Napi::Object ToObject(Napi::Env env, const BrightnessChange &change) {
+		Napi::Object result = Napi::Object::New(env);
+		result.Set("id", Napi::String::New(env, change.monitorId));
+		result.Set("brightness", Napi::Number::New(env, change.brightness));
+		result.Set("source", Napi::String::New(env, change.source));
+		return result;
+	}
+
+public:
+	static Napi::Value Start(const Napi::CallbackInfo &info) {
+		EventSubscription *subscription = EventSubscription::Create(info);
+		if (subscription == nullptr) return info.Env().Undefined();
+
+		subscription->id = GetMonitorService().WatchBrightness([subscription](const BrightnessChange &change) {
+			subscription->Emit([change](Napi::Env env) { return ToObject(env, change); });
+		});
+
+		return subscription->Handle(info.Env());
+	}
+
+	static Napi::Value Stop(const Napi::CallbackInfo &info) {
+		EventSubscription *subscription = EventSubscription::FromHandle(info[0]);
+		if (subscription != nullptr) {
+			GetMonitorService().UnwatchBrightness(subscription->id, [subscription]() { subscription->Finish(); });
+		}
+		return info.Env().Undefined();
+	}
+};
+
+#endif// WATCH_BRIGHTNESS_H
@@ -0,0 +1,42 @@
+#ifndef WATCH_TOPOLOGY_H
+#define WATCH_TOPOLOGY_H
+
+#include "../monitor_service.h"
+#include "event_subscription.h"
+#include "get_monitors.h"
+#include <napi.h>
+
+// Glue behind lumi.on('topology'): watchTopology(callback) returns a handle
+// for unwatchTopology(handle); the callback receives {added, removed, changed}.
+class WatchTopologyRequest {
+private:
+	static Napi::Object ToObject(Napi::Env env, const TopologyChange &change) {
+		Napi::Object result = Napi::Object::New(env);
+		result.Set("added", GetMonitorsRequest::ToArray(env, change.added));
+		result.Set("removed", GetMonitorsRequest::ToArray(env, change.removed));
+		result.Set("changed", GetMonitorsRequest::ToArray(env, change.changed));
+		return result;
+	}
+
+public:
+	static Napi::Value Start(const Napi::CallbackInfo &info) {
+		EventSubscription *subscription = EventSubscription::Create(info);
+		if (subscription == nullptr) return info.Env().Undefined();
+
+		subscription->id = GetMonitorService().WatchTopology([subscription](const TopologyChange &change) {
+			subscription->Emit([change](Napi::Env env) { return ToObject(env, change); });
+		});
+
+		return subscription->Handle(info.Env());
+	}
+
+	static Napi::Value Stop(const Napi::CallbackInfo &info) {
+		EventSubscription *subscription = EventSubscription::FromHandle(info[0]);
+		if (subscription != nullptr) {
+			GetMonitorService().UnwatchTopology(subscription->id, [subscription]() { subscription->Finish(); });
+		}
+		return info.Env().Undefined();
+	}
+};
+
+#endif// WATCH_TOPOLOGY_H
@@ -0,0 +1,86 @@
+#ifndef WRITE_COALESCER_H
+#define WRITE_COALESCER_H
+
+#include "priority.h"
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+enum class WriteOutcome {
+	Failed,
+	Written,
+	// A newer write to the same monitor arrived before this one started.
+	Coalesced,
+	// Not attempted because the monitor's circuit is open.
+	Rejected
+};
+
+// Latest-value-wins writes per key on top of a serialized queue. A key has at
+// most one write waiting in the queue; submitting another one while it waits
+// replaces it, and the replaced write completes as coalesced without touching
+// the hardware. A replacing write of higher priority posts its key again at
+// that priority, so it does not wait behind the lower priority one's slot.
+// The write that runs reports its own outcome, which may be Coalesced too if
+// something outside the coalescer overtook it.
+class WriteCoalescer {
+public:
+	typedef std::function<WriteOutcome()> Write;
+	typedef std::function<void(WriteOutcome)> Done;
+	typedef std::function<void(std::function<void()>)> Post;
+
+private:
+	struct Slot {
+		bool queued = false;
+		Priority priority = Priority::Normal;
+		Write write;
+		Done done;
+	};
+
+	std::mutex mutex;
+	std::unordered_map<std::string, Slot> slots;
+
+	void Run(const std::string &key) {
+		Write write;
+		Done done;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			Slot &slot = slots[key];
+			// Already run from a task posted at a higher priority.
+			if (!slot.queued) return;
+			slot.queued = false;
+			write = std::move(slot.write);
+			done = std::move(slot.done);
+		}
+
+		done(write());
+	}
+
+public:
+	// post enqueues a task on the queue serving key, at priority.
+	void Submit(const std::string &key, Write write, Done done, const Post &post, Priority priority = Priority::Normal) {
+		Done replaced;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			Slot &slot = slots[key];
+
+			if (slot.queued) replaced = std::move(slot.done);
+
+			slot.write = std::move(write);
+			slot.done = std::move(done);
+
+			if (!slot.queued || priority < slot.priority) {
+				slot.queued = true;
+				slot.priority = priority;
+				post([this, key]() { Run(key); });
+			}
+		}
+
+		if (replaced) replaced(WriteOutcome::Coalesced);
+	}
+};
+
+#endif// WRITE_COALESCER_H
@@ -0,0 +1,55 @@
+#include "adaptive_poller.h"
+#include "test.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+TEST(AdaptivePollerBacksOffWhileUnchanged) {
+	std::atomic<int> polls{0};
+	AdaptivePoller poller([&](const std::string &, AdaptivePoller::Done done) {
+		polls++;
+		done(false);
+	},
+	                      std::chrono::milliseconds(5), std::chrono::milliseconds(40));
+
+	poller.SetKeys({"a"});
+	std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+	// 5 + 10 + 20 + 40 ms, then every 40 ms: a handful of polls, not 60.
+	EXPECT(polls >= 4);
+	EXPECT(polls <= 12);
+	EXPECT(poller.GetInterval("a") == std::chrono::milliseconds(40));
+}
+
+TEST(AdaptivePollerSpeedsUpAfterChange) {
+	std::atomic<bool> changing{false};
+	AdaptivePoller poller([&](const std::string &, AdaptivePoller::Done done) { done(changing); },
+	                      std::chrono::milliseconds(5), std::chrono::milliseconds(20));
+
+	poller.SetKeys({"a"});
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	EXPECT(poller.GetInterval("a") == std::chrono::milliseconds(20));
+
+	changing = true;
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	EXPECT(poller.GetInterval("a") == std::chrono::milliseconds(5));
+}
+
+TEST(AdaptivePollerToleratesLateCallbacks) {
+	AdaptivePoller::Done pending;
+
+	{
+		std::atomic<bool> polled{false};
+		AdaptivePoller poller([&](const std::string &, AdaptivePoller::Done done) {
+			pending = done;
+			polled = true;
+		},
+		                      std::chrono::milliseconds(1), std::chrono::milliseconds(1));
+
+		poller.SetKeys({"a"});
+		while (!polled) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	// The poller is gone; reporting must be a no-op.
+	pending(true);
+}
@@ -0,0 +1,170 @@
+#include "backends/simulated_backend.h"
+#include "cancellation.h"
+#include "monitor_service.h"
+#include "test.h"
+#include <chrono>
+#include <future>
+#include <limits>
+#include <memory>
+#include <string>
+#include <thread>
+
+static std::shared_ptr<Cancellation> After(std::chrono::milliseconds timeout) {
+	return std::make_shared<Cancellation>(Cancellation::Clock::now() + timeout);
+}
+
+TEST(CancellableCompletesOnce) {
+	auto cancellation = std::make_shared<Cancellation>();
+	int calls = 0;
+	int last = 0;
+
+	auto done = Cancellable<int>(cancellation, [&](int value) { calls++; last = value; }, [](CancelReason reason) {
+		return reason == CancelReason::Aborted ? -2 : -3;
+	});
+
+	EXPECT(cancellation->Cancel(CancelReason::Aborted));
+	EXPECT(!cancellation->Cancel(CancelReason::Timeout));
+	done(5);
+
+	EXPECT_EQ(calls, 1);
+	EXPECT_EQ(last, -2);
+	EXPECT(cancellation->GetReason() == CancelReason::Aborted);
+
+	// Without a cancellation done is used as is.
+	auto plain = Cancellable<int>(nullptr, [&](int value) { last = value; }, [](CancelReason) { return 0; });
+	plain(7);
+	EXPECT_EQ(last, 7);
+}
+
+TEST(CancellationTimesOutAtDeadline) {
+	auto cancellation = After(std::chrono::milliseconds(20));
+	EXPECT(!cancellation->IsCancelled());
+
+	// Noticed when checked, even without a timer.
+	std::this_thread::sleep_for(std::chrono::milliseconds(30));
+	EXPECT(cancellation->IsCancelled());
+	EXPECT(cancellation->GetReason() == CancelReason::Timeout);
+
+	DeadlineTimer timer;
+	std::promise<CancelReason> fired;
+	auto timed = After(std::chrono::milliseconds(20));
+	timed->OnCancel([&](CancelReason reason) { fired.set_value(reason); });
+	timer.Schedule(timed);
+
+	auto result = fired.get_future();
+	EXPECT(result.wait_for(std::chrono::seconds(1)) == std::future_status::ready);
+	EXPECT(result.get() == CancelReason::Timeout);
+	EXPECT_EQ(timer.GetPendingCount(), size_t(0));
+}
+
+TEST(DeadlineTimerUnschedulesFinishedRequests) {
+	DeadlineTimer timer;
+	auto token = timer.Schedule(After(std::chrono::hours(1)));
+	EXPECT(token != 0);
+	EXPECT_EQ(timer.Schedule(std::make_shared<Cancellation>()), DeadlineTimer::Token(0));
+	EXPECT_EQ(timer.GetPendingCount(), size_t(1));
+
+	timer.Unschedule(token);
+	timer.Unschedule(token);
+	EXPECT_EQ(timer.GetPendingCount(), size_t(0));
+}
+
+TEST(DeadlineAfterIgnoresUnboundedTimeouts) {
+	auto none = Cancellation::Clock::time_point::max();
+
+	EXPECT(DeadlineAfter(std::numeric_limits<double>::infinity()) == none);
+	EXPECT(DeadlineAfter(std::numeric_limits<double>::quiet_NaN()) == none);
+	EXPECT(DeadlineAfter(1e300) == none);
+	EXPECT(DeadlineAfter(MAX_TIMEOUT_MS + 1) == none);
+
+	auto before = Cancellation::Clock::now();
+	auto deadline = DeadlineAfter(MAX_TIMEOUT_MS);
+	EXPECT(deadline != none);
+	EXPECT(deadline > before + std::chrono::hours(24 * 24));
+	auto due = DeadlineAfter(-5);
+	EXPECT(due <= Cancellation::Clock::now());
+}
+
+TEST(MonitorServiceDropsTimedOutReadBeforeBus) {
+	SimulatedBackendOptions options;
+	options.monitors = 1;
+	options.getLatency = std::chrono::milliseconds(200);
+	auto backend = std::make_shared<SimulatedBackend>(options);
+	MonitorService service(backend);
+	std::string id = SimulatedBackend::IdForIndex(0);
+	service.GetTopology();
+
+	// The first read holds the bus; the second times out queued behind it.
+	std::promise<MonitorGetResult> first;
+	std::promise<MonitorGetResult> second;
+	service.GetBrightness(id, {true}, [&](MonitorGetResult value) { first.set_value(value); });
+
+	auto started = std::chrono::steady_clock::now();
+	service.GetBrightness(id, {true, After(std::chrono::milliseconds(30))}, [&](MonitorGetResult value) { second.set_value(value); });
+	MonitorGetResult timedOut = second.get_future().get();
+
+	EXPECT(std::chrono::steady_clock::now() - started < std::chrono::milliseconds(150));
+	EXPECT_EQ(timedOut.brightness, -1);
+	EXPECT_EQ(timedOut.error, std::string("TIMEOUT"));
+
+	EXPECT(first.get_future().get().brightness != -1);
+	EXPECT_EQ(service.GetBrightness(id), 50);
+	EXPECT_EQ(backend->GetOperationCount(0), 1);
+
+	// A read whose signal already fired completes right away with its own
+	// code.
+	auto aborted = std::make_shared<Cancellation>();
+	aborted->Cancel(CancelReason::Aborted);
+	std::promise<MonitorGetResult> third;
+	service.GetBrightness(id, {true, aborted}, [&](MonitorGetResult value) { third.set_value(value); });
+	EXPECT_EQ(third.get_future().get().error, std::string("ABORTED"));
+	EXPECT_EQ(backend->GetOperationCount(0), 1);
+}
+
+TEST(MonitorServiceForgetsDeadlinesOfFinishedRequests) {
+	SimulatedBackendOptions options;
+	options.monitors = 1;
+	auto backend = std::make_shared<SimulatedBackend>(options);
+	MonitorService service(backend);
+	std::string id = SimulatedBackend::IdForIndex(0);
+
+	EXPECT_EQ(service.GetBrightness(id, {true, After(std::chrono::hours(1))}), 50);
+
+	SetBrightnessOptions timed;
+	timed.cancellation = After(std::chrono::hours(1));
+	EXPECT(service.SetBrightness({{id, 30}}, timed).success);
+
+	auto aborted = After(std::chrono::hours(1));
+	std::promise<MonitorGetResult> pending;
+	service.GetBrightness(id, {true, aborted}, [&](MonitorGetResult value) { pending.set_value(value); });
+	aborted->Cancel(CancelReason::Aborted);
+	pending.get_future().get();
+
+	EXPECT_EQ(service.GetPendingDeadlineCount(), size_t(0));
+}
+
+TEST(MonitorServiceDropsTimedOutWrite) {
+	SimulatedBackendOptions options;
+	options.monitors = 1;
+	options.setLatency = std::chrono::milliseconds(200);
+	auto backend = std::make_shared<SimulatedBackend>(options);
+	MonitorService service(backend);
+	std::string id = SimulatedBackend::IdForIndex(0);
+	service.GetTopology();
+
+	std::promise<SetBrightnessResult> first;
+	service.SetBrightness({{id, 20}}, {false}, [&](SetBrightnessResult value) { first.set_value(value); });
+
+	SetBrightnessOptions timed;
+	timed.coalesce = false;
+	timed.cancellation = After(std::chrono::milliseconds(30));
+	SetBrightnessResult result = service.SetBrightness({{id, 80}}, timed);
+
+	EXPECT(!result.success);
+	EXPECT_EQ(result.error, std::string("TIMEOUT"));
+	EXPECT(first.get_future().get().success);
+
+	// The cancelled write never reached the monitor.
+	EXPECT_EQ(service.GetBrightness(id, {true}), 20);
+	EXPECT_EQ(backend->GetOperationCount(0), 2);
+}
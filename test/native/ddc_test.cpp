@@ -0,0 +1,232 @@
+#include "backends/ddc_backend.h"
+#include "ddc/ddc_bus_scheduler.h"
+#include "ddc/ddc_ci.h"
+#include "ddc/emulated_ddc_monitor.h"
+#include "test.h"
+#include <map>
+#include <thread>
+
+struct EmulatedBuses {
+	EmulatedDdcOptions options;
+	std::map<std::string, EmulatedDdcMonitor *> monitors;
+	int opened = 0;
+
+	DdcTransportFactory Factory() {
+		return [this](const std::string &bus) -> std::unique_ptr<DdcTransport> {
+			auto monitor = std::make_unique<EmulatedDdcMonitor>(options);
+			monitors[bus] = monitor.get();
+			opened++;
+			return monitor;
+		};
+	}
+};
+
+TEST(DdcCiEncodesGetVcpRequest) {
+	auto message = DdcCi::EncodeGetVcp(DdcCi::VCP_BRIGHTNESS);
+	EXPECT(message == std::vector<uint8_t>({0x51, 0x82, 0x01, 0x10, 0xAC}));
+}
+
+TEST(DdcCiEncodesSetVcpRequest) {
+	auto message = DdcCi::EncodeSetVcp(DdcCi::VCP_BRIGHTNESS, 50);
+	EXPECT(message == std::vector<uint8_t>({0x51, 0x84, 0x03, 0x10, 0x00, 0x32, 0x9A}));
+}
+
+TEST(DdcCiDecodesGetVcpReply) {
+	auto reply = DdcCi::EncodeGetVcpReply(DdcCi::VCP_BRIGHTNESS, true, {70, 100});
+	DdcCi::VcpValue value;
+
+	EXPECT(DdcCi::DecodeGetVcpReply(reply.data(), reply.size(), DdcCi::VCP_BRIGHTNESS, value));
+	EXPECT_EQ(value.current, uint16_t(70));
+	EXPECT_EQ(value.maximum, uint16_t(100));
+}
+
+TEST(DdcCiRejectsInvalidReplies) {
+	DdcCi::VcpValue value;
+
+	auto corrupt = DdcCi::EncodeGetVcpReply(DdcCi::VCP_BRIGHTNESS, true, {70, 100});
+	corrupt[8] ^= 0x01;
+	EXPECT(!DdcCi::DecodeGetVcpReply(corrupt.data(), corrupt.size(), DdcCi::VCP_BRIGHTNESS, value));
+
+	auto unsupported = DdcCi::EncodeGetVcpReply(DdcCi::VCP_BRIGHTNESS, false, {0, 0});
+	EXPECT(!DdcCi::DecodeGetVcpReply(unsupported.data(), unsupported.size(), DdcCi::VCP_BRIGHTNESS, value));
+
+	auto otherCode = DdcCi::EncodeGetVcpReply(0x12, true, {70, 100});
+	EXPECT(!DdcCi::DecodeGetVcpReply(otherCode.data(), otherCode.size(), DdcCi::VCP_BRIGHTNESS, value));
+
+	uint8_t null[DdcCi::GET_VCP_REPLY_LENGTH] = {0x6E, 0x80, 0xBE};
+	EXPECT(!DdcCi::DecodeGetVcpReply(null, sizeof(null), DdcCi::VCP_BRIGHTNESS, value));
+}
+
+TEST(DdcCiChannelTalksToEmulatedMonitor) {
+	EmulatedDdcMonitor monitor({std::chrono::microseconds(0), 0, 30, 100, 1});
+	DdcCi::Channel channel(&monitor, std::chrono::microseconds(0));
+	DdcCi::VcpValue value;
+
+	EXPECT(channel.GetVcp(DdcCi::VCP_BRIGHTNESS, value));
+	EXPECT_EQ(value.current, uint16_t(30));
+
+	EXPECT(channel.SetVcp(DdcCi::VCP_BRIGHTNESS, 80));
+	EXPECT_EQ(monitor.GetBrightness(), uint16_t(80));
+
+	EXPECT(!channel.GetVcp(0x12, value));
+}
+
+TEST(EmulatedDdcMonitorNaksTimingViolations) {
+	EmulatedDdcOptions options;
+	options.minReplyDelay = std::chrono::milliseconds(5);
+	options.minCommandGap = std::chrono::milliseconds(10);
+	EmulatedDdcMonitor monitor(options);
+	DdcCi::Channel hasty(&monitor, std::chrono::microseconds(0));
+	DdcCi::VcpValue value;
+
+	// The reply is read too early, and the next request comes while the
+	// display is still preparing it.
+	EXPECT(!hasty.GetVcp(DdcCi::VCP_BRIGHTNESS, value));
+	EXPECT(!hasty.SetVcp(DdcCi::VCP_BRIGHTNESS, 20));
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	EXPECT(hasty.SetVcp(DdcCi::VCP_BRIGHTNESS, 20));
+	EXPECT(!hasty.SetVcp(DdcCi::VCP_BRIGHTNESS, 30));
+	EXPECT_EQ(monitor.GetBrightness(), uint16_t(20));
+	EXPECT_EQ(monitor.timingViolations.load(), 3);
+}
+
+TEST(DdcBusSchedulerKeepsDisplayTiming) {
+	EmulatedDdcOptions options;
+	options.minReplyDelay = std::chrono::milliseconds(3);
+	options.minCommandGap = std::chrono::milliseconds(5);
+	EmulatedDdcMonitor monitor(options);
+	DdcBusScheduler scheduler(&monitor, {std::chrono::milliseconds(3), std::chrono::milliseconds(5)});
+	DdcCi::VcpValue value;
+
+	EXPECT(scheduler.GetVcp(DdcCi::VCP_BRIGHTNESS, value));
+
+	auto start = std::chrono::steady_clock::now();
+	for (uint16_t i = 1; i <= 10; i++) EXPECT(scheduler.SetVcp(DdcCi::VCP_BRIGHTNESS, i * 10));
+	EXPECT(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(50));
+
+	// Read back while the bus settles: answered from the write.
+	int reads = monitor.reads;
+	EXPECT(scheduler.GetVcp(DdcCi::VCP_BRIGHTNESS, value));
+	EXPECT_EQ(value.current, uint16_t(100));
+	EXPECT_EQ(value.maximum, uint16_t(100));
+	EXPECT_EQ(monitor.reads.load(), reads);
+	EXPECT_EQ(scheduler.merged, std::uint64_t(1));
+
+	// Later reads go to the display again.
+	std::this_thread::sleep_for(std::chrono::milliseconds(6));
+	EXPECT(scheduler.GetVcp(DdcCi::VCP_BRIGHTNESS, value));
+	EXPECT_EQ(monitor.reads.load(), reads + 1);
+	EXPECT_EQ(value.current, uint16_t(100));
+	EXPECT_EQ(monitor.timingViolations.load(), 0);
+	EXPECT_EQ(scheduler.transactions, std::uint64_t(12));
+}
+
+TEST(DdcBackendPacesEachBus) {
+	RetryPolicy once;
+	once.attempts = 1;
+	DdcTiming timing{std::chrono::milliseconds(3), std::chrono::milliseconds(5)};
+
+	EmulatedBuses paced;
+	paced.options.minReplyDelay = timing.replyDelay;
+	paced.options.minCommandGap = timing.commandGap;
+	DdcBackend backend(FixturePath("sysfs").string(), paced.Factory(), timing);
+	backend.SetRetryPolicy(once);
+	auto refs = backend.GetMonitorRefs();
+
+	for (int i = 0; i < 6; i++) {
+		EXPECT(backend.SetMonitorBrightness(refs[i % 2], i * 10));
+		EXPECT(backend.SetMonitorBrightness(refs[i % 2], i * 10 + 5));
+		EXPECT_EQ(backend.GetMonitorBrightness(refs[i % 2]), i * 10 + 5);
+	}
+
+	EXPECT_EQ(paced.monitors["i2c-5"]->timingViolations.load(), 0);
+	EXPECT_EQ(paced.monitors["i2c-6"]->timingViolations.load(), 0);
+
+	// Without pacing the same display rejects back-to-back commands.
+	EmulatedBuses hasty;
+	hasty.options = paced.options;
+	DdcBackend unpaced(FixturePath("sysfs").string(), hasty.Factory(), DdcTiming::Immediate());
+	unpaced.SetRetryPolicy(once);
+	refs = unpaced.GetMonitorRefs();
+
+	EXPECT_EQ(unpaced.GetMonitorBrightness(refs[0]), -1);
+	EXPECT(hasty.monitors["i2c-5"]->timingViolations > 0);
+}
+
+TEST(DdcBackendMapsConnectorsToBuses) {
+	EmulatedBuses buses;
+	DdcBackend backend(FixturePath("sysfs").string(), buses.Factory(), DdcTiming::Immediate());
+
+	auto refs = backend.GetMonitorRefs();
+
+	EXPECT_EQ(refs.size(), size_t(2));
+	EXPECT_EQ(refs[0].id, std::string("card0-DP-1"));
+	EXPECT_EQ(refs[0].name, std::string("DP-1"));
+	EXPECT_EQ(refs[1].id, std::string("card0-DP-2"));
+	EXPECT_EQ(buses.monitors.size(), size_t(2));
+	EXPECT(buses.monitors.count("i2c-5") == 1);
+	EXPECT(buses.monitors.count("i2c-6") == 1);
+
+	auto monitors = backend.GetAvailableMonitors(refs);
+	EXPECT(!monitors[0].internal);
+
+	// Identity comes from the connector's EDID where there is one.
+	EXPECT_EQ(monitors[0].name, std::string("DELL U2720Q"));
+	EXPECT_EQ(monitors[0].manufacturer, std::string("DEL"));
+	EXPECT_EQ(monitors[0].productCode, std::string("A0F6"));
+	EXPECT_EQ(monitors[0].serialNumber, std::string("CN0ABC123"));
+	EXPECT_EQ(monitors[1].name, std::string("DP-2"));
+	EXPECT(monitors[1].manufacturer.empty());
+}
+
+TEST(DdcBackendScalesBrightness) {
+	EmulatedBuses buses;
+	buses.options.brightness = 50;
+	buses.options.maxBrightness = 200;
+	DdcBackend backend(FixturePath("sysfs").string(), buses.Factory(), DdcTiming::Immediate());
+	auto refs = backend.GetMonitorRefs();
+
+	EXPECT_EQ(backend.GetMonitorBrightness(refs[0]), 25);
+	EXPECT(backend.SetMonitorBrightness(refs[0], 60));
+	EXPECT_EQ(buses.monitors["i2c-5"]->GetBrightness(), uint16_t(120));
+	EXPECT_EQ(backend.GetMonitorBrightness(refs[0]), 60);
+}
+
+TEST(DdcBackendReusesBusTransports) {
+	EmulatedBuses buses;
+	DdcBackend backend(FixturePath("sysfs").string(), buses.Factory(), DdcTiming::Immediate());
+
+	for (int i = 0; i < 5; i++) {
+		auto refs = backend.GetMonitorRefs();
+		EXPECT(backend.SetMonitorBrightness(refs[i % 2], i * 10));
+		EXPECT_EQ(backend.GetMonitorBrightness(refs[i % 2]), i * 10);
+	}
+
+	EXPECT_EQ(buses.opened, 2);
+}
+
+TEST(DdcBackendRetriesNakedTransactions) {
+	EmulatedBuses buses;
+	buses.options.nakRate = 0.2;
+	buses.options.brightness = 40;
+	DdcBackend backend(FixturePath("sysfs").string(), buses.Factory(), DdcTiming::Immediate(), 10);
+	auto refs = backend.GetMonitorRefs();
+
+	for (int i = 0; i < 20; i++) {
+		EXPECT_EQ(backend.GetMonitorBrightness(refs[0]), 40);
+	}
+
+	EXPECT(buses.monitors["i2c-5"]->naks > 0);
+}
+
+TEST(DdcBackendWaitsForReplies) {
+	EmulatedBuses buses;
+	buses.options.latency = std::chrono::milliseconds(2);
+	DdcBackend backend(FixturePath("sysfs").string(), buses.Factory(), {std::chrono::milliseconds(5), std::chrono::microseconds(0)});
+	auto refs = backend.GetMonitorRefs();
+
+	auto start = std::chrono::steady_clock::now();
+	EXPECT_EQ(backend.GetMonitorBrightness(refs[1]), 50);
+	EXPECT(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(9));
+}
@@ -0,0 +1,104 @@
+#include "edid.h"
+#include "test.h"
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+static std::vector<uint8_t> ReadEdid(const std::string &name) {
+	std::ifstream stream(FixturePath("edid") / name, std::ios::binary);
+	return std::vector<uint8_t>(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+}
+
+TEST(EdidDecodesExternalMonitor) {
+	auto data = ReadEdid("dell-u2720q.bin");
+	Edid::Info info;
+
+	EXPECT_EQ(data.size(), size_t(256));
+	EXPECT(Edid::Parse(data.data(), data.size(), info));
+	EXPECT_EQ(std::string(info.manufacturer), std::string("DEL"));
+	EXPECT_EQ(Edid::ProductCodeString(info), std::string("A0F6"));
+	EXPECT_EQ(info.serialNumber, uint32_t(0x42504C4C));
+	EXPECT(info.serial == "CN0ABC123");
+	EXPECT(info.name == "DELL U2720Q");
+	EXPECT_EQ(Edid::SerialString(info), std::string("CN0ABC123"));
+	EXPECT_EQ(info.year, uint16_t(2021));
+	EXPECT_EQ(int(info.week), 20);
+	EXPECT_EQ(int(info.version), 1);
+	EXPECT_EQ(int(info.revision), 4);
+	EXPECT(info.digital);
+	EXPECT_EQ(int(info.widthCm), 60);
+	EXPECT_EQ(int(info.heightCm), 34);
+	EXPECT_EQ(int(info.extensions), 1);
+
+	EXPECT(info.hasPreferredTiming);
+	EXPECT_EQ(info.preferredTiming.width, uint16_t(3840));
+	EXPECT_EQ(info.preferredTiming.height, uint16_t(2160));
+	EXPECT_EQ(info.preferredTiming.pixelClockKHz, uint32_t(533250));
+	EXPECT_EQ(info.preferredTiming.refreshMilliHz, uint32_t(59997));
+	EXPECT_EQ(info.preferredTiming.widthMm, uint16_t(597));
+	EXPECT_EQ(info.preferredTiming.heightMm, uint16_t(336));
+	EXPECT(!info.preferredTiming.interlaced);
+
+	// Strings are views into the input, not copies.
+	EXPECT(info.name.data() >= reinterpret_cast<const char *>(data.data()));
+	EXPECT(info.name.data() < reinterpret_cast<const char *>(data.data() + data.size()));
+}
+
+TEST(EdidFallsBackToNumericSerial) {
+	auto data = ReadEdid("lg-27gl850.bin");
+	Edid::Info info;
+
+	EXPECT(Edid::Parse(data.data(), data.size(), info));
+	EXPECT_EQ(std::string(info.manufacturer), std::string("GSM"));
+	EXPECT(info.name == "LG ULTRAGEAR");
+	EXPECT(info.serial.empty());
+	EXPECT_EQ(Edid::SerialString(info), std::string("500637"));
+	EXPECT_EQ(info.preferredTiming.width, uint16_t(2560));
+	EXPECT_EQ(info.preferredTiming.refreshMilliHz / 1000, uint32_t(144));
+}
+
+TEST(EdidReadsPanelTextDescriptors) {
+	auto data = ReadEdid("boe-ne135fbm.bin");
+	Edid::Info info;
+
+	// Laptop panels usually carry two text descriptors instead of a name; the
+	// second timing is a low refresh mode, not the preferred one.
+	EXPECT(Edid::Parse(data.data(), data.size(), info));
+	EXPECT_EQ(std::string(info.manufacturer), std::string("BOE"));
+	EXPECT_EQ(Edid::ProductCodeString(info), std::string("0747"));
+	EXPECT(info.name.empty());
+	EXPECT(info.text == "BOE CQ");
+	EXPECT_EQ(Edid::SerialString(info), std::string("0"));
+	EXPECT_EQ(info.preferredTiming.width, uint16_t(2256));
+	EXPECT_EQ(info.preferredTiming.height, uint16_t(1504));
+	EXPECT_EQ(info.preferredTiming.refreshMilliHz / 1000, uint32_t(60));
+	EXPECT_EQ(info.preferredTiming.widthMm, uint16_t(285));
+}
+
+TEST(EdidReadsAnalogDisplayWithoutSize) {
+	auto data = ReadEdid("linux-xga.bin");
+	Edid::Info info;
+
+	EXPECT(Edid::Parse(data.data(), data.size(), info));
+	EXPECT_EQ(std::string(info.manufacturer), std::string("LNX"));
+	EXPECT(info.name == "Linux XGA");
+	EXPECT(!info.digital);
+	EXPECT_EQ(int(info.widthCm), 0);
+	EXPECT_EQ(info.preferredTiming.width, uint16_t(1024));
+	EXPECT_EQ(info.preferredTiming.refreshMilliHz, uint32_t(60004));
+}
+
+TEST(EdidRejectsDamagedInput) {
+	Edid::Info info;
+
+	auto truncated = ReadEdid("truncated.bin");
+	EXPECT(!Edid::Parse(truncated.data(), truncated.size(), info));
+
+	auto corrupted = ReadEdid("bad-checksum.bin");
+	EXPECT(!Edid::Parse(corrupted.data(), corrupted.size(), info));
+
+	auto data = ReadEdid("lg-27gl850.bin");
+	data[0] = 0x01;
+	EXPECT(!Edid::Parse(data.data(), data.size(), info));
+	EXPECT(!Edid::Parse(nullptr, 0, info));
+}
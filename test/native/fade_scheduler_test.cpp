@@ -0,0 +1,108 @@
+#include "backends/simulated_backend.h"
+#include "monitor_service.h"
+#include "test.h"
+#include <chrono>
+#include <future>
+#include <thread>
+
+static std::shared_ptr<SimulatedBackend> FadeBackend(int setLatency) {
+	SimulatedBackendOptions options;
+	options.monitors = 2;
+	options.setLatency = std::chrono::milliseconds(setLatency);
+	return std::make_shared<SimulatedBackend>(options);
+}
+
+TEST(FadeEasingStartsAndEndsOnTarget) {
+	for (FadeEasing easing: {FadeEasing::Linear, FadeEasing::EaseIn, FadeEasing::EaseOut, FadeEasing::EaseInOut}) {
+		EXPECT_EQ(Ease(easing, 0.0), 0.0);
+		EXPECT_EQ(Ease(easing, 1.0), 1.0);
+		EXPECT(Ease(easing, 0.25) < Ease(easing, 0.75));
+	}
+}
+
+TEST(FadeReachesTargetAndResolves) {
+	auto backend = FadeBackend(0);
+	MonitorService service(backend);
+	std::string id = SimulatedBackend::IdForIndex(0);
+	std::promise<FadeStatus> done;
+
+	EXPECT(service.Fade(id, 90, std::chrono::milliseconds(100), FadeEasing::EaseInOut, [&](FadeStatus status) { done.set_value(status); }) != 0);
+
+	EXPECT(done.get_future().get() == FadeStatus::Completed);
+	EXPECT_EQ(service.GetBrightness(id, {true}), 90);
+	// Stepped on frame boundaries rather than one write per level.
+	EXPECT(backend->GetOperationCount(0) > 2);
+	EXPECT(backend->GetOperationCount(0) < 40);
+}
+
+TEST(FadeSkipsStepsOnSlowMonitor) {
+	auto backend = FadeBackend(40);
+	MonitorService service(backend);
+	std::string id = SimulatedBackend::IdForIndex(0);
+	std::promise<FadeStatus> done;
+
+	auto started = std::chrono::steady_clock::now();
+	service.Fade(id, 0, std::chrono::milliseconds(200), FadeEasing::Linear, [&](FadeStatus status) { done.set_value(status); });
+
+	EXPECT(done.get_future().get() == FadeStatus::Completed);
+	auto elapsed = std::chrono::steady_clock::now() - started;
+
+	// Ten or so 40 ms writes fit into 200 ms; the fade must not queue one per
+	// 16 ms frame and overrun.
+	EXPECT(backend->GetOperationCount(0) <= 8);
+	EXPECT(elapsed < std::chrono::milliseconds(400));
+	EXPECT_EQ(service.GetBrightness(id, {true}), 0);
+}
+
+TEST(FadeIsSupersededByNewerFade) {
+	auto backend = FadeBackend(5);
+	MonitorService service(backend);
+	std::string id = SimulatedBackend::IdForIndex(1);
+	std::promise<FadeStatus> first;
+	std::promise<FadeStatus> second;
+
+	service.Fade(id, 100, std::chrono::milliseconds(500), FadeEasing::Linear, [&](FadeStatus status) { first.set_value(status); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	service.Fade(id, 10, std::chrono::milliseconds(50), FadeEasing::Linear, [&](FadeStatus status) { second.set_value(status); });
+
+	EXPECT(first.get_future().get() == FadeStatus::Superseded);
+	EXPECT(second.get_future().get() == FadeStatus::Completed);
+	EXPECT_EQ(service.GetBrightness(id, {true}), 10);
+}
+
+TEST(FadeCanBeCancelled) {
+	auto backend = FadeBackend(5);
+	MonitorService service(backend);
+	std::string id = SimulatedBackend::IdForIndex(0);
+	std::promise<FadeStatus> done;
+
+	auto fade = service.Fade(id, 100, std::chrono::milliseconds(1000), FadeEasing::Linear, [&](FadeStatus status) { done.set_value(status); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+	EXPECT(service.CancelFade(fade));
+	EXPECT(done.get_future().get() == FadeStatus::Cancelled);
+	EXPECT(!service.CancelFade(fade));
+	EXPECT(service.GetBrightness(id, {true}) < 100);
+}
+
+TEST(FadeStepsShareTheBusQueue) {
+	SimulatedBackendOptions options;
+	options.monitors = 1;
+	options.getLatency = std::chrono::milliseconds(10);
+	options.setLatency = std::chrono::milliseconds(10);
+	// Overlapping operations are counted rather than held back by the bus.
+	options.serializeBuses = false;
+	auto backend = std::make_shared<SimulatedBackend>(options);
+	MonitorService service(backend);
+	std::string id = SimulatedBackend::IdForIndex(0);
+	std::promise<FadeStatus> done;
+	auto status = done.get_future();
+
+	service.Fade(id, 100, std::chrono::milliseconds(200), FadeEasing::Linear, [&](FadeStatus status) { done.set_value(status); });
+	while (status.wait_for(std::chrono::seconds(0)) != std::future_status::ready) service.GetBrightness(id, {true});
+
+	EXPECT(status.get() == FadeStatus::Completed);
+	// Steps and reads took turns on the bus instead of overlapping.
+	EXPECT_EQ(backend->GetMaxConcurrency(0), 1);
+	EXPECT_EQ(service.GetBrightness(id, {true}), 100);
+}
@@ -0,0 +1,12 @@
+const {spawnSync} = require("child_process");
+const path = require("path");
+
+const binary = path.join(__dirname, "..", "..", "build", "Release", process.platform === "win32" ? "lumi_test.exe" : "lumi_test");
+const {status, error} = spawnSync(binary, process.argv.slice(2), {stdio: "inherit", cwd: path.join(__dirname, "..", "..")});
+
+if (error) {
+    console.error(`Failed to run ${binary}. Build it first with \`npm run build\`.`);
+    process.exit(1);
+}
+
+process.exit(status);
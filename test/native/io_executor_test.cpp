@@ -0,0 +1,117 @@
+#include "io_executor.h"
+#include "test.h"
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(IoExecutorRunsQueueInOrder) {
+	IoExecutor executor;
+	std::vector<int> order;
+	std::promise<void> done;
+
+	for (int i = 0; i < 5; i++) {
+		executor.Post("bus", [&order, i]() {
+			std::this_thread::sleep_for(std::chrono::milliseconds(5 - i));
+			order.push_back(i);
+		});
+	}
+	executor.Post("bus", [&done]() { done.set_value(); });
+
+	done.get_future().get();
+	EXPECT(order == std::vector<int>({0, 1, 2, 3, 4}));
+	EXPECT_EQ(executor.GetQueueCount(), size_t(1));
+}
+
+TEST(IoExecutorRunsQueuesInParallel) {
+	IoExecutor executor;
+	std::atomic<int> active{0};
+	std::atomic<int> maxActive{0};
+	std::vector<std::promise<void>> done(4);
+
+	auto started = std::chrono::steady_clock::now();
+	for (int i = 0; i < 4; i++) {
+		executor.Post("bus" + std::to_string(i), [&, i]() {
+			int now = ++active;
+			int previous = maxActive;
+			while (now > previous && !maxActive.compare_exchange_weak(previous, now)) {}
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			active--;
+			done[i].set_value();
+		});
+	}
+
+	for (auto &promise: done) promise.get_future().get();
+	auto elapsed = std::chrono::steady_clock::now() - started;
+
+	EXPECT(maxActive > 1);
+	EXPECT(elapsed < std::chrono::milliseconds(150));
+}
+
+TEST(IoExecutorFinishesPendingWorkOnShutdown) {
+	std::atomic<int> ran{0};
+
+	{
+		IoExecutor executor;
+		for (int i = 0; i < 3; i++) {
+			executor.Post("bus", [&]() {
+				std::this_thread::sleep_for(std::chrono::milliseconds(5));
+				ran++;
+			});
+		}
+	}
+
+	EXPECT_EQ(ran.load(), 3);
+}
+
+TEST(IoExecutorRunsInteractiveWorkFirst) {
+	IoExecutor executor;
+	std::vector<std::string> order;
+	std::promise<void> started;
+	std::promise<void> release;
+	std::promise<void> done;
+	auto released = release.get_future().share();
+
+	executor.Post("bus", [&]() {
+		started.set_value();
+		released.wait();
+	});
+	started.get_future().get();
+
+	executor.Post("bus", [&]() { order.push_back("background"); }, Priority::Background);
+	executor.Post("bus", [&]() { order.push_back("normal"); });
+	executor.Post("bus", [&]() { order.push_back("interactive"); }, Priority::Interactive);
+	executor.Post("bus", [&]() { done.set_value(); }, Priority::Background);
+	release.set_value();
+
+	done.get_future().get();
+	EXPECT(order == std::vector<std::string>({"interactive", "normal", "background"}));
+}
+
+TEST(IoExecutorLimitsBackgroundShare) {
+	IoExecutor executor;
+	executor.SetBackgroundShare(0.5);
+	const int tasks = 5;
+	std::promise<void> done;
+
+	auto started = std::chrono::steady_clock::now();
+	for (int i = 0; i < tasks; i++) {
+		executor.Post("bus", [&, i]() {
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			if (i == tasks - 1) done.set_value();
+		}, Priority::Background);
+	}
+
+	// Each task is followed by as long a rest, except the last.
+	done.get_future().get();
+	EXPECT(std::chrono::steady_clock::now() - started >= std::chrono::milliseconds(20 * (2 * tasks - 1)));
+
+	// Work of other priorities is not held back by the rest.
+	std::promise<void> interactive;
+	auto posted = std::chrono::steady_clock::now();
+	executor.Post("bus", [&]() { interactive.set_value(); }, Priority::Interactive);
+	interactive.get_future().get();
+	EXPECT(std::chrono::steady_clock::now() - posted < std::chrono::milliseconds(15));
+}
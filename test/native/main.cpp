@@ -0,0 +1,27 @@
+#include "test.h"
+#include <cstdio>
+#include <cstring>
+#include <exception>
+
+int main(int argc, char **argv) {
+	const char *filter = argc > 1 ? argv[1] : nullptr;
+	int passed = 0;
+	int failed = 0;
+
+	for (const auto &test: TestRegistry()) {
+		if (filter != nullptr && std::strstr(test.name, filter) == nullptr) continue;
+
+		try {
+			test.run();
+			std::printf("ok      %s\n", test.name);
+			passed++;
+		} catch (const std::exception &error) {
+			std::printf("FAILED  %s\n        %s\n", test.name, error.what());
+			failed++;
+		}
+	}
+
+	std::printf("\n%d passed, %d failed\n", passed, failed);
+
+	return failed == 0 ? 0 : 1;
+}
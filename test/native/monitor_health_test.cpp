@@ -0,0 +1,140 @@
+#include "backends/simulated_backend.h"
+#include "monitor_health.h"
+#include "monitor_service.h"
+#include "test.h"
+#include <chrono>
+#include <thread>
+
+TEST(HealthTrackerOpensCircuitAfterConsecutiveFailures) {
+	HealthPolicy policy;
+	policy.failureThreshold = 2;
+	policy.cooldown = std::chrono::milliseconds(50);
+	HealthTracker tracker(policy);
+	auto latency = std::chrono::milliseconds(3);
+
+	tracker.Record("a", false, latency);
+	tracker.Record("a", true, latency);
+	tracker.Record("a", false, latency);
+	EXPECT(tracker.Get("a").state == CircuitState::Closed);
+
+	tracker.Record("a", false, latency);
+	EXPECT(tracker.Get("a").state == CircuitState::Open);
+	EXPECT(tracker.Get("a").retryIn.count() > 0);
+	EXPECT(!tracker.Admits("a"));
+	EXPECT(!tracker.Begin("a"));
+	EXPECT_EQ(tracker.Get("a").rejected, std::uint64_t(2));
+	EXPECT(tracker.Admits("b"));
+
+	// After the cooldown exactly one operation gets through as the probe.
+	std::this_thread::sleep_for(std::chrono::milliseconds(60));
+	EXPECT(tracker.Admits("a"));
+	EXPECT(tracker.Begin("a"));
+	EXPECT(tracker.Get("a").state == CircuitState::HalfOpen);
+	EXPECT(!tracker.Begin("a"));
+
+	tracker.Record("a", true, latency);
+	MonitorHealth health = tracker.Get("a");
+	EXPECT(health.state == CircuitState::Closed);
+	EXPECT_EQ(health.consecutiveFailures, 0);
+	EXPECT_EQ(health.successes, std::uint64_t(2));
+	EXPECT_EQ(health.failures, std::uint64_t(3));
+	EXPECT_EQ(health.averageLatency.count(), 3000);
+}
+
+TEST(HealthTrackerReopensWhenProbeFails) {
+	HealthPolicy policy;
+	policy.failureThreshold = 1;
+	policy.cooldown = std::chrono::milliseconds(20);
+	HealthTracker tracker(policy);
+
+	tracker.Record("a", false, {});
+	std::this_thread::sleep_for(std::chrono::milliseconds(30));
+	EXPECT(tracker.Begin("a"));
+	tracker.Record("a", false, {});
+	EXPECT(tracker.Get("a").state == CircuitState::Open);
+	EXPECT(!tracker.Admits("a"));
+
+	// A threshold of 0 turns the breaker off.
+	policy.failureThreshold = 0;
+	tracker.SetPolicy(policy);
+	EXPECT(tracker.Admits("a"));
+	tracker.Record("a", false, {});
+	EXPECT(tracker.Get("a").state == CircuitState::Closed);
+}
+
+TEST(MonitorServiceFailsFastOnUnresponsiveMonitor) {
+	SimulatedBackendOptions options;
+	options.monitors = 3;
+	options.setLatency = std::chrono::milliseconds(5);
+	auto backend = std::make_shared<SimulatedBackend>(options);
+	MonitorService service(backend);
+	std::string id = SimulatedBackend::IdForIndex(1);
+
+	HealthPolicy policy;
+	policy.failureThreshold = 2;
+	policy.cooldown = std::chrono::milliseconds(100);
+	service.SetHealthPolicy(policy);
+	backend->SetMonitorOffline(1, true);
+
+	EXPECT(service.SetGlobalBrightness(30));
+	EXPECT(service.SetGlobalBrightness(40));
+	int operations = backend->GetOperationCount(1);
+
+	// The open circuit keeps the monitor off its bus; the others still work.
+	SetBrightnessResult result = service.SetBrightness({{ALL_MONITORS, 50}});
+	EXPECT_EQ(backend->GetOperationCount(1), operations);
+	EXPECT_EQ(result.monitors[1].error, std::string("UNAVAILABLE"));
+	EXPECT(result.monitors[0].success && result.monitors[2].success);
+	EXPECT_EQ(service.GetBrightness(id, {true}), -1);
+
+	std::vector<MonitorHealth> health = service.GetHealth();
+	EXPECT_EQ(health.size(), size_t(3));
+	EXPECT(health[1].state == CircuitState::Open);
+	EXPECT_EQ(health[1].rejected, std::uint64_t(2));
+	EXPECT(health[0].state == CircuitState::Closed);
+
+	// Once it is back, the probe after the cooldown closes the circuit.
+	backend->SetMonitorOffline(1, false);
+	std::this_thread::sleep_for(std::chrono::milliseconds(120));
+	EXPECT(service.SetBrightness({{id, 60}}).success);
+	EXPECT(service.GetHealth()[1].state == CircuitState::Closed);
+	EXPECT_EQ(service.GetBrightness(id, {true}), 60);
+}
+
+TEST(MonitorServiceIgnoresCancelledFailures) {
+	SimulatedBackendOptions options;
+	options.monitors = 1;
+	auto backend = std::make_shared<SimulatedBackend>(options);
+	MonitorService service(backend);
+	MonitorRef ref = service.GetTopology()->refs[0];
+
+	HealthPolicy policy;
+	policy.failureThreshold = 1;
+	policy.cooldown = std::chrono::milliseconds(20);
+	service.SetHealthPolicy(policy);
+	backend->SetMonitorOffline(0, true);
+
+	// Failures of a cancelled request are not the monitor's fault.
+	Cancellation cancelled;
+	cancelled.Cancel(CancelReason::Timeout);
+	{
+		CancellationScope scope(&cancelled);
+		EXPECT_EQ(service.GetMonitorBrightness(ref), -1);
+	}
+	EXPECT(service.GetHealth()[0].state == CircuitState::Closed);
+	EXPECT_EQ(service.GetHealth()[0].failures, std::uint64_t(0));
+
+	// Nor do they end the probe of an open circuit as failed.
+	EXPECT(!service.SetMonitorBrightness(ref, 30));
+	EXPECT(service.GetHealth()[0].state == CircuitState::Open);
+	std::this_thread::sleep_for(std::chrono::milliseconds(30));
+	{
+		CancellationScope scope(&cancelled);
+		EXPECT(!service.SetMonitorBrightness(ref, 30));
+	}
+	EXPECT_EQ(service.GetHealth()[0].failures, std::uint64_t(1));
+
+	backend->SetMonitorOffline(0, false);
+	EXPECT(service.SetMonitorBrightness(ref, 40));
+	EXPECT(service.GetHealth()[0].state == CircuitState::Closed);
+}
@@ -0,0 +1,93 @@
+#include "monitor_identity.h"
+#include "test.h"
+
+static MonitorRef Ref(const std::string &id, const std::string &connector) {
+	MonitorRef ref;
+	ref.id = id;
+	ref.connector = connector;
+	return ref;
+}
+
+static Monitor Panel(const std::string &id, const std::string &serial) {
+	Monitor monitor;
+	monitor.id = id;
+	monitor.manufacturer = "DEL";
+	monitor.productCode = "A0F6";
+	monitor.serialNumber = serial;
+	return monitor;
+}
+
+TEST(MonitorIdentityFollowsMonitorAcrossPorts) {
+	std::vector<MonitorRef> refs = {Ref("a", "card0-DP-1"), Ref("b", "card0-DP-2")};
+	std::vector<Monitor> monitors = {Panel("a", "CN0ABC123"), Panel("b", "CN0XYZ789")};
+	std::unordered_map<std::uint64_t, size_t> index;
+
+	EXPECT(AssignIdentities(refs, monitors, index).empty());
+	std::uint64_t first = monitors[0].displayId;
+	std::uint64_t second = monitors[1].displayId;
+
+	EXPECT(first != 0 && second != 0 && first != second);
+	EXPECT_EQ(refs[0].displayId, first);
+	EXPECT_EQ(index.at(second), size_t(1));
+
+	// The same monitors, plugged into each other's port.
+	refs = {Ref("a", "card0-DP-2"), Ref("b", "card0-DP-1")};
+	monitors = {Panel("a", "CN0XYZ789"), Panel("b", "CN0ABC123")};
+	AssignIdentities(refs, monitors, index);
+
+	EXPECT_EQ(monitors[0].displayId, second);
+	EXPECT_EQ(monitors[1].displayId, first);
+}
+
+TEST(MonitorIdentitySeparatesIdenticalMonitorsByConnector) {
+	std::vector<MonitorRef> refs = {Ref("a", "card0-DP-1"), Ref("b", "card0-DP-2"), Ref("c", "intel_backlight")};
+	std::vector<Monitor> monitors = {Panel("a", "0"), Panel("b", "0"), Panel("c", "")};
+	std::unordered_map<std::uint64_t, size_t> index;
+
+	EXPECT(AssignIdentities(refs, monitors, index).empty());
+	EXPECT(monitors[0].displayId != monitors[1].displayId);
+	EXPECT_EQ(index.size(), size_t(3));
+
+	// Without a serial the id belongs to the port.
+	std::uint64_t onFirstPort = monitors[0].displayId;
+	refs = {Ref("b", "card0-DP-1")};
+	monitors = {Panel("b", "0")};
+	AssignIdentities(refs, monitors, index);
+
+	EXPECT_EQ(monitors[0].displayId, onFirstPort);
+}
+
+TEST(MonitorIdentityReportsCollisions) {
+	// Same EDID identity on the same connector: nothing tells them apart.
+	std::vector<MonitorRef> refs = {Ref("a", "card0-DP-1"), Ref("b", "card0-DP-1")};
+	std::vector<Monitor> monitors = {Panel("a", "CN0ABC123"), Panel("b", "CN0ABC123")};
+	std::unordered_map<std::uint64_t, size_t> index;
+
+	auto collisions = AssignIdentities(refs, monitors, index);
+
+	EXPECT_EQ(collisions.size(), size_t(1));
+	EXPECT(collisions[0].identical);
+	EXPECT_EQ(collisions[0].displayId, monitors[0].displayId);
+	EXPECT_EQ(collisions[0].monitorIds.size(), size_t(2));
+	EXPECT(monitors[1].displayId != 0 && monitors[1].displayId != monitors[0].displayId);
+	EXPECT_EQ(index.size(), size_t(2));
+}
+
+TEST(MonitorIdentityFallsBackToConnector) {
+	// The backend could not describe the monitors (e.g. a failed WMI query).
+	std::vector<MonitorRef> refs = {Ref("a", "card0-DP-1"), Ref("b", "card0-DP-2")};
+	std::vector<Monitor> monitors;
+	std::unordered_map<std::uint64_t, size_t> index;
+
+	EXPECT(AssignIdentities(refs, monitors, index).empty());
+	EXPECT(refs[0].displayId != 0 && refs[1].displayId != 0 && refs[0].displayId != refs[1].displayId);
+	EXPECT_EQ(index.size(), size_t(2));
+
+	// The same id a monitor without an EDID identity gets on that connector.
+	std::uint64_t fallback = refs[0].displayId;
+	Monitor blank;
+	blank.id = "a";
+	monitors = {blank};
+	AssignIdentities(refs, monitors, index);
+	EXPECT_EQ(refs[0].displayId, fallback);
+}
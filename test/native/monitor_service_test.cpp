@@ -0,0 +1,492 @@
+#include "backends/simulated_backend.h"
+#include "monitor_service.h"
+#include "test.h"
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <thread>
+
+TEST(MonitorServiceReusesTopologySnapshot) {
+	auto backend = std::make_shared<SimulatedBackend>(SimulatedBackendOptions{2});
+	MonitorService service(backend);
+
+	auto first = service.GetTopology();
+	auto second = service.GetTopology();
+
+	EXPECT(first == second);
+	EXPECT_EQ(first->refs.size(), size_t(2));
+	EXPECT(first->Find(first->refs[1].id) == &first->refs[1]);
+	EXPECT(first->Find("missing") == nullptr);
+}
+
+TEST(MonitorServiceIndexesMonitorsByDisplayId) {
+	auto backend = std::make_shared<SimulatedBackend>(SimulatedBackendOptions{3});
+	MonitorService service(backend);
+
+	auto topology = service.GetTopology();
+
+	EXPECT(service.GetIdentityCollisions().empty());
+	for (size_t i = 0; i < topology->refs.size(); i++) {
+		EXPECT(topology->refs[i].displayId != 0);
+		EXPECT_EQ(topology->monitors[i].displayId, topology->refs[i].displayId);
+		EXPECT(topology->Find(topology->refs[i].displayId) == &topology->refs[i]);
+	}
+
+	// Stable across rebuilds.
+	std::uint64_t displayId = topology->refs[2].displayId;
+	service.Refresh();
+	EXPECT_EQ(service.GetTopology()->refs[2].displayId, displayId);
+	EXPECT(service.GetTopology()->Find(std::uint64_t(1)) == nullptr);
+}
+
+TEST(MonitorServiceUsesOsPrimaryDisplay) {
+	SimulatedBackendOptions options;
+	options.monitors = 3;
+	options.primaryMonitor = 2;
+	auto backend = std::make_shared<SimulatedBackend>(options);
+	MonitorService service(backend);
+	Monitor primary;
+
+	EXPECT(service.GetPrimaryMonitor(primary));
+	EXPECT_EQ(primary.id, SimulatedBackend::IdForIndex(2));
+	EXPECT(service.SetBrightness({{"primary", 15}}).success);
+	EXPECT_EQ(service.GetBrightness("", {true}), 15);
+	EXPECT_EQ(service.GetBrightness(SimulatedBackend::IdForIndex(2), {true}), 15);
+}
+
+TEST(MonitorServiceResolvesHandles) {
+	auto backend = std::make_shared<SimulatedBackend>(SimulatedBackendOptions{3});
+	MonitorService service(backend);
+	std::uint32_t handle = service.GetHandle(SimulatedBackend::IdForIndex(1));
+
+	EXPECT(handle != 0);
+	EXPECT_EQ(service.GetHandle(SimulatedBackend::IdForIndex(1)), handle);
+	EXPECT_EQ(service.GetHandle("missing"), std::uint32_t(0));
+
+	std::promise<SetBrightnessResult> set;
+	service.SetBrightness(handle, 25, {}, [&](SetBrightnessResult result) { set.set_value(result); });
+	EXPECT(set.get_future().get().success);
+	EXPECT_EQ(service.GetBrightness(SimulatedBackend::IdForIndex(1), {true}), 25);
+
+	// Handles survive rebuilds and fail cleanly once the monitor is gone.
+	backend->SetMonitorCount(1);
+	service.Refresh();
+	std::promise<int> read;
+	service.GetBrightness(handle, {true}, [&](MonitorGetResult value) { read.set_value(value.brightness); });
+	EXPECT_EQ(read.get_future().get(), -1);
+
+	std::promise<SetBrightnessResult> missing;
+	service.SetBrightness(handle, 25, {}, [&](SetBrightnessResult result) { missing.set_value(result); });
+	SetBrightnessResult result = missing.get_future().get();
+	EXPECT(!result.success);
+	EXPECT_EQ(result.monitors.size(), size_t(1));
+	EXPECT_EQ(result.monitors[0].monitorId, SimulatedBackend::IdForIndex(1));
+	EXPECT_EQ(result.monitors[0].error, std::string("NOT_FOUND"));
+
+	backend->SetMonitorCount(3);
+	service.Refresh();
+	EXPECT_EQ(service.GetHandle(SimulatedBackend::IdForIndex(1)), handle);
+}
+
+TEST(MonitorServiceSetsManyMonitorsByHandle) {
+	auto backend = std::make_shared<SimulatedBackend>(SimulatedBackendOptions{3});
+	MonitorService service(backend);
+	std::vector<std::pair<std::uint32_t, int>> writes;
+
+	for (size_t i = 0; i < 3; i++) writes.emplace_back(service.GetHandle(SimulatedBackend::IdForIndex(i)), static_cast<int>(10 * (i + 1)));
+	writes.emplace_back(0, 50);
+
+	std::promise<std::vector<SetStatus>> result;
+	service.SetManyBrightness(writes, {}, [&](std::vector<SetStatus> statuses) { result.set_value(statuses); });
+	auto statuses = result.get_future().get();
+
+	EXPECT_EQ(statuses.size(), size_t(4));
+	EXPECT(statuses[0] == SetStatus::Ok && statuses[1] == SetStatus::Ok && statuses[2] == SetStatus::Ok);
+	EXPECT(statuses[3] == SetStatus::NotFound);
+	EXPECT_EQ(service.GetBrightness(SimulatedBackend::IdForIndex(2), {true}), 30);
+}
+
+TEST(MonitorServiceRebuildsAfterRefresh) {
+	auto backend = std::make_shared<SimulatedBackend>(SimulatedBackendOptions{2});
+	MonitorService service(backend);
+
+	auto first = service.GetTopology();
+	service.Refresh();
+	auto second = service.GetTopology();
+
+	EXPECT(first != second);
+	EXPECT_EQ(second->refs.size(), size_t(2));
+}
+
+TEST(MonitorServiceRebuildsWhenConfigurationChanges) {
+	auto backend = std::make_shared<SimulatedBackend>(SimulatedBackendOptions{2});
+	MonitorService service(backend);
+
+	auto first = service.GetTopology();
+	backend->SetMonitorCount(3);
+	auto second = service.GetTopology();
+
+	EXPECT(first != second);
+	EXPECT_EQ(second->refs.size(), size_t(3));
+	EXPECT_EQ(first->refs.size(), size_t(2));
+}
+
+TEST(MonitorServiceWithoutBackendHasNoMonitors) {
+	MonitorService service(nullptr);
+
+	EXPECT(service.GetTopology()->refs.empty());
+	EXPECT_EQ(service.GetMonitorBrightness(MonitorRef()), -1);
+	EXPECT(!service.SetMonitorBrightness(MonitorRef(), 50));
+}
+
+TEST(MonitorServiceServesCachedBrightness) {
+	auto backend = std::make_shared<SimulatedBackend>(SimulatedBackendOptions{1});
+	MonitorService service(backend);
+	std::string id = SimulatedBackend::IdForIndex(0);
+
+	EXPECT_EQ(service.GetBrightness(id), 50);
+	EXPECT_EQ(service.GetBrightness(id), 50);
+	EXPECT_EQ(backend->GetOperationCount(0), 1);
+
+	// Written values are served without reading them back.
+	EXPECT(service.SetBrightness({{id, 70}}).success);
+	EXPECT_EQ(service.GetBrightness(id), 70);
+	EXPECT_EQ(backend->GetOperationCount(0), 2);
+
+	EXPECT_EQ(service.GetBrightness(id, {true}), 70);
+	EXPECT_EQ(backend->GetOperationCount(0), 3);
+}
+
+TEST(MonitorServiceServesLastKnownBrightnessSynchronously) {
+	auto backend = std::make_shared<SimulatedBackend>(SimulatedBackendOptions{2});
+	MonitorService service(backend);
+	service.SetCacheMaxAge(std::chrono::milliseconds(0));
+	std::string id = SimulatedBackend::IdForIndex(1);
+	int brightness = -1;
+	std::chrono::milliseconds age;
+
+	EXPECT(!service.GetCachedBrightness(id, brightness, age));
+
+	// Kept even though the cache no longer serves it to get().
+	EXPECT(service.SetBrightness({{id, 33}}).success);
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	EXPECT(service.GetCachedBrightness(service.GetHandle(id), brightness, age));
+	EXPECT_EQ(brightness, 33);
+	EXPECT(age >= std::chrono::milliseconds(20));
+
+	EXPECT(service.GetBrightness("", {true}) != -1);
+	EXPECT(service.GetCachedBrightness("primary", brightness, age));
+	EXPECT(age < std::chrono::milliseconds(20));
+}
+
+TEST(MonitorServiceServesCachedBrightnessWithoutRebuilding) {
+	SimulatedBackendOptions options;
+	options.monitors = 2;
+	options.enumerationLatency = std::chrono::milliseconds(200);
+	auto backend = std::make_shared<SimulatedBackend>(options);
+	MonitorService service(backend);
+	std::string id = SimulatedBackend::IdForIndex(0);
+	int brightness = -1;
+	std::chrono::milliseconds age;
+
+	std::uint32_t handle = service.GetHandle(id);
+	EXPECT(service.SetBrightness({{id, 44}}).success);
+
+	// The display configuration changed, but the lookup uses the last
+	// snapshot rather than enumerating on the caller's thread.
+	backend->SetMonitorCount(3);
+	auto started = std::chrono::steady_clock::now();
+	EXPECT(service.GetCachedBrightness(handle, brightness, age));
+	EXPECT(service.GetCachedBrightness("primary", brightness, age));
+	EXPECT(std::chrono::steady_clock::now() - started < std::chrono::milliseconds(100));
+	EXPECT_EQ(brightness, 44);
+}
+
+TEST(MonitorServiceAnswersSynchronousCallsWithoutRebuilding) {
+	SimulatedBackendOptions options;
+	options.monitors = 2;
+	options.enumerationLatency = std::chrono::milliseconds(200);
+	auto backend = std::make_shared<SimulatedBackend>(options);
+	MonitorService service(backend);
+	std::string id = SimulatedBackend::IdForIndex(1);
+	std::uint32_t handle = service.GetHandle(id);
+
+	// Served from the last snapshot until a request on the control queue
+	// notices the change.
+	backend->SetMonitorCount(3);
+	Monitor primary;
+	auto started = std::chrono::steady_clock::now();
+	EXPECT_EQ(service.GetHandle(id), handle);
+	EXPECT(service.GetPrimaryMonitor(primary));
+	EXPECT_EQ(service.GetHealth().size(), size_t(2));
+	EXPECT(service.GetIdentityCollisions().empty());
+	EXPECT(std::chrono::steady_clock::now() - started < std::chrono::milliseconds(100));
+}
+
+TEST(MonitorServiceExpiresCachedBrightness) {
+	auto backend = std::make_shared<SimulatedBackend>(SimulatedBackendOptions{1});
+	MonitorService service(backend);
+	std::string id = SimulatedBackend::IdForIndex(0);
+
+	service.SetCacheMaxAge(std::chrono::milliseconds(20));
+	service.GetBrightness(id);
+	service.GetBrightness(id);
+	EXPECT_EQ(backend->GetOperationCount(0), 1);
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(30));
+	service.GetBrightness(id);
+	EXPECT_EQ(backend->GetOperationCount(0), 2);
+
+	service.SetCacheMaxAge(std::chrono::milliseconds(0));
+	service.GetBrightness(id);
+	EXPECT_EQ(backend->GetOperationCount(0), 3);
+}
+
+TEST(MonitorServiceAppliesConfigurationInParallel) {
+	SimulatedBackendOptions options;
+	options.monitors = 4;
+	options.setLatency = std::chrono::milliseconds(50);
+	auto backend = std::make_shared<SimulatedBackend>(options);
+	MonitorService service(backend);
+
+	std::vector<MonitorBrightnessConfiguration> config;
+	for (size_t i = 0; i < 4; i++) config.push_back({SimulatedBackend::IdForIndex(i), 20});
+	config.push_back({"missing", 20});
+
+	auto started = std::chrono::steady_clock::now();
+	SetBrightnessResult result = service.SetBrightness(config);
+	auto elapsed = std::chrono::steady_clock::now() - started;
+
+	// Four 50 ms writes on four buses take about as long as one.
+	EXPECT(elapsed < std::chrono::milliseconds(150));
+	EXPECT(result.success);
+	EXPECT_EQ(result.monitors.size(), size_t(5));
+	for (size_t i = 0; i < 4; i++) {
+		EXPECT_EQ(result.monitors[i].monitorId, SimulatedBackend::IdForIndex(i));
+		EXPECT(result.monitors[i].success);
+	}
+	EXPECT(!result.monitors[4].success);
+	EXPECT_EQ(result.monitors[4].error, std::string("NOT_FOUND"));
+}
+
+TEST(MonitorServiceReportsFailedMonitors) {
+	SimulatedBackendOptions options;
+	options.monitors = 2;
+	options.failureRate = 1;
+	MonitorService service(std::make_shared<SimulatedBackend>(options));
+
+	SetBrightnessResult result = service.SetBrightness({{SimulatedBackend::IdForIndex(0), 20}, {SimulatedBackend::IdForIndex(1), 30}});
+
+	EXPECT(!result.success);
+	EXPECT_EQ(result.monitors.size(), size_t(2));
+	EXPECT_EQ(result.monitors[1].error, std::string("WRITE_FAILED"));
+}
+
+static std::vector<MonitorGetResult> GetAll(MonitorService &service, const GetBrightnessOptions &options = {}) {
+	std::promise<std::vector<MonitorGetResult>> results;
+	service.GetAllBrightness(options, [&](GetAllBrightnessResult value) { results.set_value(value.monitors); });
+	return results.get_future().get();
+}
+
+TEST(MonitorServiceReadsAllMonitorsAtOnce) {
+	SimulatedBackendOptions options;
+	options.monitors = 4;
+	options.internalMonitors = 2;
+	options.getLatency = std::chrono::milliseconds(50);
+	auto backend = std::make_shared<SimulatedBackend>(options);
+	MonitorService service(backend);
+
+	auto started = std::chrono::steady_clock::now();
+	auto results = GetAll(service);
+	auto elapsed = std::chrono::steady_clock::now() - started;
+
+	EXPECT_EQ(results.size(), size_t(4));
+	for (size_t i = 0; i < 4; i++) {
+		EXPECT_EQ(results[i].monitorId, SimulatedBackend::IdForIndex(i));
+		EXPECT_EQ(results[i].brightness, 50);
+		EXPECT(results[i].error.empty());
+	}
+
+	// Internal panels come from one bulk read, the others are read in parallel.
+	EXPECT_EQ(backend->GetBatchCount(), 1);
+	EXPECT_EQ(backend->GetOperationCount(0), 0);
+	EXPECT_EQ(backend->GetOperationCount(3), 1);
+	EXPECT(elapsed < std::chrono::milliseconds(175));
+
+	// Every monitor's read is recorded once, batched or not.
+	std::vector<MonitorHealth> health = service.GetHealth();
+	for (size_t i = 0; i < 4; i++) EXPECT_EQ(health[i].successes, std::uint64_t(1));
+	EXPECT(health[0].lastLatency >= std::chrono::milliseconds(50));
+
+	// Served from the cache until a fresh read is asked for.
+	GetAll(service);
+	EXPECT_EQ(backend->GetBatchCount(), 1);
+	GetAll(service, {true});
+	EXPECT_EQ(backend->GetBatchCount(), 2);
+}
+
+TEST(MonitorServiceBatchReadDoesNotHoldUpOtherRequests) {
+	SimulatedBackendOptions options;
+	options.monitors = 2;
+	options.internalMonitors = 1;
+	options.getLatency = std::chrono::milliseconds(300);
+	auto backend = std::make_shared<SimulatedBackend>(options);
+	MonitorService service(backend);
+	service.GetTopology();
+
+	std::promise<std::vector<MonitorGetResult>> all;
+	service.GetAllBrightness({true}, [&](GetAllBrightnessResult value) { all.set_value(value.monitors); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+	// The external monitor's bus is free while the panels are read in bulk.
+	SetBrightnessOptions interactive;
+	interactive.priority = Priority::Interactive;
+	auto started = std::chrono::steady_clock::now();
+	EXPECT(service.SetBrightness({{SimulatedBackend::IdForIndex(1), 40}}, interactive).success);
+	EXPECT(std::chrono::steady_clock::now() - started < std::chrono::milliseconds(150));
+
+	auto results = all.get_future().get();
+	EXPECT_EQ(results.size(), size_t(2));
+	EXPECT_EQ(results[0].brightness, 50);
+	EXPECT_EQ(results[1].brightness, 40);
+	EXPECT_EQ(backend->GetBatchCount(), 1);
+}
+
+TEST(MonitorServiceReportsUnreadableMonitors) {
+	SimulatedBackendOptions options;
+	options.monitors = 2;
+	options.failureRate = 1;
+	MonitorService service(std::make_shared<SimulatedBackend>(options));
+
+	auto results = GetAll(service);
+
+	EXPECT_EQ(results.size(), size_t(2));
+	EXPECT_EQ(results[0].brightness, -1);
+	EXPECT_EQ(results[0].error, std::string("READ_FAILED"));
+}
+
+TEST(MonitorServiceEnumeratesOffThread) {
+	SimulatedBackendOptions options;
+	options.monitors = 3;
+	options.enumerationLatency = std::chrono::milliseconds(100);
+	MonitorService service(std::make_shared<SimulatedBackend>(options));
+	std::promise<std::vector<Monitor>> monitors;
+
+	auto started = std::chrono::steady_clock::now();
+	service.GetAvailableMonitors([&](std::vector<Monitor> value) { monitors.set_value(value); });
+
+	EXPECT(std::chrono::steady_clock::now() - started < std::chrono::milliseconds(50));
+	EXPECT_EQ(monitors.get_future().get().size(), size_t(3));
+}
+
+TEST(MonitorServiceStreamsDiscovery) {
+	SimulatedBackendOptions options;
+	options.monitors = 3;
+	options.internalMonitors = 1;
+	options.probeLatency = std::chrono::milliseconds(60);
+	MonitorService service(std::make_shared<SimulatedBackend>(options));
+	std::mutex mutex;
+	std::vector<DiscoveryEvent> events;
+	std::promise<void> done;
+
+	auto started = std::chrono::steady_clock::now();
+	service.Discover(
+	        [&](const DiscoveryEvent &event) {
+		        std::lock_guard<std::mutex> lock(mutex);
+		        events.push_back(event);
+	        },
+	        [&]() { done.set_value(); });
+	done.get_future().get();
+
+	// Probes run on separate buses, so they overlap.
+	EXPECT(std::chrono::steady_clock::now() - started < std::chrono::milliseconds(150));
+	EXPECT_EQ(events.size(), size_t(9));
+
+	for (size_t i = 0; i < 3; i++) {
+		EXPECT(events[i].kind == DiscoveryEvent::Kind::Identity);
+		EXPECT(events[i + 3].kind == DiscoveryEvent::Kind::Details);
+		EXPECT(events[i + 6].kind == DiscoveryEvent::Kind::Capabilities);
+		EXPECT(events[i + 6].capabilities.brightness);
+		EXPECT_EQ(events[i + 6].brightness, 50);
+	}
+
+	EXPECT(events[3].monitor.internal);
+	EXPECT(!events[4].monitor.internal);
+}
+
+TEST(MonitorServicePublishesTopologyChanges) {
+	auto backend = std::make_shared<SimulatedBackend>(SimulatedBackendOptions{2});
+	MonitorService service(backend);
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::vector<TopologyChange> changes;
+
+	auto wait = [&](size_t count) {
+		std::unique_lock<std::mutex> lock(mutex);
+		return changed.wait_for(lock, std::chrono::seconds(2), [&]() { return changes.size() >= count; });
+	};
+
+	std::uint64_t id = service.WatchTopology([&](const TopologyChange &change) {
+		std::lock_guard<std::mutex> lock(mutex);
+		changes.push_back(change);
+		changed.notify_all();
+	});
+
+	// Subscribing happens on the control queue; wait until it took effect.
+	service.GetBrightness(SimulatedBackend::IdForIndex(0));
+	backend->SetMonitorCount(3);
+	EXPECT(wait(1));
+	EXPECT_EQ(changes[0].added.size(), size_t(1));
+	EXPECT_EQ(changes[0].added[0].id, SimulatedBackend::IdForIndex(2));
+	EXPECT(changes[0].removed.empty());
+
+	backend->SetMonitorCount(1);
+	EXPECT(wait(2));
+	EXPECT_EQ(changes[1].removed.size(), size_t(2));
+	EXPECT_EQ(service.GetTopology()->refs.size(), size_t(1));
+
+	std::promise<void> unwatched;
+	service.UnwatchTopology(id, [&]() { unwatched.set_value(); });
+	unwatched.get_future().get();
+
+	backend->SetMonitorCount(2);
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	EXPECT_EQ(changes.size(), size_t(2));
+}
+
+TEST(MonitorServiceReportsExternalBrightnessChanges) {
+	auto backend = std::make_shared<SimulatedBackend>(SimulatedBackendOptions{2});
+	MonitorService service(backend);
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::vector<BrightnessChange> changes;
+
+	service.SetBrightnessPollIntervals(std::chrono::milliseconds(10), std::chrono::milliseconds(40));
+	std::uint64_t id = service.WatchBrightness([&](const BrightnessChange &change) {
+		std::lock_guard<std::mutex> lock(mutex);
+		changes.push_back(change);
+		changed.notify_all();
+	});
+
+	// Let the baseline reads and a few polls happen.
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	EXPECT(service.SetBrightness({{SimulatedBackend::IdForIndex(1), 30}}).success);
+	backend->AdjustBrightness(0, 80);
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		EXPECT(changed.wait_for(lock, std::chrono::seconds(2), [&]() { return !changes.empty(); }));
+	}
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	std::promise<void> unwatched;
+	service.UnwatchBrightness(id, [&]() { unwatched.set_value(); });
+	unwatched.get_future().get();
+
+	// Only the external change is reported, not lumi's own write.
+	EXPECT_EQ(changes.size(), size_t(1));
+	EXPECT_EQ(changes[0].monitorId, SimulatedBackend::IdForIndex(0));
+	EXPECT_EQ(changes[0].brightness, 80);
+	EXPECT_EQ(changes[0].source, std::string("poll"));
+}
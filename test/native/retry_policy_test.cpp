@@ -0,0 +1,100 @@
+#include "backends/simulated_backend.h"
+#include "retry_policy.h"
+#include "test.h"
+#include <chrono>
+#include <random>
+#include <vector>
+
+TEST(RetryPolicyBacksOffExponentiallyUpToMaximum) {
+	RetryPolicy policy;
+	policy.initialDelay = std::chrono::milliseconds(5);
+	policy.maxDelay = std::chrono::milliseconds(30);
+	policy.multiplier = 2;
+	policy.jitter = 0;
+	std::mt19937 random(1);
+
+	EXPECT_EQ(policy.Delay(1, random).count(), 5000);
+	EXPECT_EQ(policy.Delay(2, random).count(), 10000);
+	EXPECT_EQ(policy.Delay(3, random).count(), 20000);
+	EXPECT_EQ(policy.Delay(4, random).count(), 30000);
+
+	// Jitter only ever shortens a delay, by at most its fraction.
+	policy.jitter = 0.5;
+	for (int i = 0; i < 100; i++) {
+		auto delay = policy.Delay(2, random).count();
+		EXPECT(delay >= 5000 && delay <= 10000);
+	}
+}
+
+TEST(RetryStopsAfterSuccessOrLastAttempt) {
+	RetryPolicy policy;
+	policy.attempts = 4;
+	policy.initialDelay = std::chrono::microseconds(0);
+	int calls = 0;
+
+	EXPECT(Retry(policy, [&]() { return ++calls == 2; }));
+	EXPECT_EQ(calls, 2);
+
+	calls = 0;
+	EXPECT(!Retry(policy, [&]() { calls++; return false; }));
+	EXPECT_EQ(calls, 4);
+}
+
+TEST(PathPreferenceTriesLastWorkingPathFirst) {
+	RetryPolicy policy;
+	policy.attempts = 1;
+	PathPreference preference(policy);
+	std::vector<size_t> tried;
+	bool firstWorks = false;
+
+	auto attempt = [&](size_t path) {
+		tried.push_back(path);
+		return path == 1 || firstWorks;
+	};
+
+	EXPECT(preference.Run("a", 2, attempt));
+	EXPECT(tried == std::vector<size_t>({0, 1}));
+	EXPECT_EQ(preference.Preferred("a", 2), size_t(1));
+
+	// The failing path is skipped while the learned one keeps working.
+	tried.clear();
+	EXPECT(preference.Run("a", 2, attempt));
+	EXPECT(tried == std::vector<size_t>({1}));
+
+	// Once it fails, the others are probed again.
+	tried.clear();
+	firstWorks = true;
+	EXPECT(preference.Run("a", 2, [&](size_t path) { tried.push_back(path); return path == 0; }));
+	EXPECT(tried == std::vector<size_t>({1, 0}));
+	EXPECT_EQ(preference.Preferred("a", 2), size_t(0));
+
+	policy.learn = false;
+	preference.SetPolicy(policy);
+	tried.clear();
+	EXPECT(preference.Run("a", 2, attempt));
+	EXPECT(tried == std::vector<size_t>({0}));
+	EXPECT_EQ(preference.Preferred("a", 2), size_t(2));
+}
+
+TEST(SimulatedBackendLearnsFallbackPath) {
+	SimulatedBackendOptions options;
+	options.monitors = 1;
+	options.internalMonitors = 1;
+	options.fallbackPanels = true;
+	SimulatedBackend backend(options);
+	MonitorRef ref = backend.GetMonitorRefs()[0];
+
+	EXPECT(backend.SetMonitorBrightness(ref, 40));
+	EXPECT_EQ(backend.GetOperationCount(0), 2);
+
+	// The panel is now reached on the fallback right away.
+	EXPECT_EQ(backend.GetMonitorBrightness(ref), 40);
+	EXPECT_EQ(backend.GetOperationCount(0), 3);
+
+	RetryPolicy policy;
+	policy.attempts = 1;
+	policy.learn = false;
+	backend.SetRetryPolicy(policy);
+	EXPECT_EQ(backend.GetMonitorBrightness(ref), 40);
+	EXPECT_EQ(backend.GetOperationCount(0), 5);
+}
@@ -0,0 +1,110 @@
+#include "backends/simulated_backend.h"
+#include "test.h"
+#include <thread>
+
+typedef std::chrono::steady_clock Clock;
+
+static std::chrono::milliseconds ReadAllInParallel(SimulatedBackend &backend) {
+	auto refs = backend.GetMonitorRefs();
+	std::vector<std::thread> threads;
+	auto start = Clock::now();
+
+	for (const auto &ref: refs) {
+		threads.emplace_back([&backend, ref]() { backend.GetMonitorBrightness(ref); });
+	}
+	for (auto &thread: threads) thread.join();
+
+	return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start);
+}
+
+TEST(SimulatedBackendEnumeratesVirtualMonitors) {
+	SimulatedBackendOptions options;
+	options.monitors = 3;
+	options.internalMonitors = 1;
+	SimulatedBackend backend(options);
+
+	auto refs = backend.GetMonitorRefs();
+	auto monitors = backend.GetAvailableMonitors(refs);
+
+	EXPECT_EQ(refs.size(), size_t(3));
+	EXPECT_EQ(refs[2].id, SimulatedBackend::IdForIndex(2));
+	EXPECT(monitors[0].internal);
+	EXPECT(!monitors[1].internal);
+	EXPECT(backend.ProbeMonitor(refs[1]).brightness);
+}
+
+TEST(SimulatedBackendStoresBrightness) {
+	SimulatedBackend backend;
+	auto refs = backend.GetMonitorRefs();
+
+	EXPECT_EQ(backend.GetMonitorBrightness(refs[0]), 50);
+	EXPECT(backend.SetMonitorBrightness(refs[0], 80));
+	EXPECT_EQ(backend.GetMonitorBrightness(refs[0]), 80);
+	EXPECT_EQ(backend.GetMonitorBrightness(refs[1]), 50);
+	EXPECT_EQ(backend.GetOperationCount(0), 3);
+}
+
+TEST(SimulatedBackendSerializesSharedBuses) {
+	SimulatedBackendOptions options;
+	options.monitors = 4;
+	options.buses = 1;
+	options.getLatency = std::chrono::milliseconds(10);
+	SimulatedBackend backend(options);
+
+	EXPECT(ReadAllInParallel(backend) >= std::chrono::milliseconds(40));
+	EXPECT_EQ(backend.GetMaxConcurrency(0), 1);
+}
+
+TEST(SimulatedBackendRunsSeparateBusesInParallel) {
+	SimulatedBackendOptions options;
+	options.monitors = 4;
+	options.getLatency = std::chrono::milliseconds(20);
+	SimulatedBackend backend(options);
+
+	EXPECT(ReadAllInParallel(backend) < std::chrono::milliseconds(60));
+	EXPECT_EQ(backend.GetMaxConcurrency(0), 1);
+}
+
+TEST(SimulatedBackendFailuresAreDeterministic) {
+	SimulatedBackendOptions options;
+	options.monitors = 2;
+	options.failureRate = 0.5;
+	options.seed = 42;
+	SimulatedBackend first(options);
+	SimulatedBackend second(options);
+	auto refs = first.GetMonitorRefs();
+
+	int failures = 0;
+	for (int i = 0; i < 50; i++) {
+		bool a = first.SetMonitorBrightness(refs[i % 2], i);
+		bool b = second.SetMonitorBrightness(refs[i % 2], i);
+		EXPECT_EQ(a, b);
+		if (!a) failures++;
+	}
+
+	EXPECT(failures > 10 && failures < 40);
+	EXPECT_EQ(first.GetFailureCount(0) + first.GetFailureCount(1), failures);
+}
+
+TEST(SimulatedBackendChangesTopology) {
+	SimulatedBackend backend;
+	auto stamp = backend.GetTopologyStamp();
+
+	backend.SetMonitorCount(6);
+
+	EXPECT(backend.GetTopologyStamp() != stamp);
+	EXPECT_EQ(backend.GetMonitorRefs().size(), size_t(6));
+}
+
+TEST(SimulatedBackendParsesOptions) {
+	auto options = ParseSimulatedBackendOptions("monitors=16,buses=2,internal=1,latency=40,jitter=2.5,failureRate=0.1,seed=7");
+
+	EXPECT_EQ(options.monitors, size_t(16));
+	EXPECT_EQ(options.buses, size_t(2));
+	EXPECT_EQ(options.internalMonitors, size_t(1));
+	EXPECT_EQ(options.getLatency.count(), 40000);
+	EXPECT_EQ(options.setLatency.count(), 40000);
+	EXPECT_EQ(options.jitter.count(), 2500);
+	EXPECT(options.failureRate > 0.09 && options.failureRate < 0.11);
+	EXPECT_EQ(options.seed, 7u);
+}
@@ -0,0 +1,234 @@
+#include "backends/sysfs_backend.h"
+#include "backends/sysfs_watcher.h"
+#include "test.h"
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+static std::string ReadFile(const std::filesystem::path &path) {
+	std::ifstream stream(path);
+	std::string value;
+	stream >> value;
+	return value;
+}
+
+static void WriteFile(const std::filesystem::path &path, const std::string &value) {
+	std::ofstream stream(path, std::ios::trunc);
+	stream << value << "\n";
+}
+
+TEST(SysfsBackendEnumeratesBacklightDevices) {
+	auto root = CopyFixture("sysfs");
+	SysfsBackend backend(root.string());
+
+	auto refs = backend.GetMonitorRefs();
+	EXPECT_EQ(refs.size(), size_t(2));
+	EXPECT_EQ(refs[0].id, std::string("acpi_video0"));
+	EXPECT_EQ(refs[1].id, std::string("intel_backlight"));
+
+	auto monitors = backend.GetAvailableMonitors(refs);
+	EXPECT_EQ(monitors.size(), size_t(2));
+	EXPECT(monitors[0].internal);
+	EXPECT(monitors[1].internal);
+	EXPECT_EQ(monitors[1].name, std::string("Built-in"));
+
+	std::filesystem::remove_all(root);
+}
+
+TEST(SysfsBackendScalesBrightnessToPercent) {
+	auto root = CopyFixture("sysfs");
+	SysfsBackend backend(root.string());
+	auto refs = backend.GetMonitorRefs();
+
+	EXPECT_EQ(backend.GetMonitorBrightness(refs[0]), 47);
+	EXPECT_EQ(backend.GetMonitorBrightness(refs[1]), 25);
+
+	EXPECT(backend.SetMonitorBrightness(refs[1], 50));
+	EXPECT_EQ(ReadFile(root / "class/backlight/intel_backlight/brightness"), std::string("9600"));
+
+	EXPECT(backend.SetMonitorBrightness(refs[0], 100));
+	EXPECT_EQ(ReadFile(root / "class/backlight/acpi_video0/brightness"), std::string("15"));
+
+	std::filesystem::remove_all(root);
+}
+
+TEST(SysfsBackendReadsActualBrightness) {
+	auto root = CopyFixture("sysfs");
+	SysfsBackend backend(root.string());
+	auto refs = backend.GetMonitorRefs();
+
+	WriteFile(root / "class/backlight/intel_backlight/actual_brightness", "19200");
+	EXPECT_EQ(backend.GetMonitorBrightness(refs[1]), 100);
+
+	std::filesystem::remove_all(root);
+}
+
+TEST(SysfsBackendReusesOpenDescriptors) {
+	auto root = CopyFixture("sysfs");
+	SysfsBackend backend(root.string());
+	auto refs = backend.GetMonitorRefs();
+	auto device = root / "class/backlight/intel_backlight";
+
+	EXPECT_EQ(backend.GetMonitorBrightness(refs[1]), 25);
+
+	// Once opened, the attributes are served from the kept descriptors even if
+	// the paths no longer resolve.
+	std::filesystem::rename(device / "actual_brightness", device / "actual_brightness.moved");
+	std::filesystem::rename(device / "brightness", device / "brightness.moved");
+
+	EXPECT_EQ(backend.GetMonitorBrightness(refs[1]), 25);
+	EXPECT(backend.SetMonitorBrightness(refs[1], 75));
+	EXPECT_EQ(ReadFile(device / "brightness.moved"), std::string("14400"));
+
+	auto again = backend.GetMonitorRefs();
+	EXPECT_EQ(again.size(), size_t(2));
+	EXPECT(again[1].handle == refs[1].handle);
+
+	std::filesystem::remove_all(root);
+}
+
+TEST(SysfsBackendTracksTopologyChanges) {
+	auto root = CopyFixture("sysfs");
+	SysfsBackend backend(root.string());
+
+	auto before = backend.GetTopologyStamp();
+	EXPECT_EQ(backend.GetTopologyStamp(), before);
+
+	std::filesystem::remove_all(root / "class/backlight/acpi_video0");
+	EXPECT(backend.GetTopologyStamp() != before);
+	EXPECT_EQ(backend.GetMonitorRefs().size(), size_t(1));
+
+	std::filesystem::remove_all(root);
+}
+
+TEST(SysfsBackendReopensReaddedDevices) {
+	auto root = CopyFixture("sysfs");
+	SysfsBackend backend(root.string());
+	auto device = root / "class/backlight/acpi_video0";
+	auto moved = root / "acpi_video0.moved";
+
+	auto refs = backend.GetMonitorRefs();
+	std::filesystem::rename(device, moved);
+	auto without = backend.GetMonitorRefs();
+	EXPECT_EQ(without.size(), size_t(1));
+
+	// Back under the same name with a different range: not the old device.
+	WriteFile(moved / "max_brightness", "30");
+	std::filesystem::rename(moved, device);
+	auto again = backend.GetMonitorRefs();
+	EXPECT_EQ(again.size(), size_t(2));
+	EXPECT(again[0].handle != refs[0].handle);
+	EXPECT_EQ(backend.ProbeMonitor(again[0]).maxBrightness, 30);
+	EXPECT_EQ(backend.GetMonitorBrightness(again[0]), 23);
+
+	// Refs handed out before stay usable until released.
+	EXPECT_EQ(backend.GetMonitorBrightness(refs[0]), 47);
+	backend.ReleaseMonitorRefs(refs);
+	backend.ReleaseMonitorRefs(without);
+
+	std::filesystem::remove_all(root);
+}
+
+TEST(SysfsBackendListsEachPanelOnce) {
+	// acpi_video0 (firmware, a child of the GPU) and intel_backlight (raw, a
+	// child of the GPU's eDP connector) drive the same panel.
+	auto root = CopyFixture("sysfs-duplicate");
+	SysfsBackend backend(root.string());
+
+	auto refs = backend.GetMonitorRefs();
+	EXPECT_EQ(refs.size(), size_t(1));
+	EXPECT_EQ(refs[0].id, std::string("acpi_video0"));
+	EXPECT_EQ(backend.GetMonitorBrightness(refs[0]), 47);
+
+	// Without the firmware interface the GPU's own takes over.
+	std::filesystem::remove(root / "class/backlight/acpi_video0");
+	refs = backend.GetMonitorRefs();
+	EXPECT_EQ(refs.size(), size_t(1));
+	EXPECT_EQ(refs[0].id, std::string("intel_backlight"));
+
+	std::filesystem::remove_all(root);
+}
+
+TEST(SysfsBackendListsPanelsSharingAGpu) {
+	// amdgpu_bl0 and amdgpu_bl1 are both raw, children of two eDP connectors
+	// of the same GPU: two panels.
+	auto root = CopyFixture("sysfs-dual-panel");
+	SysfsBackend backend(root.string());
+
+	auto refs = backend.GetMonitorRefs();
+	EXPECT_EQ(refs.size(), size_t(2));
+	EXPECT_EQ(refs[0].id, std::string("amdgpu_bl0"));
+	EXPECT_EQ(refs[1].id, std::string("amdgpu_bl1"));
+	EXPECT_EQ(backend.GetMonitorBrightness(refs[0]), 50);
+	EXPECT_EQ(backend.GetMonitorBrightness(refs[1]), 20);
+
+	std::filesystem::remove_all(root);
+}
+
+TEST(SysfsBackendIgnoresMissingRoot) {
+	SysfsBackend backend("/nonexistent/lumi");
+	EXPECT(backend.GetMonitorRefs().empty());
+}
+
+TEST(SysfsWatcherReportsHotplug) {
+	auto root = CopyFixture("sysfs");
+	std::atomic<int> changes{0};
+
+	auto waitFor = [&](int count) {
+		for (int i = 0; i < 200 && changes < count; i++) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		return changes >= count;
+	};
+
+	{
+		SysfsWatcher watcher(root.string(), "drm", [&]() { changes++; }, std::chrono::milliseconds(50));
+
+		// A connector changing state, as written by the fixture.
+		WriteFile(root / "class/drm/card0-DP-1/status", "disconnected");
+		EXPECT(waitFor(1));
+
+		// A burst of changes is reported once.
+		std::filesystem::create_directory(root / "class/drm/card0-DP-3");
+		WriteFile(root / "class/drm/card0-DP-3/status", "connected");
+		EXPECT(waitFor(2));
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		EXPECT_EQ(changes.load(), 2);
+	}
+
+	std::filesystem::remove_all(root);
+}
+
+TEST(SysfsBackendWatchesBrightness) {
+	auto root = CopyFixture("sysfs");
+	SysfsBackend backend(root.string());
+	auto refs = backend.GetMonitorRefs();
+	std::mutex mutex;
+	std::vector<std::string> changed;
+
+	EXPECT(backend.CanWatchBrightness(refs[1]));
+
+	{
+		auto watcher = backend.WatchBrightness(refs, [&](const std::string &id) {
+			std::lock_guard<std::mutex> lock(mutex);
+			changed.push_back(id);
+		});
+		EXPECT(watcher != nullptr);
+
+		WriteFile(root / "class/backlight/intel_backlight/actual_brightness", "9600");
+
+		for (int i = 0; i < 200; i++) {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (!changed.empty()) break;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+	}
+
+	EXPECT(!changed.empty());
+	EXPECT_EQ(changed[0], std::string("intel_backlight"));
+	EXPECT_EQ(backend.GetMonitorBrightness(refs[1]), 50);
+
+	std::filesystem::remove_all(root);
+}
@@ -0,0 +1,73 @@
+#ifndef LUMI_TEST_H
+#define LUMI_TEST_H
+
+#include <filesystem>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// A deliberately small test harness for the native engine: TEST registers a
+// function, EXPECT/EXPECT_EQ throw on failure and main.cpp runs everything.
+
+struct TestCase {
+	const char *name;
+	void (*run)();
+};
+
+inline std::vector<TestCase> &TestRegistry() {
+	static std::vector<TestCase> registry;
+	return registry;
+}
+
+struct TestRegistrar {
+	TestRegistrar(const char *name, void (*run)()) {
+		TestRegistry().push_back({name, run});
+	}
+};
+
+struct TestFailure : std::runtime_error {
+	using std::runtime_error::runtime_error;
+};
+
+#define TEST(name)                                                \
+	static void name();                                           \
+	static TestRegistrar name##Registrar(#name, name);            \
+	static void name()
+
+#define EXPECT(condition)                                                                                 \
+	do {                                                                                                  \
+		if (!(condition)) {                                                                               \
+			std::ostringstream stream;                                                                    \
+			stream << __FILE__ << ":" << __LINE__ << ": expected " << #condition;                         \
+			throw TestFailure(stream.str());                                                              \
+		}                                                                                                 \
+	} while (0)
+
+#define EXPECT_EQ(actual, expected)                                                                       \
+	do {                                                                                                  \
+		auto actualValue = (actual);                                                                      \
+		auto expectedValue = (expected);                                                                  \
+		if (!(actualValue == expectedValue)) {                                                            \
+			std::ostringstream stream;                                                                    \
+			stream << __FILE__ << ":" << __LINE__ << ": expected " << #actual << " == " << #expected      \
+			       << " (got " << actualValue << ", want " << expectedValue << ")";                       \
+			throw TestFailure(stream.str());                                                              \
+		}                                                                                                 \
+	} while (0)
+
+// Fixtures live in test/fixtures; the runner is started from the package root.
+inline std::filesystem::path FixturePath(const std::string &name) {
+	return std::filesystem::path("test") / "fixtures" / name;
+}
+
+// Copies a fixture tree into a fresh temporary directory so tests can modify it.
+inline std::filesystem::path CopyFixture(const std::string &name) {
+	auto target = std::filesystem::temp_directory_path() / ("lumi-" + name + "-" + std::to_string(std::random_device()()));
+	std::filesystem::remove_all(target);
+	std::filesystem::copy(FixturePath(name), target, std::filesystem::copy_options::recursive | std::filesystem::copy_options::copy_symlinks);
+	return target;
+}
+
+#endif// LUMI_TEST_H
@@ -0,0 +1,193 @@
+#include "backends/simulated_backend.h"
+#include "monitor_service.h"
+#include "test.h"
+#include "write_coalescer.h"
+#include <chrono>
+#include <functional>
+#include <future>
+#include <thread>
+
+TEST(WriteCoalescerReplacesQueuedWrite) {
+	WriteCoalescer coalescer;
+	std::vector<std::function<void()>> queue;
+	std::vector<WriteOutcome> outcomes;
+	int written = -1;
+
+	auto post = [&](std::function<void()> task) { queue.push_back(task); };
+	auto done = [&](WriteOutcome outcome) { outcomes.push_back(outcome); };
+
+	for (int value: {10, 20, 30}) {
+		coalescer.Submit("a", [&written, value]() { written = value; return WriteOutcome::Written; }, done, post);
+	}
+
+	EXPECT_EQ(queue.size(), size_t(1));
+	EXPECT(outcomes == std::vector<WriteOutcome>({WriteOutcome::Coalesced, WriteOutcome::Coalesced}));
+
+	queue[0]();
+	EXPECT_EQ(written, 30);
+	EXPECT(outcomes.back() == WriteOutcome::Written);
+
+	// Once the queued write ran, the next one is queued again.
+	coalescer.Submit("a", []() { return WriteOutcome::Failed; }, done, post);
+	EXPECT_EQ(queue.size(), size_t(2));
+	queue[1]();
+	EXPECT(outcomes.back() == WriteOutcome::Failed);
+}
+
+TEST(WriteCoalescerRepostsForHigherPriority) {
+	WriteCoalescer coalescer;
+	std::vector<std::function<void()>> queue;
+	int writes = 0;
+	int written = -1;
+
+	auto post = [&](std::function<void()> task) { queue.push_back(task); };
+	auto done = [](WriteOutcome) {};
+
+	coalescer.Submit("a", [&]() { writes++; written = 10; return WriteOutcome::Written; }, done, post, Priority::Background);
+	coalescer.Submit("a", [&]() { writes++; written = 20; return WriteOutcome::Written; }, done, post, Priority::Interactive);
+	EXPECT_EQ(queue.size(), size_t(2));
+
+	// The task posted at the higher priority writes; the older one finds
+	// nothing left to do.
+	queue[1]();
+	queue[0]();
+	EXPECT_EQ(writes, 1);
+	EXPECT_EQ(written, 20);
+}
+
+TEST(MonitorServiceDropsWritesOvertakenByPriority) {
+	SimulatedBackendOptions options;
+	options.monitors = 1;
+	options.setLatency = std::chrono::milliseconds(50);
+	auto backend = std::make_shared<SimulatedBackend>(options);
+	MonitorService service(backend);
+	std::string id = SimulatedBackend::IdForIndex(0);
+	service.GetTopology();
+
+	std::promise<SetBrightnessResult> first;
+	std::promise<SetBrightnessResult> background;
+	std::promise<SetBrightnessResult> interactive;
+	service.SetBrightness({{id, 10}}, {}, [&](SetBrightnessResult value) { first.set_value(value); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+	SetBrightnessOptions low;
+	low.priority = Priority::Background;
+	service.SetBrightness({{id, 30}}, low, [&](SetBrightnessResult value) { background.set_value(value); });
+
+	SetBrightnessOptions high;
+	high.priority = Priority::Interactive;
+	service.SetBrightness({{id, 70}}, high, [&](SetBrightnessResult value) { interactive.set_value(value); });
+
+	EXPECT(first.get_future().get().success);
+	SetBrightnessResult overtaken = background.get_future().get();
+	EXPECT(interactive.get_future().get().success);
+
+	// The older background value never lands after the interactive one.
+	EXPECT(overtaken.coalesced);
+	EXPECT_EQ(service.GetBrightness(id, {true}), 70);
+	EXPECT_EQ(backend->GetOperationCount(0), 3);
+}
+
+TEST(MonitorServiceFailsWritesOvertakenByFailedWrite) {
+	SimulatedBackendOptions options;
+	options.monitors = 1;
+	options.setLatency = std::chrono::milliseconds(50);
+	auto backend = std::make_shared<SimulatedBackend>(options);
+	MonitorService service(backend);
+	std::string id = SimulatedBackend::IdForIndex(0);
+	service.GetTopology();
+
+	std::promise<SetBrightnessResult> first;
+	std::promise<SetBrightnessResult> background;
+	std::promise<SetBrightnessResult> interactive;
+	service.SetBrightness({{id, 10}}, {}, [&](SetBrightnessResult value) { first.set_value(value); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+	SetBrightnessOptions low;
+	low.priority = Priority::Background;
+	service.SetBrightness({{id, 30}}, low, [&](SetBrightnessResult value) { background.set_value(value); });
+
+	// The interactive write jumps ahead of the background one and fails.
+	backend->SetMonitorOffline(0, true);
+	SetBrightnessOptions high;
+	high.priority = Priority::Interactive;
+	service.SetBrightness({{id, 70}}, high, [&](SetBrightnessResult value) { interactive.set_value(value); });
+
+	EXPECT(first.get_future().get().success);
+	EXPECT(!interactive.get_future().get().success);
+
+	// The overtaken write does not claim a value that never landed.
+	SetBrightnessResult overtaken = background.get_future().get();
+	EXPECT(!overtaken.success);
+	EXPECT(!overtaken.coalesced);
+	EXPECT_EQ(overtaken.monitors[0].error, std::string("WRITE_FAILED"));
+	EXPECT_EQ(backend->GetOperationCount(0), 2);
+}
+
+TEST(MonitorServiceReportsOvertakenCoalescedWriteAsCoalesced) {
+	SimulatedBackendOptions options;
+	options.monitors = 1;
+	options.setLatency = std::chrono::milliseconds(50);
+	auto backend = std::make_shared<SimulatedBackend>(options);
+	MonitorService service(backend);
+	std::string id = SimulatedBackend::IdForIndex(0);
+	std::uint32_t handle = service.GetHandle(id);
+
+	std::promise<SetBrightnessResult> first;
+	std::promise<std::vector<SetStatus>> pending;
+	std::promise<SetBrightnessResult> interactive;
+	service.SetBrightness({{id, 10}}, {}, [&](SetBrightnessResult value) { first.set_value(value); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+	// A coalescing background write waits in the coalescer...
+	SetBrightnessOptions slider(true);
+	slider.priority = Priority::Background;
+	service.SetManyBrightness({{handle, 30}}, slider, [&](std::vector<SetStatus> value) { pending.set_value(value); });
+
+	// ...and is overtaken by an interactive one.
+	SetBrightnessOptions high;
+	high.priority = Priority::Interactive;
+	service.SetBrightness({{id, 70}}, high, [&](SetBrightnessResult value) { interactive.set_value(value); });
+
+	EXPECT(first.get_future().get().success);
+	EXPECT(interactive.get_future().get().success);
+	std::vector<SetStatus> statuses = pending.get_future().get();
+	EXPECT(statuses[0] == SetStatus::Coalesced);
+	EXPECT_EQ(service.GetBrightness(id, {true}), 70);
+	EXPECT_EQ(backend->GetOperationCount(0), 3);
+}
+
+TEST(WriteCoalescerKeepsOnlyNewestPendingWrite) {
+	SimulatedBackendOptions options;
+	options.monitors = 2;
+	options.setLatency = std::chrono::milliseconds(100);
+	auto backend = std::make_shared<SimulatedBackend>(options);
+	MonitorService service(backend);
+	std::string id = SimulatedBackend::IdForIndex(0);
+
+	// A slider burst: one write gets onto the bus, the rest queue up behind it.
+	const int burst = 10;
+	std::vector<SetBrightnessResult> results(burst);
+	std::vector<std::thread> threads;
+
+	for (int i = 0; i < burst; i++) {
+		threads.emplace_back([&, i]() {
+			results[i] = service.SetBrightness({{id, i * 10}}, {true});
+		});
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+
+	for (auto &thread: threads) thread.join();
+
+	int coalesced = 0;
+	for (const auto &result: results) {
+		EXPECT(result.success);
+		if (result.coalesced) coalesced++;
+	}
+
+	EXPECT_EQ(coalesced, burst - 2);
+	EXPECT(!results.front().coalesced);
+	EXPECT(!results.back().coalesced);
+	EXPECT_EQ(backend->GetOperationCount(0), 2);
+	EXPECT_EQ(service.GetBrightness(id), (burst - 1) * 10);
+}
@@ -0,0 +1,152 @@
+// Runs against simulated monitors, so it passes on any machine (including CI
+// without displays). The backend is chosen when lumi is first used, so the
+// environment has to be set before requiring it.
+process.env.LUMI_BACKEND = "simulated";
+process.env.LUMI_SIMULATED = "monitors=3,internal=1,setLatency=5";
+
+const lumi = require("../index.js");
+const {describe, it} = require("mocha");
+const {expect} = require("chai");
+
+describe("lumi (simulated monitors)", function () {
+    this.timeout(10000);
+
+    it("should enumerate monitors asynchronously", async () => {
+        const monitors = await lumi.monitorsAsync();
+        expect(monitors).to.have.lengthOf(3);
+        expect(monitors.map(({id}) => id)).to.deep.equal(lumi.monitors().map(({id}) => id));
+        expect(monitors[0].internal).to.be.true;
+        expect(monitors[0].size).to.have.all.keys("width", "height");
+    });
+
+    it("should read every monitor at once", async () => {
+        const monitors = await lumi.monitorsAsync();
+        const {success, brightness, errors} = await lumi.getAll({fresh: true});
+        expect(success).to.be.true;
+        expect(Object.keys(brightness)).to.have.members(monitors.map(({id}) => id));
+        expect(errors).to.be.empty;
+    });
+
+    it("should report per-monitor results for a config", async () => {
+        const [first, second] = await lumi.monitorsAsync();
+        const {success, monitors} = await lumi.set({[first.id]: 10, [second.id]: 20, missing: 30});
+        expect(success).to.be.true;
+        expect(monitors[first.id].success).to.be.true;
+        expect(monitors.missing.error).to.equal("NOT_FOUND");
+        expect((await lumi.get(second.id)).brightness).to.equal(20);
+    });
+
+    it("should set and get through handles", async () => {
+        const [, monitor] = await lumi.monitorsAsync();
+        const handle = lumi.handle(monitor.id);
+        expect(handle).to.be.a("number");
+        expect(lumi.handle(monitor.id)).to.equal(handle);
+        expect(lumi.handle("missing")).to.be.null;
+        expect((await lumi.set(handle, 35)).monitors[monitor.id].success).to.be.true;
+        expect((await lumi.get(handle, {fresh: true})).brightness).to.equal(35);
+        expect((await lumi.get(handle + 100)).success).to.be.false;
+    });
+
+    it("should set many monitors from typed arrays", async () => {
+        const monitors = await lumi.monitorsAsync();
+        const handles = Uint32Array.from([...monitors.map(({id}) => lumi.handle(id)), 0]);
+        const status = new Uint8Array(handles.length);
+        const result = await lumi.setMany(handles, Uint8Array.from([41, 42, 43, 44]), {status});
+        expect(result).to.equal(status);
+        expect([...status]).to.deep.equal([lumi.SetStatus.OK, lumi.SetStatus.OK, lumi.SetStatus.OK, lumi.SetStatus.NOT_FOUND]);
+        expect((await lumi.get(monitors[2].id, {fresh: true})).brightness).to.equal(43);
+        expect(() => lumi.setMany(handles, new Uint8Array(1))).to.throw(TypeError);
+    });
+
+    it("should serve the last known value synchronously", async () => {
+        const [, , monitor] = await lumi.monitorsAsync();
+        lumi.refresh();
+        expect(lumi.getCached(monitor.id)).to.be.null;
+        await lumi.set(monitor.id, 64);
+        const {brightness, age} = lumi.getCached(lumi.handle(monitor.id));
+        expect(brightness).to.equal(64);
+        expect(age).to.be.within(0, 1000);
+    });
+
+    it("should report monitor health", async () => {
+        const monitors = await lumi.monitorsAsync();
+        await lumi.getAll({fresh: true});
+        const health = lumi.health();
+        expect(health.map(({id}) => id)).to.deep.equal(monitors.map(({id}) => id));
+        expect(health[2].state).to.equal("closed");
+        expect(health[2].successes).to.be.above(0);
+        expect(health[2].retryIn).to.equal(0);
+    });
+
+    it("should report no identity collisions", async () => {
+        await lumi.monitorsAsync();
+        expect(lumi.collisions()).to.deep.equal([]);
+    });
+
+    it("should time out and abort requests", async () => {
+        const [monitor] = await lumi.monitorsAsync();
+        const timedOut = await lumi.get(monitor.id, {fresh: true, timeoutMs: 0});
+        expect(timedOut.success).to.be.false;
+        expect(timedOut.error).to.equal("TIMEOUT");
+
+        const controller = new AbortController();
+        controller.abort();
+        expect((await lumi.set(monitor.id, 10, {signal: controller.signal})).error).to.equal("ABORTED");
+        const status = await lumi.setMany(Uint32Array.of(lumi.handle(monitor.id)), Uint8Array.of(10), {signal: controller.signal});
+        expect(status[0]).to.equal(lumi.SetStatus.ABORTED);
+        expect((await lumi.get(monitor.id, {fresh: true, timeoutMs: 1000})).brightness).to.not.equal(10);
+    });
+
+    it("should run interactive requests ahead of background work", async () => {
+        const [monitor] = await lumi.monitorsAsync();
+        const sweep = lumi.getAll({fresh: true, priority: "background"});
+        const background = lumi.set(monitor.id, 20, {priority: "background"});
+        const {success} = await lumi.set(monitor.id, 80, {priority: "interactive"});
+        expect(success).to.be.true;
+        expect((await background).success).to.be.true;
+        expect((await sweep).success).to.be.true;
+        expect((await lumi.get(monitor.id, {fresh: true, priority: "interactive"})).brightness).to.equal(80);
+    });
+
+    it("should report the primary monitor", async () => {
+        const [first] = await lumi.monitorsAsync();
+        expect(lumi.primary().id).to.equal(first.id);
+        expect(lumi.handle("primary")).to.equal(lumi.handle(first.id));
+    });
+
+    it("should coalesce rapid writes to one monitor", async () => {
+        const [monitor] = await lumi.monitorsAsync();
+        const results = await Promise.all([...Array(10).keys()].map((i) => lumi.set(monitor.id, i * 10, {coalesce: true})));
+        expect(results.every(({success}) => success)).to.be.true;
+        expect(results.filter(({coalesced}) => coalesced)).to.not.be.empty;
+        expect((await lumi.get(monitor.id, {fresh: true})).brightness).to.equal(90);
+    });
+
+    it("should fade to the target", async () => {
+        const [monitor] = await lumi.monitorsAsync();
+        const {success, status} = await lumi.fade(monitor.id, 70, 100, {easing: "easeInOut"});
+        expect(success).to.be.true;
+        expect(status).to.equal("completed");
+        expect((await lumi.get(monitor.id, {fresh: true})).brightness).to.equal(70);
+    });
+
+    it("should cancel a fade", async () => {
+        const [monitor] = await lumi.monitorsAsync();
+        const fade = lumi.fade(monitor.id, 0, 5000);
+        expect(fade.cancel()).to.be.true;
+        expect((await fade).status).to.equal("cancelled");
+    });
+
+    it("should stream discovery events", async () => {
+        lumi.refresh();
+        const events = [];
+        for await (const event of lumi.discover()) events.push(event);
+        const types = events.map(({type}) => type);
+        expect(types.filter((type) => type === "identity")).to.have.lengthOf(3);
+        expect(types.lastIndexOf("identity")).to.be.below(types.indexOf("capabilities"));
+        const probed = events.filter(({type}) => type === "capabilities");
+        expect(probed).to.have.lengthOf(3);
+        expect(probed[0].capabilities.brightness).to.be.true;
+        expect(probed[0].brightness).to.be.a("number");
+    });
+});